@@ -0,0 +1,246 @@
+/*
+ * filter.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Fixed point median, decimate and smoothing filters.
+ * See filter.h
+ *
+ */
+
+#include <stddef.h>
+#include "config.h"
+#include "filter.h"
+
+
+///////////////////////////////////////////
+//Filter_medianInit
+//size 3 or 5, anything else passes the samples
+//through
+void Filter_medianInit(Filter_Median_t *far median, uint8_t size)
+{
+	median->size = ((size == 3) || (size == 5)) ? size : 0;
+	median->next = 0x00;
+	median->count = 0x00;
+}
+
+
+///////////////////////////////////////////
+//Filter_median
+//Add a sample, return the median of the window.
+//Until the window is full the sample is returned.
+uint16_t Filter_median(Filter_Median_t *far median, uint16_t sample)
+{
+	uint16_t sorted[FILTER_MEDIAN_MAX];
+	uint16_t a = 0x00;
+	uint16_t b = 0x00;
+	uint16_t c = 0x00;
+	uint8_t i = 0x00;
+	uint8_t j = 0x00;
+
+	if (median->size == 0)
+		return sample;
+
+	median->window[median->next] = sample;
+	median->next++;
+	if (median->next >= median->size)
+		median->next = 0x00;
+
+	if (median->count < median->size)
+	{
+		median->count++;
+		return sample;
+	}
+
+	//3 - the one between the other two
+	if (median->size == 3)
+	{
+		a = median->window[0];
+		b = median->window[1];
+		c = median->window[2];
+
+		if (a > b)
+		{
+			if (b > c)
+				return b;
+			return (a > c) ? c : a;
+		}
+
+		if (a > c)
+			return a;
+		return (b > c) ? c : b;
+	}
+
+	//5 - insertion sort a copy, take the middle
+	for (i = 0 ; i < FILTER_MEDIAN_MAX ; i++)
+	{
+		a = median->window[i];
+		for (j = i ; (j > 0) && (sorted[j - 1] > a) ; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = a;
+	}
+
+	return sorted[FILTER_MEDIAN_MAX >> 1];
+}
+
+
+///////////////////////////////////////////
+//Filter_decimateInit
+//bits 0 - FILTER_DECIMATE_MAX_BITS extra bits, 4^bits
+//samples per output
+void Filter_decimateInit(Filter_Decimate_t *far decimate, uint8_t bits)
+{
+	if (bits > FILTER_DECIMATE_MAX_BITS)
+		bits = FILTER_DECIMATE_MAX_BITS;
+
+	decimate->sum = 0x00;
+	decimate->count = 0x00;
+	decimate->bits = bits;
+}
+
+
+///////////////////////////////////////////
+//Filter_decimate
+//Add a sample.  Returns 1 and the output in out when
+//4^bits samples are in, 0 otherwise.
+uint8_t Filter_decimate(Filter_Decimate_t *far decimate, uint16_t sample, uint16_t *far out)
+{
+	decimate->sum += sample;
+	decimate->count++;
+
+	//4^bits = 1 << (2 * bits)
+	if (decimate->count < (uint8_t)(1 << (decimate->bits << 1)))
+		return 0;
+
+	*out = decimate->sum >> decimate->bits;
+	decimate->sum = 0x00;
+	decimate->count = 0x00;
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Filter_smoothInit
+//mode - IIR, average or off
+//shift - k, cut to what the mode allows
+//inputBits - bits in the samples, 12 for the ADC,
+//more after decimation
+void Filter_smoothInit(Filter_Smoother_t *far smooth, Filter_Smooth_t mode, uint8_t shift, uint8_t inputBits)
+{
+	if (inputBits > 16)
+		inputBits = 16;
+
+	if (shift > FILTER_SMOOTH_MAX_SHIFT)
+		shift = FILTER_SMOOTH_MAX_SHIFT;
+
+	if (mode == FILTER_SMOOTH_AVERAGE)
+	{
+		if (shift > FILTER_AVERAGE_MAX_SHIFT)
+			shift = FILTER_AVERAGE_MAX_SHIFT;
+		if (shift > (16 - inputBits))
+			shift = 16 - inputBits;
+	}
+
+	smooth->mode = (uint8_t)mode;
+	smooth->shift = shift;
+	smooth->fraction = 16 - inputBits;
+	smooth->seeded = 0x00;
+	smooth->state = 0x00;
+	smooth->next = 0x00;
+}
+
+
+///////////////////////////////////////////
+//Filter_smooth
+//Add a sample, return the filtered value in the
+//units of the input.  The first sample seeds the
+//state, so there is no ramp up from 0.
+uint16_t Filter_smooth(Filter_Smoother_t *far smooth, uint16_t sample)
+{
+	uint16_t target = 0x00;
+	uint16_t step = 0x00;
+	uint8_t size = 0x00;
+	uint8_t i = 0x00;
+
+	if (smooth->mode == FILTER_SMOOTH_IIR)
+	{
+		target = sample << smooth->fraction;
+
+		if (!smooth->seeded)
+		{
+			smooth->state = target;
+			smooth->seeded = 1;
+		}
+
+		//unsigned both ways, no sign extended shift.  At
+		//least one unit a step, see filter.h
+		if (target > smooth->state)
+		{
+			step = (target - smooth->state) >> smooth->shift;
+			smooth->state += step ? step : 1;
+		}
+		else if (target < smooth->state)
+		{
+			step = (smooth->state - target) >> smooth->shift;
+			smooth->state -= step ? step : 1;
+		}
+
+		return smooth->state >> smooth->fraction;
+	}
+
+	if (smooth->mode == FILTER_SMOOTH_AVERAGE)
+	{
+		size = (uint8_t)(1 << smooth->shift);
+
+		if (!smooth->seeded)
+		{
+			for (i = 0 ; i < size ; i++)
+				smooth->window[i] = sample;
+			smooth->state = sample << smooth->shift;
+			smooth->seeded = 1;
+		}
+
+		smooth->state -= smooth->window[smooth->next];
+		smooth->state += sample;
+		smooth->window[smooth->next] = sample;
+		smooth->next = (smooth->next + 1) & (size - 1);
+
+		return smooth->state >> smooth->shift;
+	}
+
+	return sample;
+}
+
+
+///////////////////////////////////////////
+//Filter_init
+//Set up the three stages for 12 bit ADC samples
+//medianSize - 3, 5 or 0 for none
+//decimateBits - 0 - 2 extra bits
+//mode / shift - see Filter_smoothInit
+void Filter_init(Filter_Pipeline_t *far pipeline, uint8_t medianSize, uint8_t decimateBits, Filter_Smooth_t mode, uint8_t shift)
+{
+	Filter_medianInit(&pipeline->median, medianSize);
+	Filter_decimateInit(&pipeline->decimate, decimateBits);
+	Filter_smoothInit(&pipeline->smooth, mode, shift, FILTER_ADC_BITS + pipeline->decimate.bits);
+}
+
+
+///////////////////////////////////////////
+//Filter_run
+//Run a sample through the pipeline.  Returns 1 and
+//the output in out once per 4^decimateBits samples,
+//in 12 + decimateBits bit counts, 0 otherwise.
+uint8_t Filter_run(Filter_Pipeline_t *far pipeline, uint16_t sample, uint16_t *far out)
+{
+	uint16_t value = Filter_median(&pipeline->median, sample);
+
+	if (!Filter_decimate(&pipeline->decimate, value, &value))
+		return 0;
+
+	*out = Filter_smooth(&pipeline->smooth, value);
+
+	return 1;
+}
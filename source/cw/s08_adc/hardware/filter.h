@@ -0,0 +1,136 @@
+/*
+ * filter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Fixed point filters for ADC samples, run one sample
+ * at a time with adds, compares and shifts only - no
+ * multiply or divide.  Three stages, each usable on
+ * its own, chained by Filter_run:
+ *
+ * Median - median of the last 3 or 5 samples.  A
+ * single spike never gets through, a step is delayed
+ * by (N - 1) / 2 samples.  Goes first so a spike is
+ * gone before it is averaged into anything.
+ *
+ * Decimate - sum 4^bits samples and shift the sum
+ * right by bits.  With a few counts of noise on the
+ * input each 4x oversample is one more bit, 12 bit
+ * samples come out as 13 or 14 bits at 1/4 or 1/16
+ * of the rate.  16 samples of 12 bits still fit the
+ * 16 bit sum.
+ *
+ * Smooth - single pole IIR, state += (x - state) >> k,
+ * or a moving average of 2^k samples, sum += x - oldest
+ * and the output is sum >> k.  The IIR keeps
+ * 16 - input bits of fraction, and a step is never
+ * less than one unit of it - a plain shift stops
+ * moving when the difference is under 2^k, up to
+ * 2^(k - fraction) counts short of a steady input.
+ * With the minimum step the state always reaches the
+ * input, the last 2^k units at one a sample.  The
+ * average has a flat response and a hard window, the
+ * IIR needs no window.  The average sum has to fit 16
+ * bits, k is cut to 16 - input bits - 8 samples of 12
+ * bits, 4 of 14.
+ *
+ * Cost on the HCS08, per sample - decimate and IIR a
+ * few dozen cycles, shifts by k are a loop.  Median
+ * of 3 is three compares, median of 5 an insertion
+ * sort of 5, the expensive one.
+ *
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stddef.h>
+#include "config.h"
+
+#define FILTER_MEDIAN_MAX			5
+#define FILTER_DECIMATE_MAX_BITS	2			//16 samples of 12 bits
+#define FILTER_SMOOTH_MAX_SHIFT		7
+#define FILTER_AVERAGE_MAX			8			//moving average window, power of two
+#define FILTER_AVERAGE_MAX_SHIFT	3
+#define FILTER_ADC_BITS				12
+
+typedef enum
+{
+	FILTER_SMOOTH_OFF,
+	FILTER_SMOOTH_IIR,
+	FILTER_SMOOTH_AVERAGE
+}Filter_Smooth_t;
+
+
+/////////////////////////////////////////
+//Median of N
+//window - the last samples, oldest at next
+//size - 3 or 5, anything else is no median
+//count - samples in the window, passes samples
+//through until it is full
+typedef struct
+{
+	uint16_t window[FILTER_MEDIAN_MAX];
+	uint8_t size;
+	uint8_t next;
+	uint8_t count;
+}Filter_Median_t;
+
+
+/////////////////////////////////////////
+//Oversample and decimate
+//sum - samples so far, count of 4^bits
+typedef struct
+{
+	uint16_t sum;
+	uint8_t count;
+	uint8_t bits;
+}Filter_Decimate_t;
+
+
+/////////////////////////////////////////
+//IIR or moving average
+//mode - Filter_Smooth_t
+//shift - k, coefficient 1/2^k or window 2^k
+//fraction - IIR fraction bits, 16 - input bits
+//seeded - the first sample sets the state
+//state - IIR state, counts << fraction, or the
+//moving average sum
+//window / next - moving average samples
+typedef struct
+{
+	uint8_t mode;
+	uint8_t shift;
+	uint8_t fraction;
+	uint8_t seeded;
+	uint16_t state;
+	uint16_t window[FILTER_AVERAGE_MAX];
+	uint8_t next;
+}Filter_Smoother_t;
+
+
+/////////////////////////////////////////
+//Pipeline - median, decimate, smooth
+typedef struct
+{
+	Filter_Median_t median;
+	Filter_Decimate_t decimate;
+	Filter_Smoother_t smooth;
+}Filter_Pipeline_t;
+
+
+void Filter_medianInit(Filter_Median_t *far median, uint8_t size);
+uint16_t Filter_median(Filter_Median_t *far median, uint16_t sample);
+
+void Filter_decimateInit(Filter_Decimate_t *far decimate, uint8_t bits);
+uint8_t Filter_decimate(Filter_Decimate_t *far decimate, uint16_t sample, uint16_t *far out);
+
+void Filter_smoothInit(Filter_Smoother_t *far smooth, Filter_Smooth_t mode, uint8_t shift, uint8_t inputBits);
+uint16_t Filter_smooth(Filter_Smoother_t *far smooth, uint16_t sample);
+
+void Filter_init(Filter_Pipeline_t *far pipeline, uint8_t medianSize, uint8_t decimateBits, Filter_Smooth_t mode, uint8_t shift);
+uint8_t Filter_run(Filter_Pipeline_t *far pipeline, uint16_t sample, uint16_t *far out);
+
+
+#endif /* FILTER_H_ */
@@ -0,0 +1,162 @@
+/*
+ * i2cslave.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * I2C slave mode register map.  See i2cslave.h
+ *
+ * ISR flow follows the typical interrupt routine in
+ * the IIC chapter of the reference manual:
+ * IAAS set - addressed, SRW picks transmit or receive
+ * TX set - the master acked the last byte, send the
+ * next, or NACKed it, switch to receive and release
+ * the bus with a dummy read
+ * TX clear - a byte was received, the first one after
+ * the address is the register pointer
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include "mc9s08qe8.h"
+#include <stddef.h>
+#include "config.h"
+#include "i2cslave.h"
+
+
+/////////////////////////////////////////////
+//Slave Variables
+//mMap / mSize - register map of the caller
+//mWritable - first register the master can write
+//mPointer - next register to read or write
+//mFirst - next byte received is the register pointer
+//mReads / mWrites - transfers addressed to us
+static uint8_t *far mMap = NULL;
+static uint8_t mSize = 0x00;
+static uint8_t mWritable = 0x00;
+static uint8_t mPointer = 0x00;
+static uint8_t mFirst = 0x00;
+static uint16_t mReads = 0x00;
+static uint16_t mWrites = 0x00;
+
+
+/////////////////////////////////////////////
+//I2CSlave_init
+//Respond at the 7 bit address, serve size bytes of
+//map.  Registers from writable up can be written by
+//the master.  Slave mode only - MST is never set.
+//IICF only sets the SDA hold time here, ICR 0 is 7
+//bus clocks.
+void I2CSlave_init(uint8_t address, uint8_t *far map, uint8_t size, uint8_t writable)
+{
+	mMap = map;
+	mSize = size;
+	mWritable = writable;
+	mPointer = 0x00;
+	mFirst = 0x00;
+	mReads = 0x00;
+	mWrites = 0x00;
+
+	IICC1 = 0x00;				//disabled while configured
+	IICA = (uint8_t)(address << 1);
+	IICF = 0x00;
+	IICS = IICS_ARBL_MASK | IICS_IICIF_MASK;	//clear the flags
+
+	IICC1_IICEN = 1;			//i2c enable
+	IICC1_IICIE = 1;			//enable interrupts
+}
+
+
+/////////////////////////////////////////////
+//Returns 1 if there is no transfer on the bus,
+//BUSY is set by a start and cleared by a stop
+uint8_t I2CSlave_isIdle(void)
+{
+	return (IICS_BUSY == 0) ? 1 : 0;
+}
+
+
+uint16_t I2CSlave_getReads(void)
+{
+	return mReads;
+}
+
+
+uint16_t I2CSlave_getWrites(void)
+{
+	return mWrites;
+}
+
+
+////////////////////////////////////////////////
+//I2C Interrupt Service Routine - slave mode.
+//
+void interrupt VectorNumber_Viic iic_isr(void)
+{
+	uint8_t data = 0x00;
+
+	//clear the interrupt flag by writing a 1
+	IICS_IICIF = 1;
+
+	//lost arbitration as a master, can't happen in
+	//slave only mode but has to be cleared
+	if (IICS_ARBL)
+	{
+		IICS_ARBL = 1;
+		if (!IICS_IAAS)
+			return;
+	}
+
+	//addressed - writing IICC1 clears IAAS
+	if (IICS_IAAS)
+	{
+		if (IICS_SRW)
+		{
+			IICC1_TX = 1;
+			IICD = mMap[mPointer];
+			mPointer = (mPointer + 1 < mSize) ? mPointer + 1 : 0;
+			mReads++;
+		}
+		else
+		{
+			IICC1_TX = 0;
+			data = IICD;			//dummy read, releases SCL
+			mFirst = 1;
+			mWrites++;
+		}
+		return;
+	}
+
+	//transmitting
+	if (IICC1_TX)
+	{
+		if (!IICS_RXAK)
+		{
+			IICD = mMap[mPointer];
+			mPointer = (mPointer + 1 < mSize) ? mPointer + 1 : 0;
+		}
+		else
+		{
+			//last byte, wait for the stop
+			IICC1_TX = 0;
+			data = IICD;
+		}
+		return;
+	}
+
+	//receiving
+	data = IICD;
+
+	if (mFirst)
+	{
+		mFirst = 0;
+		mPointer = (data < mSize) ? data : 0;
+		return;
+	}
+
+	if (mPointer >= mWritable)
+		mMap[mPointer] = data;
+
+	mPointer = (mPointer + 1 < mSize) ? mPointer + 1 : 0;
+}
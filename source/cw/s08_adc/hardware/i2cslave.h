@@ -0,0 +1,43 @@
+/*
+ * i2cslave.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * I2C slave mode on PA2 (SDA) and PA3 (SCL).  The
+ * QE8 is a peripheral at IICA and serves a register
+ * map owned by the caller, entirely from the IIC
+ * interrupt.
+ *
+ * Protocol, like most sensor parts:
+ * write - [addr+W] [reg] [data] [data] ...
+ * read  - [addr+W] [reg] [restart] [addr+R] [data] ...
+ * The register pointer auto increments after every
+ * byte and wraps at the end of the map.  Writes below
+ * the first writable register are dropped.  A read
+ * without a register write first continues from the
+ * pointer.
+ *
+ * The ISR only moves one byte per interrupt, so SCL
+ * is held for the ISR latency and nothing else.  The
+ * caller updates read only registers when
+ * I2CSlave_isIdle() - no transfer between start and
+ * stop - so a multi byte read is never torn.
+ */
+
+#ifndef I2CSLAVE_H_
+#define I2CSLAVE_H_
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+
+
+void I2CSlave_init(uint8_t address, uint8_t *far map, uint8_t size, uint8_t writable);
+uint8_t I2CSlave_isIdle(void);
+uint16_t I2CSlave_getReads(void);
+uint16_t I2CSlave_getWrites(void);
+
+
+#endif /* I2CSLAVE_H_ */
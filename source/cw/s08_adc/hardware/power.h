@@ -0,0 +1,94 @@
+/*
+ * power.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Low power wait primitives.  Instead of spinning
+ * on a flag at full bus speed, the wait loops put the
+ * core into WAIT or STOP3 until the next interrupt.
+ * A small policy layer picks the deepest mode that is
+ * safe given the peripherals that are currently active.
+ * With INSTRUMENT a residency counter keeps track of
+ * how many RTC ticks were spent in each mode.
+ *
+ * WAIT - CPU halted, bus clock and peripherals running.
+ * STOP3 - everything stopped except the RTC on the 1khz
+ * low power oscillator, the KBI pins and the LVD.  Any
+ * enabled interrupt brings the core back.
+ *
+ * Note: SOPT1_STOPE has to be set in System_init for
+ * STOP3 to be used.  SOPT1 is write once.  If it is
+ * not set, the policy falls back to WAIT.  An external
+ * xtal profile only gets STOP3 when the bus runs
+ * straight off the xtal and EREFSTEN keeps it running,
+ * see Power_selectMode.
+ *
+ */
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include "config.h"
+
+//////////////////////////////////////////
+//Peripherals that need the bus clock.
+//While any of these are set, STOP3 is not
+//allowed and the policy uses WAIT.
+//The PWM output and the clock profile are
+//checked directly from the TPM1 and ICS bits.
+//SCI is a transmit running, SCI_RX a frame coming
+//in - a byte that starts in STOP3 is lost.
+#define POWER_PERIPH_SPI		BIT0
+#define POWER_PERIPH_IIC		BIT1
+#define POWER_PERIPH_SCI		BIT2
+#define POWER_PERIPH_ADC		BIT3
+#define POWER_PERIPH_SCI_RX		BIT4
+
+
+typedef enum
+{
+	POWER_MODE_WAIT,
+	POWER_MODE_STOP3,
+	POWER_MODE_RUN,			//awake, residency only
+	POWER_MODE_NUM
+}Power_Mode_t;
+
+
+//////////////////////////////////////////////
+//POWER_SLEEP_WHILE(cond)
+//Sleep until cond is false.  The condition is
+//tested with interrupts disabled, and WAIT/STOP
+//clear the I bit as part of the instruction, so an
+//interrupt that lands between the test and the
+//sleep still wakes the core.  Returns with
+//interrupts enabled.  Same as the old spin loops,
+//do not use this with interrupts disabled on
+//purpose - the flag would never change.
+#define POWER_SLEEP_WHILE(cond)		\
+{									\
+	DisableInterrupts;				\
+	while (cond)					\
+		Power_sleep();				\
+	EnableInterrupts;				\
+}
+
+
+void Power_init(void);
+
+void Power_setActive(uint8_t periph);
+void Power_clearActive(uint8_t periph);
+uint8_t Power_getActive(void);
+
+Power_Mode_t Power_selectMode(void);
+void Power_sleep(void);
+
+#if INSTRUMENT
+unsigned long Power_getResidency(Power_Mode_t mode);
+void Power_clearResidency(void);
+#endif
+
+
+#endif /* POWER_H_ */
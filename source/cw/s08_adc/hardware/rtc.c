@@ -65,6 +65,20 @@ void RTC_init(RTC_Frequency_t freq)
 
 
 
+/////////////////////////////////////////////
+//Returns the number of RTC interrupts since init
+unsigned int RTC_getTimeTick(void)
+{
+	unsigned int tick = 0x00;
+
+	DisableInterrupts;
+	tick = gTimeTick;
+	EnableInterrupts;
+
+	return tick;
+}
+
+
 /////////////////////////////////////////////
 //Delay in units of timebase for RTC interrupt
 //ie, For RTC configured to 1khz timeout, units in ms
@@ -34,6 +34,7 @@ extern unsigned char mToggleInterval;
 
 
 void RTC_init(RTC_Frequency_t freq);
+unsigned int RTC_getTimeTick(void);
 void RTC_delay(unsigned int delay);
 
 
@@ -0,0 +1,180 @@
+/*
+ * sched.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Cooperative run to completion scheduler.  See sched.h
+ *
+ * Release times are kept as the low 16 bits of the
+ * RTC time tick and compared with signed math, so they
+ * work across the roll over as long as no period is
+ * longer than 0x7FFF ticks.
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "sched.h"
+#include "rtc.h"
+#include "power.h"
+#include "timer.h"
+
+
+/////////////////////////////////////////////
+//Scheduler Variables
+//mTable - task table, in ROM
+//mNext - next release tick for each task
+//mDone - bit n set once run once task n has run,
+//it is not released again
+static const Sched_Task_t *far mTable = NULL;
+static uint8_t mNumTasks = 0x00;
+static uint16_t mNext[SCHED_MAX_TASKS] = {0x00};
+static uint8_t mDone = 0x00;
+
+#if INSTRUMENT
+//mWcet - longest run time for each task, timer
+//counts.  Only read between frames, FAR_RAM
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static uint16_t mWcet[SCHED_MAX_TASKS] = {0x00};
+#pragma DATA_SEG DEFAULT
+#endif
+
+
+///////////////////////////////////////////
+//Sched_init
+//Set the task table and the first release time
+//of each task.  Call after RTC_init_xx with
+//interrupts disabled.
+void Sched_init(const Sched_Task_t *far table, uint8_t numTasks)
+{
+	uint8_t i = 0x00;
+	uint16_t now = (uint16_t)RTC_getTimeTick();
+
+	if (numTasks > SCHED_MAX_TASKS)
+		numTasks = SCHED_MAX_TASKS;
+
+	mTable = table;
+	mNumTasks = numTasks;
+	mDone = 0x00;
+
+	for (i = 0 ; i < numTasks ; i++)
+		mNext[i] = now + table[i].offset;
+
+#if INSTRUMENT
+	Sched_clearWcet();
+	Timer_init();
+#endif
+}
+
+
+///////////////////////////////////////////////
+//Sched_run
+//Call from the main loop.  Finds the highest
+//priority task that is due and runs it.  Periodic
+//tasks are released again one period after the
+//last release, so they keep their phase.  Run once
+//tasks (period = 0) are marked done and skipped
+//from then on.  If nothing is due, sleep until the
+//next interrupt and return, so the main loop can
+//poll whatever the interrupt finished.
+void Sched_run(void)
+{
+	uint8_t i = 0x00;
+	uint8_t best = SCHED_NO_TASK;
+	uint16_t now = Sched_getTick();
+#if INSTRUMENT
+	uint16_t start = 0x00;
+	uint16_t elapsed = 0x00;
+#endif
+
+	for (i = 0 ; i < mNumTasks ; i++)
+	{
+		if (mDone & (uint8_t)(1 << i))
+			continue;
+		
+		if ((int16_t)(now - mNext[i]) >= 0)
+		{
+			if ((best == SCHED_NO_TASK) || (mTable[i].priority < mTable[best].priority))
+				best = i;
+		}
+	}
+
+	//nothing to do - sleep unless the tick changed
+	//since it was read
+	if (best == SCHED_NO_TASK)
+	{
+		DisableInterrupts;
+		if ((uint16_t)RTC_getTimeTick() == now)
+			Power_sleep();
+		EnableInterrupts;
+		return;
+	}
+
+	if (mTable[best].period)
+		mNext[best] += mTable[best].period;
+	else
+		mDone |= (uint8_t)(1 << best);
+
+#if INSTRUMENT
+	start = Timer_getCount();
+	mTable[best].task();
+	elapsed = Timer_elapsed(start);
+
+	if (elapsed > mWcet[best])
+		mWcet[best] = elapsed;
+#else
+	mTable[best].task();
+#endif
+}
+
+
+///////////////////////////////////////////////
+//Returns the low 16 bits of the RTC time tick.
+//The tick is 32 bits, read it with interrupts off.
+uint16_t Sched_getTick(void)
+{
+	uint16_t result = 0x00;
+
+	DisableInterrupts;
+	result = (uint16_t)RTC_getTimeTick();
+	EnableInterrupts;
+
+	return result;
+}
+
+
+///////////////////////////////////////////////
+//Returns 1 if tick has been reached
+uint8_t Sched_isTickReached(uint16_t tick)
+{
+	if ((int16_t)(Sched_getTick() - tick) >= 0)
+		return 1;
+
+	return 0;
+}
+
+
+#if INSTRUMENT
+///////////////////////////////////////////////
+//Returns the worst case execution time of a task
+//in timer counts (TIMER_TICK_US each), index in
+//the task table
+uint16_t Sched_getWcet(uint8_t index)
+{
+	if (index >= mNumTasks)
+		return 0x00;
+
+	return mWcet[index];
+}
+
+
+void Sched_clearWcet(void)
+{
+	uint8_t i = 0x00;
+	for (i = 0 ; i < SCHED_MAX_TASKS ; i++)
+		mWcet[i] = 0x00;
+}
+#endif
@@ -22,7 +22,7 @@
 //SPI initialization
 //Configure as master, MSB first, idle clock
 //low, data on a leading edge.  SS pin configured
-//as normal IO.  SPI clock configured to 1mhz
+//as normal IO.  SPI clock configured to SPI_FREQ_HZ
 //NOTE: There are unusually long delays between 
 //bytes when sending an array.  ie, doubling the clock
 //speed does not double the rate.
@@ -50,16 +50,9 @@ void SPI_init(void)
 	SPIC2_SPC0 = 0x00;		//separate pins for input and output
 	
 	//SPIBR - Configure the baud rate - Tables 15-4 and 15-5
-	//For now, assume prescale = 2, rate divider = 2
-	//Top bits = 0001 (Note: Bit 7 not used, set as 0)
-	SPIBR_SPPR2 = 0x00;
-	SPIBR_SPPR1 = 0x00;
-	SPIBR_SPPR0 = 0x01;
-		
-	//Lower bits = 0000 - missing bit 3 from header
-	SPIBR_SPR2 = 0x00;
-	SPIBR_SPR1 = 0x00;
-	SPIBR_SPR0 = 0x00;
+	//Prescale and rate divider computed from the bus
+	//clock, see spi.h.  Bit 7 and bit 3 not used.
+	SPIBR = SPI_BR(CLOCK_BUS_FREQ_HZ);
 
 	//enable the SPI
 	SPIC1_SPE = 0x01;		//enable the SPI		
@@ -11,6 +11,23 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
+
+//////////////////////////////////////////////
+//SPI clock - computed from the bus clock
+//baud = bus / ((SPPR + 1) * 2^(SPR + 1))
+//Use the smallest SPR that fits, then round the
+//prescaler up so the rate is never above SPI_FREQ_HZ
+//For the 8mhz bus - SPPR = 1, SPR = 0, 2mhz
+#define SPI_FREQ_HZ			2000000UL
+
+#define SPI_DIV(bus)		(((bus) + SPI_FREQ_HZ - 1) / SPI_FREQ_HZ)
+#define SPI_SPR(bus)		((SPI_DIV(bus) <= 16) ? 0 : (SPI_DIV(bus) <= 32) ? 1 :		\
+							(SPI_DIV(bus) <= 64) ? 2 : (SPI_DIV(bus) <= 128) ? 3 :		\
+							(SPI_DIV(bus) <= 256) ? 4 : (SPI_DIV(bus) <= 512) ? 5 :		\
+							(SPI_DIV(bus) <= 1024) ? 6 : 7)
+#define SPI_SPPR(bus)		(((SPI_DIV(bus) + (2UL << SPI_SPR(bus)) - 1) / (2UL << SPI_SPR(bus))) - 1)
+#define SPI_BR(bus)			((uint8_t)((SPI_SPPR(bus) << 4) | SPI_SPR(bus)))
 
 
 void SPI_init(void);
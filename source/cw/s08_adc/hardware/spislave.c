@@ -0,0 +1,201 @@
+/*
+ * spislave.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * SPI slave mode with RX and TX rings.  See spislave.h
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include "mc9s08qe8.h"
+#include <stddef.h>
+#include "config.h"
+#include "spislave.h"
+
+
+/////////////////////////////////////////////
+//Ring Variables
+//head - next byte in, written by the producer
+//tail - next byte out, written by the consumer
+//RX - the ISR produces, SPISlave_read consumes
+//TX - SPISlave_write produces, the ISR consumes
+//The rings are in the zero page, see the RAM budget
+//in main.c
+#pragma DATA_SEG __SHORT_SEG MY_ZEROPAGE
+static uint8_t mRxRing[SPISLAVE_RX_SIZE] = {0x00};
+static volatile uint8_t mRxHead = 0x00;
+static volatile uint8_t mRxTail = 0x00;
+
+static uint8_t mTxRing[SPISLAVE_TX_SIZE] = {0x00};
+static volatile uint8_t mTxHead = 0x00;
+static volatile uint8_t mTxTail = 0x00;
+#pragma DATA_SEG DEFAULT
+
+static SPISlave_Counters_t mCounters = {0x00};
+
+
+static void SPISlave_clearCounters(void);
+
+
+///////////////////////////////////////////
+//SPISlave_init
+//Slave, mode 1, MSB first.  In slave mode SS is
+//always the slave select input, SSOE and MODFEN only
+//matter to a master and are left 0.  The baud rate
+//is set by the master's SCK.  The SPI interrupt is
+//off until the end, so the counters are cleared
+//without touching the I bit - init runs with
+//interrupts disabled and leaves them that way.
+void SPISlave_init(void)
+{
+	mRxHead = 0x00;
+	mRxTail = 0x00;
+	mTxHead = 0x00;
+	mTxTail = 0x00;
+	SPISlave_clearCounters();
+
+	PTBDD &=~ BIT5;			//SS as input
+
+	//SPIC1 Register - See Table 15-1
+	SPIC1 = 0x00;			//disabled while configured
+	SPIC1_MSTR = 0;			//slave mode
+	SPIC1_CPOL = 0;			//idle clock low
+	SPIC1_CPHA = 1;			//data on the trailing edge, SS held low
+	SPIC1_SSOE = 0;			//master only
+	SPIC1_LSBFE = 0x00;		//MSB first
+
+	//SPIC2 Register - See Table 15-3
+	SPIC2 = 0x00;
+	SPIC2_MODFEN = 0;		//master only
+	SPIC2_SPISWAI = 0x00;	//SPI continues to operate in wait mode
+
+	SPIC1_SPE = 1;			//enable the SPI
+	SPID = SPISLAVE_IDLE;	//first byte out
+	SPIC1_SPIE = 1;			//receive interrupt on
+}
+
+
+///////////////////////////////////////////
+//Take the next received byte.  Returns 1 if there
+//was one, 0 if the RX ring is empty.
+uint8_t SPISlave_read(uint8_t *far data)
+{
+	if (mRxTail == mRxHead)
+		return 0;
+
+	*data = mRxRing[mRxTail];
+	mRxTail = (mRxTail + 1) & (SPISLAVE_RX_SIZE - 1);
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//SPISlave_write
+//Queue a byte to send and turn the TX interrupt on.
+//Returns 0 if the TX ring is full.
+uint8_t SPISlave_write(uint8_t data)
+{
+	uint8_t next = (mTxHead + 1) & (SPISLAVE_TX_SIZE - 1);
+
+	if (next == mTxTail)
+		return 0;
+
+	mTxRing[mTxHead] = data;
+	mTxHead = next;
+
+	SPIC1_SPTIE = 1;
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Returns the number of bytes that can be queued
+uint8_t SPISlave_getTxFree(void)
+{
+	return (uint8_t)((mTxTail - mTxHead - 1) & (SPISLAVE_TX_SIZE - 1));
+}
+
+
+///////////////////////////////////////////
+//Copy the counters with interrupts off so they are
+//from the same moment
+void SPISlave_getCounters(SPISlave_Counters_t *far counters)
+{
+	DisableInterrupts;
+	*counters = mCounters;
+	EnableInterrupts;
+}
+
+
+///////////////////////////////////////////
+//Zero the counters with interrupts off, the ISR
+//counts.  Call with interrupts enabled.
+void SPISlave_resetCounters(void)
+{
+	DisableInterrupts;
+	SPISlave_clearCounters();
+	EnableInterrupts;
+}
+
+
+static void SPISlave_clearCounters(void)
+{
+	mCounters.rxBytes = 0x00;
+	mCounters.txBytes = 0x00;
+	mCounters.rxDropped = 0x00;
+	mCounters.txIdle = 0x00;
+}
+
+
+////////////////////////////////////////////////
+//SPI Interrupt Service Routine
+//SPRF - reading SPIS then SPID clears it.  A byte
+//went out with each one received, it was idle if
+//the TX ring is empty.
+//SPTEF - reading SPIS then writing SPID clears it.
+//With the ring empty the interrupt is turned off
+//and the idle byte is left in SPID.
+void interrupt VectorNumber_Vspi spi_isr(void)
+{
+	uint8_t status = SPIS;
+	uint8_t data = 0x00;
+	uint8_t next = 0x00;
+
+	if (status & SPIS_SPRF_MASK)
+	{
+		data = SPID;
+		mCounters.rxBytes++;
+
+		next = (mRxHead + 1) & (SPISLAVE_RX_SIZE - 1);
+		if (next != mRxTail)
+		{
+			mRxRing[mRxHead] = data;
+			mRxHead = next;
+		}
+		else
+			mCounters.rxDropped++;
+
+		if (mTxTail == mTxHead)
+			mCounters.txIdle++;
+	}
+
+	if ((status & SPIS_SPTEF_MASK) && SPIC1_SPTIE)
+	{
+		if (mTxTail != mTxHead)
+		{
+			SPID = mTxRing[mTxTail];
+			mTxTail = (mTxTail + 1) & (SPISLAVE_TX_SIZE - 1);
+			mCounters.txBytes++;
+		}
+		else
+		{
+			SPID = SPISLAVE_IDLE;
+			SPIC1_SPTIE = 0;
+		}
+	}
+}
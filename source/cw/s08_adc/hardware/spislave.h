@@ -0,0 +1,74 @@
+/*
+ * spislave.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * SPI slave mode on PB2 - PB5, interrupt driven.
+ *  PB2 - SCK		Pin 18 - input
+ *  PB3 - MOSI		Pin 17 - input
+ *  PB4 - MISO		Pin 12 - output
+ *  PB5 - SS		Pin 11 - slave select input
+ *
+ * SS is the hardware slave select - while it is high
+ * the shifter ignores SCK and MISO is off the bus, so
+ * a glitch or a short frame never shifts the bits of
+ * the next byte.  Mode 1 (CPHA = 1) so SS can stay
+ * low for a whole burst.
+ *
+ * Every byte received goes into the RX ring, SPRF
+ * interrupt.  The TX ring is drained into SPID from
+ * the SPTEF interrupt, which is only on while the
+ * ring has data.  When it runs empty SPISLAVE_IDLE
+ * goes out.  A byte queued now goes out one byte
+ * after the one in SPID.
+ *
+ * Rate - the hardware limit for a slave is SCK at
+ * bus / 4.  The ISR has to take each byte before the
+ * next one is in, so the real limit is the ISR time
+ * plus the longest stretch with interrupts disabled,
+ * not measured here.  A master that is too fast shows
+ * up in the dropped and idle counters.
+ */
+
+#ifndef SPISLAVE_H_
+#define SPISLAVE_H_
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+
+//ring sizes, powers of two
+#define SPISLAVE_RX_SIZE			16
+#define SPISLAVE_TX_SIZE			64
+
+#define SPISLAVE_IDLE				0x00
+
+
+/////////////////////////////////////////
+//Counters
+//rxBytes / txBytes - bytes moved by the ISR
+//rxDropped - received with the RX ring full
+//txIdle - received with the TX ring empty, the
+//host clocked faster than it was filled
+typedef struct
+{
+	uint16_t rxBytes;
+	uint16_t txBytes;
+	uint16_t rxDropped;
+	uint16_t txIdle;
+}SPISlave_Counters_t;
+
+
+void SPISlave_init(void);
+
+uint8_t SPISlave_read(uint8_t *far data);
+uint8_t SPISlave_write(uint8_t data);
+uint8_t SPISlave_getTxFree(void);
+
+void SPISlave_getCounters(SPISlave_Counters_t *far counters);
+void SPISlave_resetCounters(void);
+
+
+#endif /* SPISLAVE_H_ */
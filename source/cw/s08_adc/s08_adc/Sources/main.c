@@ -23,14 +23,75 @@
  * interrupt at a specified rate based on the
  * 1khz low power clock source.  See rtc.c / rtc.h
  * 
- * SPI peripheral used to output the values read by
- * the ADC.  SPI Pins: PB2 - PB5
+ * SPI peripheral, slave, used to stream the values
+ * read by the ADC.  SPI Pins: PB2 - PB5
  * 
  *  PB2 - SCK		Pin 18
  *  PB3 - MOSI		Pin 17
  *  PB4 - MISO		Pin 12
- *  PB5 - SS - 		Pin 11 - Configure as normal IO
+ *  PB5 - SS - 		Pin 11 - hardware slave select
  * 
+ * Sensor Hub:
+ * The board is an I2C slave at HUB_I2C_ADDRESS on
+ * PA2 (SDA) and PA3 (SCL), see i2cslave.h.  The hub
+ * task samples channels 8, 9 and the temp sensor
+ * every HUB_REG_PERIOD RTC ticks, filters them and
+ * publishes them to the register map while the bus
+ * is idle.  The IIC ISR serves the map.  The main
+ * loop is the scheduler and the SPI poll, see sched.h.
+ * 
+ * The channels are converted by the ADC scan sequencer
+ * in the background, see adc.h, and a sample is a
+ * snapshot of the last pass.  Raw registers are the
+ * counts as converted, filtered and temp are corrected
+ * with the sequencer's bandgap calibration.  CH8
+ * and CH9 go through the IIR in filter.h, the temp
+ * sensor through a median of 3 that drops spikes.
+ * 
+ * Register Map - 16 bit values MSB first:
+ * 0x00 - ID, HUB_ID						R
+ * 0x01 - VERSION							R
+ * 0x02 - CH8 raw counts					R
+ * 0x04 - CH9 raw counts					R
+ * 0x06 - TEMP sensor raw counts			R
+ * 0x08 - CH8 filtered counts				R
+ * 0x0A - CH9 filtered counts				R
+ * 0x0C - TEMP, 10ths of a deg F, signed	R
+ * 0x0E - sample count, wraps				R
+ * 0x10 - PERIOD, RTC ticks per sample		RW
+ * 0x11 - FILTER, IIR shift 0 - 7			RW
+ * 0x12 - CONTROL, bit 0 = sampling on		RW
+ * 
+ * SPI Stream:
+ * The SPI is a slave on PB2 - PB5, see spislave.h,
+ * for streaming samples faster than the i2c.  Command
+ * bytes have bit 7 set, arguments and the bytes the
+ * host clocks to read are below 0x80, so the host can
+ * always resync by sending a command.  Responses start
+ * with HUB_SPI_SYNC and a length, the host clocks
+ * 0x00 until it sees the sync byte.
+ * 0x81 - STATUS, 10 bytes: SPI rx, tx, dropped, idle
+ *        counts and the sample count, 16 bit MSB first
+ * 0x82 n - STREAM n (1 - 127) CH8 conversions, 2n
+ *        bytes MSB first, continuous conversion at
+ *        ADC_CONT_RATE_HZ.  The scan is stopped and the
+ *        hub registers are not sampled while a stream
+ *        runs.
+ * 0x83 - RESET the SPI counters, no response
+ * 
+ * Memory Allocation:
+ * Small memory model, DEFAULT_RAM in RAM 0x100 - 0x25F
+ * with the 64 byte stack - 288 bytes for variables.
+ * main 130, adc 105, i2cslave 10, spislave 8, rtc 3,
+ * sched 12, power 1 - 269 used.  The scan snapshot is a static, 29 bytes
+ * is too much for the stack.
+ * 
+ * Zero page 0x60 - 0xFF, 160 bytes, MY_ZEROPAGE - the
+ * SPI slave rings, 84 used.
+ * 
+ * RAM_FIXED below is the part of the table not sized
+ * by a define, keep it up to date.  A ring or buffer
+ * that grows past the budget stops the build.
  *  
  */
 
@@ -41,8 +102,62 @@
 #include <stddef.h>
 #include "config.h"
 #include "rtc.h"
-#include "spi.h"
+#include "clock.h"
+#include "power.h"
+#include "sched.h"
+#include "spislave.h"
 #include "adc.h"
+#include "i2cslave.h"
+#include "filter.h"
+
+//sensor hub
+#define HUB_I2C_ADDRESS			0x48
+#define HUB_ID					0xAD
+#define HUB_VERSION				0x01
+
+#define HUB_REG_ID				0x00
+#define HUB_REG_VERSION			0x01
+#define HUB_REG_CH8				0x02
+#define HUB_REG_CH9				0x04
+#define HUB_REG_TEMP_RAW		0x06
+#define HUB_REG_CH8_FILTERED	0x08
+#define HUB_REG_CH9_FILTERED	0x0A
+#define HUB_REG_TEMP			0x0C
+#define HUB_REG_SAMPLES			0x0E
+#define HUB_REG_PERIOD			0x10
+#define HUB_REG_FILTER			0x11
+#define HUB_REG_CONTROL			0x12
+#define HUB_MAP_SIZE			0x13
+
+#define HUB_NUM_READ_ONLY		HUB_REG_PERIOD
+#define HUB_NUM_FILTERS			2
+#define HUB_FILTER_MAX			FILTER_SMOOTH_MAX_SHIFT
+#define HUB_CONTROL_RUN			BIT0
+#define HUB_NUM_SCAN			3			//CH8, CH9, TEMP
+
+#define HUB_SPI_CMD_STATUS		0x81
+#define HUB_SPI_CMD_STREAM		0x82
+#define HUB_SPI_CMD_RESET		0x83
+#define HUB_SPI_SYNC			0xA5
+#define HUB_SPI_STATUS_LENGTH	10
+
+//RAM budget, see Memory Allocation
+#define RAM_BUDGET				288			//0x100 - 0x25F less the stack
+#define RAM_FIXED				202
+#define ZERO_PAGE_BUDGET		160			//0x60 - 0xFF
+#define ZERO_PAGE_FIXED			4
+
+#if (((ADC_RING_SIZE * 2) + HUB_MAP_SIZE + HUB_NUM_READ_ONLY + RAM_FIXED) > RAM_BUDGET)
+#error "main.c - RAM over budget, see Memory Allocation"
+#endif
+
+#if ((SPISLAVE_RX_SIZE + SPISLAVE_TX_SIZE + ZERO_PAGE_FIXED) > ZERO_PAGE_BUDGET)
+#error "main.c - zero page over budget, see Memory Allocation"
+#endif
+
+#if INSTRUMENT
+#error "main.c - INSTRUMENT needs TPM2 for timer.c, adc.c uses it here"
+#endif
 
 //prototypes
 void System_init(void);
@@ -55,39 +170,299 @@ void LED_On_Green(void);
 void LED_Off_Red(void);
 void LED_Off_Green(void);
 
-unsigned char tx[3] = {0xAA, 0xBB, 0xCE};
-uint16_t result = 0x00;
-uint8_t high = 0x00;
-uint8_t low = 0x00;
-int16_t temperature = 0x00;
+void Hub_init(void);
+void Hub_sample(void);
+void Hub_publish(void);
+void Hub_put16(uint8_t *far reg, uint16_t value);
+uint16_t Hub_filter(uint8_t index, uint16_t raw);
+void Hub_spiPoll(void);
+void Hub_spiStatus(void);
+void Task_hub(void);
+
+//scan list, snapshot order
+static const ADC_Channel_t mHubScan[HUB_NUM_SCAN] = {ADC_CHANNEL_8, ADC_CHANNEL_9, ADC_CHANNEL_TEMP_SENSOR};
+
+//register map - served by the IIC ISR, and the
+//read only part staged until the bus is idle
+static uint8_t mHubMap[HUB_MAP_SIZE] = {0x00};
+static uint8_t mHubStage[HUB_NUM_READ_ONLY] = {0x00};
+static uint8_t mHubPending = 0x00;
+
+//IIR filter state - CH8, CH9, temp spike filter
+static Filter_Smoother_t mHubFilter[HUB_NUM_FILTERS] = {0x00};
+static Filter_Median_t mHubTempMedian = {0x00};
+static uint16_t mHubSamples = 0x00;
+
+//last scan pass, a static - too big for the stack
+static ADC_Snapshot_t mHubSnapshot = {0x00};
+
+//SPI command in progress, samples left to stream
+static uint8_t mHubSpiCommand = 0x00;
+static uint8_t mHubSpiStream = 0x00;
+
+//ticks since the last sample, ticks to the next
+static uint8_t mHubTicks = 0x00;
+static uint8_t mHubWait = 0x00;
+
+////////////////////////////////////////////
+//Task table - RTC at 100hz, 10ms per tick
+static const Sched_Task_t taskTable[] =
+{
+	//task				period		offset	priority
+	{Task_hub,			1,			0,		0},
+};
+
+#define NUM_TASKS		(sizeof(taskTable) / sizeof(Sched_Task_t))
 
 void main(void) 
 {
 	DisableInterrupts;			//disable interrupts
 	System_init();				//configure system level config bits
+	Clock_init();				//internal reference, 4mhz bus
 	RTC_init(RTC_FREQ_100HZ);	//Timer
+	Power_init();				//WAIT between interrupts
 	GPIO_init();				//IO
-	SPI_init();
 	ADC_init();
+	Hub_init();					//register map and i2c slave
+	SPISlave_init();			//sample stream
+	Sched_init(taskTable, NUM_TASKS);
 	EnableInterrupts;			//enable interrupts
 	
 	while (1)
+	{
+		Sched_run();
+		Hub_spiPoll();				//SPI commands and streams
+	}
+}
+
+
+////////////////////////////////////////////
+//Task_hub
+//Runs every tick.  Samples every HUB_REG_PERIOD
+//ticks, or every tick while a publish is pending.
+void Task_hub(void)
+{
+	if (++mHubTicks < mHubWait)
+		return;
+
+	mHubTicks = 0x00;
+
+	if ((mHubMap[HUB_REG_CONTROL] & HUB_CONTROL_RUN) && (mHubSpiStream == 0))
 	{
 		LED_Toggle_Red();
+		Hub_sample();
+	}
 
-		//read the temp
-		temperature = ADC_readTemp();
-		result = (uint16_t)temperature;
-		
-		high = (result >> 8) & 0xFF;
-		low = result & 0xFF;
+	//try again each tick until the bus is idle
+	if (mHubPending)
+		Hub_publish();
+
+	mHubWait = mHubPending ? 1 : mHubMap[HUB_REG_PERIOD];
+}
+
+
+////////////////////////////////////////////
+//Hub_spiPoll
+//Run the received SPI bytes through the command
+//parser, then keep a stream going while there is
+//room for a sample in the TX ring.
+void Hub_spiPoll(void)
+{
+	uint8_t data = 0x00;
+	uint16_t raw = 0x00;
+	uint8_t running = (mHubSpiStream > 0) ? 1 : 0;
+
+	while (SPISlave_read(&data))
+	{
+		//a command - any one in progress is dropped
+		if (data & BIT7)
+		{
+			mHubSpiCommand = 0x00;
+			mHubSpiStream = 0x00;
 
-		//output the result
-		SPI_write(high);
-		SPI_write(low);
+			switch (data)
+			{
+				case HUB_SPI_CMD_STATUS:	Hub_spiStatus();				break;
+				case HUB_SPI_CMD_STREAM:	mHubSpiCommand = data;			break;
+				case HUB_SPI_CMD_RESET:		SPISlave_resetCounters();		break;
+				default:													break;
+			}
+		}
 
-		RTC_delay(20);
+		//stream count, header now, samples below
+		else if ((mHubSpiCommand == HUB_SPI_CMD_STREAM) && (data > 0))
+		{
+			mHubSpiCommand = 0x00;
+			mHubSpiStream = data;
+			(void)SPISlave_write(HUB_SPI_SYNC);
+			(void)SPISlave_write((uint8_t)(data << 1));
+		}
 	}
+
+	//start or stop the conversions with the stream,
+	//the scan gives the ADC up while it runs
+	if (!running && (mHubSpiStream > 0))
+		ADC_startContinuous(ADC_CHANNEL_8);
+	else if (running && (mHubSpiStream == 0))
+		ADC_startScan(mHubScan, HUB_NUM_SCAN);
+
+	//one result at a time, only what the TX ring
+	//has room for leaves the ADC ring
+	while ((mHubSpiStream > 0) && (SPISlave_getTxFree() >= 2))
+	{
+		if (ADC_readBuffer(&raw, 1) == 0)
+			break;
+
+		(void)SPISlave_write((uint8_t)(raw >> 8));
+		(void)SPISlave_write((uint8_t)(raw & 0xFF));
+		mHubSpiStream--;
+
+		if (mHubSpiStream == 0)
+			ADC_startScan(mHubScan, HUB_NUM_SCAN);
+	}
+}
+
+
+////////////////////////////////////////////
+//Queue the STATUS response
+void Hub_spiStatus(void)
+{
+	SPISlave_Counters_t counters;
+	uint8_t data[HUB_SPI_STATUS_LENGTH];
+	uint8_t i = 0x00;
+
+	if (SPISlave_getTxFree() < (HUB_SPI_STATUS_LENGTH + 2))
+		return;
+
+	SPISlave_getCounters(&counters);
+	Hub_put16(&data[0], counters.rxBytes);
+	Hub_put16(&data[2], counters.txBytes);
+	Hub_put16(&data[4], counters.rxDropped);
+	Hub_put16(&data[6], counters.txIdle);
+	Hub_put16(&data[8], mHubSamples);
+
+	(void)SPISlave_write(HUB_SPI_SYNC);
+	(void)SPISlave_write(HUB_SPI_STATUS_LENGTH);
+	for (i = 0 ; i < HUB_SPI_STATUS_LENGTH ; i++)
+		(void)SPISlave_write(data[i]);
+}
+
+
+////////////////////////////////////////////
+//Hub_init
+//Default config - sample every 100ms, filter 1/8,
+//sampling on - then start answering on the bus.
+void Hub_init(void)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < HUB_MAP_SIZE ; i++)
+		mHubMap[i] = 0x00;
+
+	for (i = 0 ; i < HUB_NUM_READ_ONLY ; i++)
+		mHubStage[i] = 0x00;
+
+	for (i = 0 ; i < HUB_NUM_FILTERS ; i++)
+		Filter_smoothInit(&mHubFilter[i], FILTER_SMOOTH_IIR, 3, FILTER_ADC_BITS);
+
+	Filter_medianInit(&mHubTempMedian, 3);
+
+	mHubSamples = 0x00;
+	mHubPending = 0x00;
+
+	mHubMap[HUB_REG_ID] = HUB_ID;
+	mHubMap[HUB_REG_VERSION] = HUB_VERSION;
+	mHubMap[HUB_REG_PERIOD] = 10;
+	mHubMap[HUB_REG_FILTER] = 3;
+	mHubMap[HUB_REG_CONTROL] = HUB_CONTROL_RUN;
+
+	mHubStage[HUB_REG_ID] = HUB_ID;
+	mHubStage[HUB_REG_VERSION] = HUB_VERSION;
+
+	I2CSlave_init(HUB_I2C_ADDRESS, mHubMap, HUB_MAP_SIZE, HUB_NUM_READ_ONLY);
+	ADC_startScan(mHubScan, HUB_NUM_SCAN);
+}
+
+
+////////////////////////////////////////////
+//Hub_sample
+//Take a snapshot of the scan, run the filters and
+//stage the results.  Nothing until the first pass
+//is done.  The config registers are written by
+//the master at any time, bad values are fixed here.
+void Hub_sample(void)
+{
+	uint16_t raw = 0x00;
+
+	if (mHubMap[HUB_REG_PERIOD] == 0)
+		mHubMap[HUB_REG_PERIOD] = 1;
+
+	if (mHubMap[HUB_REG_FILTER] > HUB_FILTER_MAX)
+		mHubMap[HUB_REG_FILTER] = HUB_FILTER_MAX;
+
+	ADC_getSnapshot(&mHubSnapshot);
+	if (mHubSnapshot.passes == 0)
+		return;
+
+	Hub_put16(&mHubStage[HUB_REG_CH8], mHubSnapshot.raw[0]);
+	Hub_put16(&mHubStage[HUB_REG_CH8_FILTERED], Hub_filter(0, mHubSnapshot.value[0]));
+
+	Hub_put16(&mHubStage[HUB_REG_CH9], mHubSnapshot.raw[1]);
+	Hub_put16(&mHubStage[HUB_REG_CH9_FILTERED], Hub_filter(1, mHubSnapshot.value[1]));
+
+	Hub_put16(&mHubStage[HUB_REG_TEMP_RAW], mHubSnapshot.raw[2]);
+	raw = Filter_median(&mHubTempMedian, mHubSnapshot.value[2]);
+	Hub_put16(&mHubStage[HUB_REG_TEMP], (uint16_t)ADC_codeToTempF(raw));
+
+	mHubSamples++;
+	Hub_put16(&mHubStage[HUB_REG_SAMPLES], mHubSamples);
+
+	mHubPending = 1;
+}
+
+
+////////////////////////////////////////////
+//Hub_publish
+//Copy the staged values into the map if no transfer
+//is on the bus.  Interrupts are disabled so a start
+//can't come in between the check and the copy.
+void Hub_publish(void)
+{
+	uint8_t i = 0x00;
+
+	DisableInterrupts;
+
+	if (I2CSlave_isIdle())
+	{
+		for (i = 0 ; i < HUB_NUM_READ_ONLY ; i++)
+			mHubMap[i] = mHubStage[i];
+
+		mHubPending = 0x00;
+	}
+
+	EnableInterrupts;
+}
+
+
+////////////////////////////////////////////
+//Write a 16 bit register, MSB first
+void Hub_put16(uint8_t *far reg, uint16_t value)
+{
+	reg[0] = (uint8_t)(value >> 8);
+	reg[1] = (uint8_t)(value & 0xFF);
+}
+
+
+////////////////////////////////////////////
+//Hub_filter
+//First order IIR with the FILTER register as the
+//shift, see filter.h.  Shift 0 is no filtering, the
+//first sample seeds the state.  Returns counts.
+uint16_t Hub_filter(uint8_t index, uint16_t raw)
+{
+	mHubFilter[index].shift = mHubMap[HUB_REG_FILTER];
+
+	return Filter_smooth(&mHubFilter[index], raw);
 }
 
 
@@ -74,8 +74,8 @@ void ADC_init(void)
 	//clock divider bits - see Table 10-7
 	// 00 = input clock
 	// 11 = input clock / 8
-	ADCCFG_ADIV0 = 0x00;		//clock divider bit 0
-	ADCCFG_ADIV1 = 0x00;		//clock divider bit 1
+	//computed from the bus clock, see adc.h
+	ADCCFG_ADIV = ADC_ADIV(CLOCK_BUS_FREQ_HZ);
 	
 	ADCCFG_ADLSMP = 0x00;		//short sample time
 
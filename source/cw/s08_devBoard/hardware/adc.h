@@ -15,6 +15,7 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
 
 ////////////////////////////////////////////////////////
 //See Table 17 in the spec sheet.  Values used to compute
@@ -26,6 +27,15 @@
 #define ADC_TEMP_SLOPE_OVER25		1769		//1.769 - slope of the mV/C curve
 #define ADC_VREFH					3260
 
+////////////////////////////////////////////////////////
+//ADC clock - ADCK is the bus clock divided by 2^ADIV.
+//Max 8mhz in high speed mode (ADLPC = 0), see Table 17
+#define ADC_ADCK_MAX_HZ				8000000UL
+
+#define ADC_ADIV(bus)		(((bus) <= ADC_ADCK_MAX_HZ) ? 0 :			\
+							((bus) <= (ADC_ADCK_MAX_HZ << 1)) ? 1 :		\
+							((bus) <= (ADC_ADCK_MAX_HZ << 2)) ? 2 : 3)
+
 typedef enum
 {
 	ADC_CHANNEL_8 = 0x08,
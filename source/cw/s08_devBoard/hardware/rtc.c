@@ -99,6 +99,15 @@ void RTC_delay(unsigned int delay)
 }
 
 
+/////////////////////////////////////////////
+//Returns the number of RTC ticks since power up,
+//8khz with RTC_init_external
+unsigned long RTC_getTimeTick(void)
+{
+	return gTimeTick;
+}
+
+
 ////////////////////////////////////////////////
 //RTC Interrupt Routine
 //Syntax is the following:
@@ -33,6 +33,7 @@ typedef enum
 void RTC_init_internal(RTC_Frequency_t freq);
 void RTC_init_external(void);
 void RTC_delay(unsigned int delay);
+unsigned long RTC_getTimeTick(void);
 
 
 #endif /* RTC_H_ */
@@ -0,0 +1,127 @@
+/*
+ * sched.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Cooperative run to completion scheduler.  The
+ * application declares a static task table in ROM,
+ * each task with a period and offset in RTC ticks and
+ * a priority (0 = highest).  Sched_run() is called
+ * from the main loop.  Every time the RTC ticks it
+ * releases the tasks that are due and runs the highest
+ * priority one to completion.  When nothing is due
+ * the core sleeps until the next interrupt.
+ *
+ * With INSTRUMENT the worst case execution time of
+ * each task is measured with the TPM2 timer, in
+ * TIMER_TICK_US units, 2 more bytes per slot in
+ * FAR_RAM.
+ *
+ * RAM use - 2 bytes per task slot (SCHED_MAX_TASKS)
+ * plus 4, everything else is in the const task table.
+ * Keep SCHED_MAX_TASKS near the table size, the
+ * slots are in DEFAULT_RAM, which is Z_RAM on the
+ * game board, see main.c
+ *
+ * The game board, the ADC sensor hub, the i2c and the
+ * dev board run on it, each with the same copy.  The
+ * UART board does not, its RTC is the ADC trigger and
+ * the tick stops while it samples, so it sleeps on the
+ * ADC ring instead (POWER_SLEEP_WHILE).
+ *
+ * The main loop is Sched_run followed by the polls
+ * that finish interrupt driven work.  Sched_run
+ * returns after each interrupt when nothing is due,
+ * so the polls run as soon as there is something
+ * to do.
+ *
+ * Protothreads:
+ * Multi-step sequences (game over screen, etc) can be
+ * written as a function that returns at each wait and
+ * picks up at the same line on the next call.  Local
+ * variables do not survive a wait, keep state in
+ * statics.  Do not use a switch statement inside a
+ * protothread.
+ *
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS			4
+#endif
+
+//one bit per task in the run once done mask
+#if (SCHED_MAX_TASKS > 8)
+#error "sched.h - SCHED_MAX_TASKS must be 8 or less"
+#endif
+#define SCHED_NO_TASK			0xFF
+
+//return values from a protothread
+#define SCHED_PT_WAITING		0
+#define SCHED_PT_DONE			1
+
+
+/////////////////////////////////////////
+//Task Definition
+//period - RTC ticks between releases, 0 = run once,
+//after that the slot is done until Sched_init
+//offset - RTC ticks before the first release
+//priority - 0 is the highest
+typedef struct
+{
+	void (*task)(void);
+	uint16_t period;
+	uint16_t offset;
+	uint8_t priority;
+}Sched_Task_t;
+
+
+/////////////////////////////////////////
+//Protothread state
+//lc - line to resume at, 0 = start
+//wake - tick to wait for in SCHED_PT_DELAY
+typedef struct
+{
+	uint16_t lc;
+	uint16_t wake;
+}Sched_Pt_t;
+
+
+#define SCHED_PT_INIT(pt)			{ (pt)->lc = 0; }
+
+#define SCHED_PT_BEGIN(pt)			switch((pt)->lc) { case 0:
+
+#define SCHED_PT_WAIT_UNTIL(pt, cond)	\
+	(pt)->lc = __LINE__; case __LINE__:	\
+	if (!(cond)) return SCHED_PT_WAITING
+
+#define SCHED_PT_YIELD(pt)				\
+	(pt)->lc = __LINE__; return SCHED_PT_WAITING; case __LINE__:
+
+#define SCHED_PT_DELAY(pt, ticks)		\
+	(pt)->wake = Sched_getTick() + (ticks);	\
+	SCHED_PT_WAIT_UNTIL(pt, Sched_isTickReached((pt)->wake))
+
+#define SCHED_PT_END(pt)			} (pt)->lc = 0; return SCHED_PT_DONE
+
+
+void Sched_init(const Sched_Task_t *far table, uint8_t numTasks);
+void Sched_run(void);
+
+uint16_t Sched_getTick(void);
+uint8_t Sched_isTickReached(uint16_t tick);
+
+#if INSTRUMENT
+uint16_t Sched_getWcet(uint8_t index);
+void Sched_clearWcet(void);
+#endif
+
+
+#endif /* SCHED_H_ */
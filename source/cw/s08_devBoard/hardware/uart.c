@@ -36,29 +36,24 @@ volatile uint8_t rxBuffer[UART_BUFFER_SIZE];//data buffer
 //Configure the uart peripheral for 9600 baud, tx/rx,
 //rx interrupt enabled, 8bit, no parity, 1 stop bit
 //See Section 14.2.1
-//Baud rate = bus speed / divider.
-//No idea what the bus speed is. - 264khz?
-//through trial and error, rates of 115200 and 
-//57600 don't work when using internal clock
+//Baud rate = bus speed / (16 * divider), the divider
+//is computed from CLOCK_BUS_FREQ_HZ, see uart.h
 //
-//When using the default bus speed, available
-//rates 9600, 19200, and 38400
+//Available rates 9600, 19200, and 38400
 void UART_init(BaudRate_t rate)
 {
 	char* result = memset(rxBuffer, 0x00, UART_BUFFER_SIZE);	//clear the buffer
 	rxIndex = 0x00;								//reset the index
 	rxFlag = 0x00;								//reset the flag
 	
-	//default rate = 9600
-	SCIBDH = 0x00;
-	SCIBDL = 0x1C;		//divider 28
-	
+	//SCIBD - write the high byte first, the rate
+	//does not change until the low byte is written
 	switch(rate)
 	{
-		case BAUD_RATE_9600:	SCIBDL = 0x1C;	break;
-		case BAUD_RATE_19200:	SCIBDL = 0x0E;	break;
-		case BAUD_RATE_38400:	SCIBDL = 0x07;	break;
-		default: 				SCIBDL = 0x1C;	break;
+		case BAUD_RATE_9600:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 9600UL);		break;
+		case BAUD_RATE_19200:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 19200UL);	break;
+		case BAUD_RATE_38400:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 38400UL);	break;
+		default: 				SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 9600UL);		break;
 	}
 	
 	//SCIC1 - Control register 1
@@ -21,9 +21,15 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
 
 #define UART_BUFFER_SIZE		32
 
+//////////////////////////////////////////////
+//Baud rate divider - Section 14.2.1
+//baud = bus / (16 * SBR), rounded to nearest
+#define UART_SBR(bus, baud)		((uint16_t)(((bus) + ((baud) << 3)) / ((baud) << 4)))
+
 
 typedef enum
 {
@@ -35,6 +35,8 @@
 #include "spi.h"
 #include "adc.h"
 #include "uart.h"
+#include "power.h"
+#include "sched.h"
 
 #define MAX_FLASH_ROUTINE		10
 
@@ -42,11 +44,25 @@
 //prototypes
 void System_init(void);
 void GPIO_init(void);
+void Task_blink(void);
 
 //globals
 volatile char flashRoutine = 0x00;
 uint8_t tx[4] = {0xAA, 0xCC, 0xAA, 0xCC};
 
+////////////////////////////////////////////
+//Task table - RTC on the external clock, 8khz,
+//8 ticks per ms, see rtc.c
+#define BLINK_TICKS		(500 << 3)
+
+static const Sched_Task_t taskTable[] =
+{
+	//task				period			offset	priority
+	{Task_blink,		BLINK_TICKS,	0,		0},
+};
+
+#define NUM_TASKS		(sizeof(taskTable) / sizeof(Sched_Task_t))
+
 void main(void)
 {
 	DisableInterrupts;			//disable interrupts
@@ -54,20 +70,31 @@ void main(void)
 	Clock_init();				//configure clock for external
 //	RTC_init_internal(RTC_FREQ_1000HZ);	//Timer
 	RTC_init_external();		//configure as external	
+	Power_init();				//WAIT between interrupts, the RTC needs the bus clock
 	GPIO_init();				//IO	
 	SPI_init();
+	Sched_init(taskTable, NUM_TASKS);
 	
 	EnableInterrupts;			//enable interrupts
 	
 	while (1)
 	{
-		PTAD ^= BIT2;			//toggle an led
-		SPI_writeArray(tx, 4);	//send something over SPI
-		RTC_delay(500);			//wait
+		Sched_run();
 	}
 }
 
 
+////////////////////////////////////////////
+//Task_blink
+//Every 500ms - toggle an led and send something
+//over SPI
+void Task_blink(void)
+{
+	PTAD ^= BIT2;			//toggle an led
+	SPI_writeArray(tx, 4);	//send something over SPI
+}
+
+
 ////////////////////////////////////////////
 //Configure system level registers - SOPT1 / SOPT2
 //These are write one-time registers.  Changing
@@ -0,0 +1,380 @@
+/*
+ * assets.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Game assets from the i2c eeprom through a small
+ * LRU cache.  See assets.h
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "assets.h"
+#include "i2c.h"
+
+
+/////////////////////////////////////////
+//Slot states
+#define ASSETS_SLOT_EMPTY			0
+#define ASSETS_SLOT_LOADING			1
+#define ASSETS_SLOT_VALID			2
+#define ASSETS_SLOT_MISSING			3
+
+
+/////////////////////////////////////////
+//Cache Slot
+//id - asset in the slot, ASSETS_NONE if empty
+//state - ASSETS_SLOT_xx
+//record - header and data as read
+typedef struct
+{
+	uint8_t id;
+	uint8_t state;
+	uint8_t record[ASSETS_HEADER_SIZE + ASSETS_DATA_SIZE];
+}Assets_Slot_t;
+
+
+/////////////////////////////////////////////
+//Assets Variables
+//mSlots - the cache
+//mOrder - slot numbers, most recently used first
+//mQueue - ids waiting to be read, mQueueHead is the
+//next one, mQueueCount how many
+//mXfer - the read on the bus
+//mLoadSlot - slot mXfer reads into
+//mHits / mMisses - Assets_get results since init,
+//only with INSTRUMENT
+//All of it is in FAR_RAM, Z_RAM is full, see main.c
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static Assets_Slot_t mSlots[ASSETS_CACHE_SLOTS] = {0x00};
+static uint8_t mOrder[ASSETS_CACHE_SLOTS] = {0x00};
+static uint8_t mQueue[ASSETS_QUEUE_SIZE] = {0x00};
+static uint8_t mQueueHead = 0x00;
+static uint8_t mQueueCount = 0x00;
+static I2C_Transfer_t mXfer = {0x00};
+static uint8_t mLoadSlot = 0x00;
+#if INSTRUMENT
+static uint16_t mHits = 0x00;
+static uint16_t mMisses = 0x00;
+#endif
+#pragma DATA_SEG DEFAULT
+
+
+static uint8_t Assets_find(uint8_t id);
+static void Assets_touch(uint8_t slot);
+static uint8_t Assets_isQueued(uint8_t id);
+static void Assets_loadDone(I2C_Transfer_t *far xfer);
+
+
+///////////////////////////////////////////
+//Assets_init
+//Empty the cache and the queue.  Call once at power
+//up, before anything is prefetched.
+void Assets_init(void)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < ASSETS_CACHE_SLOTS ; i++)
+	{
+		mSlots[i].id = ASSETS_NONE;
+		mSlots[i].state = ASSETS_SLOT_EMPTY;
+		mOrder[i] = i;
+	}
+
+	mQueueHead = 0x00;
+	mQueueCount = 0x00;
+	mXfer.status = IIC_READY_STATUS;
+	mLoadSlot = 0x00;
+
+#if INSTRUMENT
+	mHits = 0x00;
+	mMisses = 0x00;
+#endif
+}
+
+
+///////////////////////////////////////////
+//Assets_poll
+//Call from the main loop.  If no read is on the bus,
+//start the next queued one into the least recently
+//used slot that isn't loading.  Ids already in the
+//cache are dropped from the queue.
+void Assets_poll(void)
+{
+	uint8_t id = ASSETS_NONE;
+	uint8_t i = 0x00;
+	uint8_t slot = 0x00;
+
+	if (mXfer.status == IIC_QUEUED_STATUS)
+		return;
+
+	while (mQueueCount > 0)
+	{
+		id = mQueue[mQueueHead];
+		mQueueHead = (mQueueHead + 1) & (ASSETS_QUEUE_SIZE - 1);
+		mQueueCount--;
+
+		if (Assets_find(id) == ASSETS_NONE)
+			break;
+
+		id = ASSETS_NONE;
+	}
+
+	if (id == ASSETS_NONE)
+		return;
+
+	//LRU victim
+	for (i = ASSETS_CACHE_SLOTS ; i > 0 ; i--)
+	{
+		slot = mOrder[i - 1];
+		if (mSlots[slot].state != ASSETS_SLOT_LOADING)
+			break;
+	}
+
+	mSlots[slot].id = id;
+	mSlots[slot].state = ASSETS_SLOT_LOADING;
+	Assets_touch(slot);
+	mLoadSlot = slot;
+
+	mXfer.address = ASSETS_I2C_ADDRESS;
+	mXfer.memoryAddress = (uint16_t)id * ASSETS_RECORD_SIZE;
+	mXfer.memoryAddressSize = ASSETS_ADDRESS_SIZE;
+	mXfer.txData = NULL;
+	mXfer.txLength = 0;
+	mXfer.rxData = mSlots[slot].record;
+	mXfer.rxLength = ASSETS_HEADER_SIZE + ASSETS_DATA_SIZE;
+	mXfer.flags = I2C_FLAG_RESTART;
+	mXfer.callback = Assets_loadDone;
+
+	I2C_submit(&mXfer);
+}
+
+
+///////////////////////////////////////////
+//Assets_get
+//Returns the record of an asset in the cache, header
+//then data, or NULL if it is not loaded yet or is
+//missing.  A miss queues the asset, the bus is not
+//touched here so it can be called while drawing.
+const uint8_t *far Assets_get(uint8_t id)
+{
+	uint8_t slot = ASSETS_NONE;
+
+	if (id == ASSETS_NONE)
+		return NULL;
+
+	slot = Assets_find(id);
+	if (slot == ASSETS_NONE)
+	{
+#if INSTRUMENT
+		mMisses++;
+#endif
+		Assets_prefetch(id);
+		return NULL;
+	}
+
+	if (mSlots[slot].state != ASSETS_SLOT_VALID)
+		return NULL;
+
+#if INSTRUMENT
+	mHits++;
+#endif
+	Assets_touch(slot);
+
+	return mSlots[slot].record;
+}
+
+
+///////////////////////////////////////////
+//Assets_getImage
+//Fill image with a sprite in the cache.  image comes
+//in holding the built in bitmap, the sprite has to
+//be the same size and its data has to cover all of
+//the rows (bytes per row * ySize).  Returns 1 if it
+//is there and fits, 0 if not - image is not changed
+//and the built in bitmap is drawn.  The data pointer
+//is good until the next Assets_poll.
+uint8_t Assets_getImage(uint8_t id, ImageData *far image)
+{
+	const uint8_t *far record = Assets_get(id);
+	uint16_t bytes = 0x00;
+
+	if ((record == NULL) || (record[ASSETS_RECORD_TYPE] != ASSETS_TYPE_SPRITE))
+		return 0;
+
+	if ((record[ASSETS_RECORD_X_SIZE] != image->xSize) ||
+		(record[ASSETS_RECORD_Y_SIZE] != image->ySize))
+		return 0;
+
+	bytes = (uint16_t)((record[ASSETS_RECORD_X_SIZE] + 7) >> 3) * record[ASSETS_RECORD_Y_SIZE];
+	if (bytes > record[ASSETS_RECORD_LENGTH])
+		return 0;
+
+	image->xSize = record[ASSETS_RECORD_X_SIZE];
+	image->ySize = record[ASSETS_RECORD_Y_SIZE];
+	image->pImageData = (uint8_t *far)&record[ASSETS_RECORD_DATA];
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Returns entry index of a level record, an asset
+//id, or ASSETS_NONE if the level is not loaded or
+//has no such entry
+uint8_t Assets_getLevelAsset(uint8_t level, uint8_t index)
+{
+	const uint8_t *far record = NULL;
+
+	if (level >= (ASSETS_NONE - ASSETS_LEVEL_BASE))
+		return ASSETS_NONE;
+
+	record = Assets_get(ASSETS_LEVEL_BASE + level);
+	if ((record == NULL) || (record[ASSETS_RECORD_TYPE] != ASSETS_TYPE_LEVEL))
+		return ASSETS_NONE;
+
+	if (index >= record[ASSETS_RECORD_LENGTH])
+		return ASSETS_NONE;
+
+	return record[ASSETS_RECORD_DATA + index];
+}
+
+
+///////////////////////////////////////////
+//Assets_prefetch
+//Queue an asset to be read by Assets_poll.  Does
+//nothing if it is cached, loading, missing, already
+//queued or the queue is full.
+void Assets_prefetch(uint8_t id)
+{
+	if ((id == ASSETS_NONE) || (Assets_find(id) != ASSETS_NONE) || Assets_isQueued(id))
+		return;
+
+	if (mQueueCount >= ASSETS_QUEUE_SIZE)
+		return;
+
+	mQueue[(mQueueHead + mQueueCount) & (ASSETS_QUEUE_SIZE - 1)] = id;
+	mQueueCount++;
+}
+
+
+///////////////////////////////////////////
+//Queue a level record, the assets it lists are
+//queued when it arrives
+void Assets_prefetchLevel(uint8_t level)
+{
+	if (level < (ASSETS_NONE - ASSETS_LEVEL_BASE))
+		Assets_prefetch(ASSETS_LEVEL_BASE + level);
+}
+
+
+///////////////////////////////////////////
+//Assets_loadDone
+//I2C callback for a load, from I2C_poll.  A read
+//error frees the slot, the next miss queues it again.
+//An erased record or one too big for a slot is kept
+//as missing.  A level record queues its assets.
+static void Assets_loadDone(I2C_Transfer_t *far xfer)
+{
+	Assets_Slot_t *far slot = &mSlots[mLoadSlot];
+	uint8_t type = slot->record[ASSETS_RECORD_TYPE];
+	uint8_t length = slot->record[ASSETS_RECORD_LENGTH];
+	uint8_t i = 0x00;
+
+	if (xfer->status != IIC_READY_STATUS)
+	{
+		slot->id = ASSETS_NONE;
+		slot->state = ASSETS_SLOT_EMPTY;
+		return;
+	}
+
+	if ((type == 0xFF) || (length > ASSETS_DATA_SIZE))
+	{
+		slot->state = ASSETS_SLOT_MISSING;
+		return;
+	}
+
+	slot->state = ASSETS_SLOT_VALID;
+
+	if (type == ASSETS_TYPE_LEVEL)
+	{
+		for (i = 0 ; i < length ; i++)
+			Assets_prefetch(slot->record[ASSETS_RECORD_DATA + i]);
+	}
+}
+
+
+///////////////////////////////////////////
+//Returns the slot holding id, any state, or
+//ASSETS_NONE
+static uint8_t Assets_find(uint8_t id)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < ASSETS_CACHE_SLOTS ; i++)
+	{
+		if (mSlots[i].id == id)
+			return i;
+	}
+
+	return ASSETS_NONE;
+}
+
+
+///////////////////////////////////////////
+//Move a slot to the front of mOrder
+static void Assets_touch(uint8_t slot)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < ASSETS_CACHE_SLOTS - 1 ; i++)
+	{
+		if (mOrder[i] == slot)
+			break;
+	}
+
+	for ( ; i > 0 ; i--)
+		mOrder[i] = mOrder[i - 1];
+
+	mOrder[0] = slot;
+}
+
+
+///////////////////////////////////////////
+//Returns 1 if id is in the queue
+static uint8_t Assets_isQueued(uint8_t id)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < mQueueCount ; i++)
+	{
+		if (mQueue[(mQueueHead + i) & (ASSETS_QUEUE_SIZE - 1)] == id)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+#if INSTRUMENT
+///////////////////////////////////////////
+//Returns the number of Assets_get calls that found
+//the asset, and the number that had to queue it.
+//Misses after a level starts mean the prefetch
+//was late.
+uint16_t Assets_getHits(void)
+{
+	return mHits;
+}
+
+
+uint16_t Assets_getMisses(void)
+{
+	return mMisses;
+}
+#endif
+
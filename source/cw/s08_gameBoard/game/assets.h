@@ -0,0 +1,106 @@
+/*
+ * assets.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Game assets streamed from a 24LC256 (32K, 2 byte
+ * memory address, 64 byte pages) on the i2c, A2 - A0
+ * strapped 001 for 0x51, next to the stats eeprom at
+ * 0x50.  Sprites, glyphs and level layouts that don't
+ * fit in the 8K of flash.
+ *
+ * The stats eeprom has to decode its address pins -
+ * a 24AA014 strapped 000, see eeprom.h.  The 24AA01
+ * it replaces ignores A2 - A0 and acks all of 0x50 -
+ * 0x57, and every address a 24LC256 can be strapped
+ * to is in that range, so both parts would answer.
+ *
+ * Asset Image:
+ * Asset n is a 32 byte record at n * 32, so a record
+ * never crosses a page.  Type, xSize, ySize, data
+ * length, then the data.  Sprites are 1bpp, stored
+ * horizontally MSB first like bmenemy1Bmp.  A level
+ * record at ASSETS_LEVEL_BASE + level lists the asset
+ * ids the level uses, ASSETS_LEVEL_ENEMY first.  An
+ * erased record (type 0xFF) is missing.
+ *
+ * Cache:
+ * A few slots in RAM, least recently used goes first.
+ * Each load is one sequential read of the header and
+ * data.  Assets_get() never touches the bus - a miss
+ * queues the asset and returns NULL, the caller draws
+ * its flash fallback for that frame.  Assets_poll()
+ * runs the queue from the main loop, one async read at
+ * a time, so loads overlap the idle time between
+ * frames.  Prefetch the next level while this one is
+ * played - a level should use less than half the
+ * slots so the next one fits without evicting it.
+ * An erased record or one too big for a slot is kept
+ * as missing and not read again.  A bus error only
+ * frees the slot, the next miss tries the read again.
+ */
+
+#ifndef ASSETS_H_
+#define ASSETS_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "bitmap.h"
+
+#define ASSETS_I2C_ADDRESS			(0x51 << 1)
+#define ASSETS_ADDRESS_SIZE			2			//memory address bytes
+
+//Record - header then data
+#define ASSETS_RECORD_SIZE			32
+#define ASSETS_RECORD_TYPE			0
+#define ASSETS_RECORD_X_SIZE		1
+#define ASSETS_RECORD_Y_SIZE		2
+#define ASSETS_RECORD_LENGTH		3
+#define ASSETS_RECORD_DATA			4
+#define ASSETS_HEADER_SIZE			4
+
+//Cache - 4 slots of one 16x8 sprite each.  An
+//INSTRUMENT build has 2 to make room for the
+//counters, the next level's prefetch doesn't stay
+//in the cache and each level change misses.
+#if INSTRUMENT
+#define ASSETS_CACHE_SLOTS			2
+#define ASSETS_QUEUE_SIZE			2			//power of two
+#else
+#define ASSETS_CACHE_SLOTS			4
+#define ASSETS_QUEUE_SIZE			4			//power of two
+#endif
+#define ASSETS_DATA_SIZE			16
+
+//ids - 8 bit, levels at the top
+#define ASSETS_NONE					0xFF
+#define ASSETS_LEVEL_BASE			0xC0
+#define ASSETS_LEVEL_ENEMY			0			//index in the level record
+
+//record types
+#define ASSETS_TYPE_SPRITE			1
+#define ASSETS_TYPE_GLYPH			2
+#define ASSETS_TYPE_LEVEL			3
+
+
+/////////////////////////////////////////
+//Function prototypes
+void Assets_init(void);
+void Assets_poll(void);
+
+const uint8_t *far Assets_get(uint8_t id);
+uint8_t Assets_getImage(uint8_t id, ImageData *far image);
+uint8_t Assets_getLevelAsset(uint8_t level, uint8_t index);
+
+void Assets_prefetch(uint8_t id);
+void Assets_prefetchLevel(uint8_t level);
+
+#if INSTRUMENT
+uint16_t Assets_getHits(void);
+uint16_t Assets_getMisses(void);
+#endif
+
+
+#endif /* ASSETS_H_ */
@@ -20,6 +20,7 @@
 #include "gpio.h"
 #include "rtc.h"		//delay
 #include "pwm.h"
+#include "assets.h"
 
 //Game objects
 //Note: Declare as static and init to 0x00 to 
@@ -73,11 +74,14 @@ void Game_init(void)
 	Game_enemyInit();
 	Game_missileInit();
 	
+	//this level and the next from the asset eeprom
+	Assets_prefetchLevel(mGameLevel);
+	Assets_prefetchLevel(mGameLevel + 1);
+	
 	Game_playerDraw();
-	Game_enemyDraw();
 	
 	//update the display contents
-	LCD_updateFrameBuffer();
+	LCD_renderFrameBuffer(Game_fieldDraw);
 }
 
 ///////////////////////////////////////////////
@@ -417,20 +421,39 @@ void Game_playerDraw(void)
 
 //////////////////////////////////////////////
 //Draw enemy array into framebuffer.  Does not
-//update the contents of the LCD
+//update the contents of the LCD.  The enemy sprite
+//is the one in the level's asset record, or the
+//built in one if the level has none, it is not
+//loaded yet or it is not the built in one's size.
 void Game_enemyDraw(void)
 {
 	uint8_t i = 0;
+	ImageData image = bmenemy1Bmp;
+	
+	(void)Assets_getImage(Assets_getLevelAsset(mGameLevel, ASSETS_LEVEL_ENEMY), &image);
+	
 	for (i = 0 ; i < GAME_ENEMY_NUM_ENEMY ; i++)
 	{
 		if (mEnemy[i].alive == 1)
 		{	
-			LCD_drawEnemyBitmap(mEnemy[i].xPosition, mEnemy[i].yPosition);
+			LCD_drawEnemyBitmap(mEnemy[i].xPosition, mEnemy[i].yPosition, &image);
 		}
 	}
 }
 
 
+//////////////////////////////////////////////////
+//Draw everything in the play area into the frame
+//buffer - enemies and missiles.  This is the draw
+//function for LCD_renderFrameBuffer, it runs once
+//per band.
+void Game_fieldDraw(void)
+{
+	Game_enemyDraw();
+	Game_missileDraw();
+}
+
+
 //////////////////////////////////////////////////
 //Draw missile objects for all missiles
 //that are alive.  Applies to be the player
@@ -658,6 +681,7 @@ void Game_levelUp(void)
 	mGameLevel++;				//increase the level
 	Game_enemyInit();			//reset the enemy
 	Game_missileInit();			//reset the missiles
+	Assets_prefetchLevel(mGameLevel + 1);	//load the next one during play
 }
 
 
@@ -763,10 +787,7 @@ void Game_playExplosionPlayer(void)
 {
 	DisableInterrupts;
 	Game_missileInit();
-	LCD_clearFrameBuffer(0x00, 0);
-	Game_enemyDraw();
-	Game_missileDraw();
-	LCD_updateFrameBuffer();
+	LCD_renderFrameBuffer(Game_fieldDraw);
 	EnableInterrupts;
 	
 	LCD_drawImagePage(LCD_PLAYER_PAGE, mPlayer.xPosition, BITMAP_PLAYER_EXP1);
@@ -790,10 +811,7 @@ void Game_playExplosionPlayer_withSound(void)
 {
 	DisableInterrupts;
 	Game_missileInit();
-	LCD_clearFrameBuffer(0x00, 0);
-	Game_enemyDraw();
-	Game_missileDraw();
-	LCD_updateFrameBuffer();
+	LCD_renderFrameBuffer(Game_fieldDraw);
 	EnableInterrupts;
 	
 	PWM_setFrequency(200);
@@ -836,8 +854,7 @@ void Game_playGameOver(void)
 	static uint8_t toggle = 0x00;	
 
 	DisableInterrupts;
-	LCD_clearFrameBuffer(0x00, 0);
-	LCD_updateFrameBuffer();	
+	LCD_clearFrameBuffer(0x00, 1);
 	EnableInterrupts;
 		
 	LCD_drawString(2, 34, "Game");
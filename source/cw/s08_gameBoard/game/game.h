@@ -103,6 +103,7 @@ uint8_t Game_missileMove(void);
 void Game_playerDraw(void);
 void Game_enemyDraw(void);
 void Game_missileDraw(void);
+void Game_fieldDraw(void);
 
 uint8_t Game_missilePlayerLaunch(void);
 uint8_t Game_missileEnemyLaunch(void);
@@ -0,0 +1,622 @@
+/*
+ * stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Persistent game statistics, write-behind cache of
+ * the stat records in a log.  See stats.h
+ *
+ * The log is in the i2c eeprom or in the internal
+ * flash, picked with STATS_BACKEND.  Only reading an
+ * entry, writing an entry and picking the next slot
+ * are different, everything else is shared.
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "stats.h"
+#include "eeprom.h"
+#include "flash.h"
+#include "i2c.h"
+#include "sched.h"
+#include "timer.h"
+
+
+/////////////////////////////////////////
+//Record Definition
+//offset - index in the shadow
+//size - bytes, 1 to 4
+typedef struct
+{
+	uint8_t offset;
+	uint8_t size;
+}Stats_Def_t;
+
+
+static const Stats_Def_t mRecords[STATS_NUM_RECORDS] =
+{
+	//offset	size
+	{0,			2},			//cycle count
+	{2,			2},			//high score
+	{4,			1},			//high level
+	{5,			4},			//shots fired
+	{9,			4},			//shots hit
+	{13,		4},			//play time
+};
+
+
+/////////////////////////////////////////////
+//Stats Variables
+//mShadow - RAM copy of the records, MSB first
+//mDirty - bit n set if record n changed since the
+//last write
+//mLive - slot holding the newest entry of each
+//record, STATS_NO_SLOT if none
+//mSeq - sequence number of the newest entry
+//mNextSlot - slot the next entry goes to
+//mFlushRecord - record in the write
+//mEntry - the entry being written
+//mBench - latency of each backend operation, only
+//with INSTRUMENT.  While a write is out mBench.write
+//holds the timer count it started at.
+//All of it is in FAR_RAM, Z_RAM is full, see main.c
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static uint8_t mShadow[STATS_SHADOW_SIZE] = {0x00};
+static uint8_t mDirty = 0x00;
+static uint8_t mLive[STATS_NUM_RECORDS] = {0x00};
+static uint16_t mSeq = 0x00;
+static uint8_t mNextSlot = 0x00;
+static uint8_t mFlushRecord = 0x00;
+static uint8_t mEntry[STATS_ENTRY_SIZE] = {0x00};
+#if INSTRUMENT
+static Stats_Bench_t mBench = {0x00};
+#endif
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+//mXfer - the page write on the bus
+//mNextWrite - tick the next page write can start
+static I2C_Transfer_t mXfer = {0x00};
+static uint16_t mNextWrite = 0x00;
+#endif
+#pragma DATA_SEG DEFAULT
+
+#if (STATS_BACKEND == STATS_BACKEND_FLASH)
+//The store itself, erased.  Only this build has it,
+//Project.prm puts FLASH_STORE in STORE_ROM, on
+//the sectors at 0xFA00, see flash.h.
+#define STATS_FF8		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+#define STATS_FF64		STATS_FF8, STATS_FF8, STATS_FF8, STATS_FF8,		\
+						STATS_FF8, STATS_FF8, STATS_FF8, STATS_FF8
+#define STATS_FF512		STATS_FF64, STATS_FF64, STATS_FF64, STATS_FF64,	\
+						STATS_FF64, STATS_FF64, STATS_FF64, STATS_FF64
+
+#pragma CONST_SEG FLASH_STORE
+static const volatile uint8_t mStore[FLASH_SECTOR_SIZE * FLASH_STORE_SECTORS] =
+{
+	STATS_FF512, STATS_FF512
+};
+#pragma CONST_SEG DEFAULT
+
+#if (FLASH_STORE_SECTORS != 2)
+#error "stats.c - mStore is initialised for 2 sectors"
+#endif
+#endif
+
+
+static uint8_t Stats_readEntry(uint8_t slot, uint8_t *far entry);
+static void Stats_writeEntry(void);
+static void Stats_writeDone(uint8_t ok);
+static uint8_t Stats_crc8(const uint8_t *far data, uint8_t length);
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+static void Stats_flushDone(I2C_Transfer_t *far xfer);
+#else
+static uint8_t Stats_isBlank(uint16_t address, uint16_t length);
+static void Stats_carry(uint8_t sector);
+#endif
+
+
+///////////////////////////////////////////
+//Stats_init
+//Scan the log and load the newest valid entry of
+//each record into the shadow.  Sequence numbers are
+//16 bits and compared with signed math.  The next
+//entry goes in the slot after the newest one.
+//If the eeprom log is empty, carry over the cycle
+//count from its old fixed address.  Blocking, call
+//once at power up after Sched_init, with interrupts
+//enabled.  With INSTRUMENT the scan time is kept for
+//Stats_getBench.
+void Stats_init(void)
+{
+	uint8_t entry[STATS_ENTRY_SIZE];
+	uint16_t seq[STATS_NUM_RECORDS];
+	uint16_t entrySeq = 0x00;
+	uint8_t slot = 0x00;
+	uint8_t id = 0x00;
+	uint8_t i = 0x00;
+	uint8_t found = 0x00;
+	unsigned long value = 0x00;
+#if INSTRUMENT
+	uint16_t start = Timer_getCount();
+#endif
+
+	mDirty = 0x00;
+	mSeq = 0x00;
+	mNextSlot = 0x00;
+
+#if INSTRUMENT
+	mBench.scan = 0x00;
+	mBench.read = 0x00;
+	mBench.write = 0x00;
+	mBench.maxWrite = 0x00;
+	mBench.writes = 0x00;
+#endif
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+	mXfer.status = IIC_READY_STATUS;
+	mNextWrite = Sched_getTick();
+#endif
+
+	for (i = 0 ; i < STATS_SHADOW_SIZE ; i++)
+		mShadow[i] = 0x00;
+
+	for (i = 0 ; i < STATS_NUM_RECORDS ; i++)
+	{
+		mLive[i] = STATS_NO_SLOT;
+		seq[i] = 0x00;
+	}
+
+	for (slot = 0 ; slot < STATS_LOG_SLOTS ; slot++)
+	{
+		if (!Stats_readEntry(slot, entry))
+			continue;
+
+		//torn, erased or not a log entry
+		id = entry[STATS_ENTRY_ID];
+		if ((id >= STATS_NUM_RECORDS) || (Stats_crc8(entry, STATS_ENTRY_CRC) != entry[STATS_ENTRY_CRC]))
+			continue;
+
+		entrySeq = ((uint16_t)entry[STATS_ENTRY_SEQ_HI] << 8) | entry[STATS_ENTRY_SEQ];
+
+		//newest entry of the log
+		if (!found || ((int16_t)(entrySeq - mSeq) > 0))
+		{
+			mSeq = entrySeq;
+			mNextSlot = (slot + 1) & (STATS_LOG_SLOTS - 1);
+		}
+		found = 1;
+
+		//newest entry of this record
+		if ((mLive[id] == STATS_NO_SLOT) || ((int16_t)(entrySeq - seq[id]) > 0))
+		{
+			mLive[id] = slot;
+			seq[id] = entrySeq;
+
+			value = entry[STATS_ENTRY_VALUE];
+			for (i = 1 ; i < 4 ; i++)
+				value = (value << 8) | entry[STATS_ENTRY_VALUE + i];
+			Stats_set((Stats_Record_t)id, value);
+		}
+	}
+
+	mDirty = 0x00;
+
+#if INSTRUMENT
+	mBench.scan = Timer_elapsed(start);
+
+	//one entry on its own, for the benchmark
+	start = Timer_getCount();
+	(void)Stats_readEntry(0, entry);
+	mBench.read = Timer_elapsed(start);
+#endif
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+	//first power up with the log - keep the count
+	if (!found)
+	{
+		if (EEPROM_read(EEPROM_ADDRESS_CYCLE_COUNT_MSB, entry, 2) == IIC_READY_STATUS)
+		{
+			value = ((uint16_t)entry[0] << 8) | entry[1];
+			if (value != 0xFFFF)
+				Stats_set(STATS_CYCLE_COUNT, value);
+		}
+	}
+#else
+	//power lost before the carry was done - start it
+	//again from the newest entry's sector
+	if (found)
+		Stats_carry((uint8_t)(((mNextSlot - 1) & (STATS_LOG_SLOTS - 1)) / STATS_SECTOR_SLOTS));
+#endif
+}
+
+
+///////////////////////////////////////////
+//Returns the value of a record from the shadow
+unsigned long Stats_get(Stats_Record_t record)
+{
+	unsigned long result = 0x00;
+	uint8_t i = 0x00;
+
+	if (record >= STATS_NUM_RECORDS)
+		return 0x00;
+
+	for (i = 0 ; i < mRecords[record].size ; i++)
+		result = (result << 8) | mShadow[mRecords[record].offset + i];
+
+	return result;
+}
+
+
+///////////////////////////////////////////
+//Stats_set
+//Update a record in the shadow, MSB first.  The
+//record is marked dirty only if it changed.
+//Values too large for the record are truncated.
+void Stats_set(Stats_Record_t record, unsigned long value)
+{
+	uint8_t i = 0x00;
+	uint8_t offset = 0x00;
+	uint8_t data = 0x00;
+
+	if (record >= STATS_NUM_RECORDS)
+		return;
+
+	offset = mRecords[record].offset;
+
+	for (i = mRecords[record].size ; i > 0 ; i--)
+	{
+		data = (uint8_t)(value & 0xFF);
+		if (mShadow[offset + i - 1] != data)
+		{
+			mShadow[offset + i - 1] = data;
+			mDirty |= (uint8_t)(1 << record);
+		}
+		value >>= 8;
+	}
+}
+
+
+void Stats_add(Stats_Record_t record, uint16_t amount)
+{
+	Stats_set(record, Stats_get(record) + amount);
+}
+
+
+///////////////////////////////////////////
+//Set the record if value is larger, for the
+//high score and level
+void Stats_setMax(Stats_Record_t record, unsigned long value)
+{
+	if (value > Stats_get(record))
+		Stats_set(record, value);
+}
+
+
+///////////////////////////////////////////
+//Returns the percent of shots that hit, 0 - 100.
+//One long divide, only called for the game over
+//screen.
+uint8_t Stats_getAccuracy(void)
+{
+	unsigned long fired = Stats_get(STATS_SHOTS_FIRED);
+	unsigned long hit = Stats_get(STATS_SHOTS_HIT);
+
+	if ((fired == 0) || (hit > fired))
+		return 0x00;
+
+	return (uint8_t)((hit * 100) / fired);
+}
+
+
+///////////////////////////////////////////
+//Stats_flush
+//Write one log entry, call again for the next one.
+//The first dirty record, except in the eeprom if the
+//slot after this one holds the newest entry of a
+//record - that record goes first so its slot can be
+//reused later.  In the flash a record being carried
+//out of the other sector goes first.  The eeprom
+//write is queued on the i2c and does nothing while
+//the last one is on the bus or in its write cycle.
+//The flash write is done before this returns.
+void Stats_flush(void)
+{
+	uint8_t record = 0x00;
+	uint8_t after = 0x00;
+	uint8_t i = 0x00;
+	unsigned long value = 0x00;
+
+	if (mDirty == 0x00)
+		return;
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+	if ((mXfer.status == IIC_QUEUED_STATUS) || !Sched_isTickReached(mNextWrite))
+		return;
+#endif
+
+	while (!(mDirty & (uint8_t)(1 << record)))
+		record++;
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+	after = (mNextSlot + 1) & (STATS_LOG_SLOTS - 1);
+
+	for (i = 0 ; i < STATS_NUM_RECORDS ; i++)
+	{
+		if (mLive[i] == after)
+			record = i;
+	}
+#else
+	for (i = 0 ; i < STATS_NUM_RECORDS ; i++)
+	{
+		if ((mDirty & (uint8_t)(1 << i)) && (mLive[i] != STATS_NO_SLOT) &&
+				((mLive[i] / STATS_SECTOR_SLOTS) != (mNextSlot / STATS_SECTOR_SLOTS)))
+		{
+			record = i;
+			break;
+		}
+	}
+#endif
+
+	//clean from here, a change while it is being
+	//written sets it again
+	mFlushRecord = record;
+	mDirty &= (uint8_t)~(1 << record);
+
+	//build the entry, value MSB first
+	value = Stats_get((Stats_Record_t)record);
+	mEntry[STATS_ENTRY_SEQ] = (uint8_t)((mSeq + 1) & 0xFF);
+	mEntry[STATS_ENTRY_SEQ_HI] = (uint8_t)((mSeq + 1) >> 8);
+	mEntry[STATS_ENTRY_ID] = record;
+	for (i = 4 ; i > 0 ; i--)
+	{
+		mEntry[STATS_ENTRY_VALUE + i - 1] = (uint8_t)(value & 0xFF);
+		value >>= 8;
+	}
+	mEntry[STATS_ENTRY_CRC] = Stats_crc8(mEntry, STATS_ENTRY_CRC);
+
+#if INSTRUMENT
+	mBench.write = Timer_getCount();
+	mBench.writes++;
+#endif
+
+	Stats_writeEntry();
+}
+
+
+///////////////////////////////////////////
+//Stats_writeDone
+//The write of mEntry finished.  On success the
+//entry is the newest and the log moves on a slot.
+//On an error the record is tried again on the next
+//flush.
+static void Stats_writeDone(uint8_t ok)
+{
+#if INSTRUMENT
+	mBench.write = Timer_elapsed(mBench.write);
+	if (mBench.write > mBench.maxWrite)
+		mBench.maxWrite = mBench.write;
+#endif
+
+	if (!ok)
+	{
+		mDirty |= (uint8_t)(1 << mFlushRecord);
+		return;
+	}
+
+	mSeq = ((uint16_t)mEntry[STATS_ENTRY_SEQ_HI] << 8) | mEntry[STATS_ENTRY_SEQ];
+	mLive[mFlushRecord] = mNextSlot;
+	mNextSlot = (mNextSlot + 1) & (STATS_LOG_SLOTS - 1);
+}
+
+
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+
+///////////////////////////////////////////
+//Eeprom - one entry per page, sequential read
+static uint8_t Stats_readEntry(uint8_t slot, uint8_t *far entry)
+{
+	return (EEPROM_read(slot * STATS_ENTRY_SIZE, entry, STATS_ENTRY_SIZE) == IIC_READY_STATUS) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////
+//Eeprom - queue one page write of mEntry, page
+//aligned, and return.  A failed write is tried
+//again in the same page.
+static void Stats_writeEntry(void)
+{
+	mXfer.address = I2C_ADDRESS;
+	mXfer.memoryAddress = mNextSlot * STATS_ENTRY_SIZE;
+	mXfer.memoryAddressSize = EEPROM_ADDRESS_SIZE;
+	mXfer.txData = mEntry;
+	mXfer.txLength = STATS_ENTRY_SIZE;
+	mXfer.rxData = NULL;
+	mXfer.rxLength = 0;
+	mXfer.flags = 0x00;
+	mXfer.callback = Stats_flushDone;
+
+	mNextWrite = Sched_getTick() + STATS_WRITE_TICKS;
+
+	I2C_submit(&mXfer);
+}
+
+
+///////////////////////////////////////////
+//I2C callback for the log write, from I2C_poll.
+static void Stats_flushDone(I2C_Transfer_t *far xfer)
+{
+	Stats_writeDone((xfer->status == IIC_READY_STATUS) ? 1 : 0);
+}
+
+#else
+
+///////////////////////////////////////////
+//Flash - entries are read in place
+static uint8_t Stats_readEntry(uint8_t slot, uint8_t *far entry)
+{
+	uint16_t offset = slot * STATS_ENTRY_SIZE;
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < STATS_ENTRY_SIZE ; i++)
+		entry[i] = mStore[offset + i];
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Flash - program mEntry into the next blank slot.
+//A slot can only be programmed once, a torn entry
+//is skipped.  The first slot of a sector erases it
+//if it is not blank.  Every record still in the
+//other sector is carried into this one first, long
+//before this sector is full and the other one is
+//erased, so flash always has each record.  A record
+//left in the erased sector, only after writes kept
+//failing, is still in the shadow and dirty.
+//The erase is about 20ms, once every 64 entries.
+static void Stats_writeEntry(void)
+{
+	uint8_t i = 0x00;
+	uint8_t record = 0x00;
+	uint16_t address = 0x00;
+
+	for (i = 0 ; i < STATS_LOG_SLOTS ; i++)
+	{
+		address = (uint16_t)mStore + (mNextSlot * STATS_ENTRY_SIZE);
+
+		if ((mNextSlot & (STATS_SECTOR_SLOTS - 1)) == 0)
+		{
+			//a failed erase leaves the sector as it was,
+			//don't program over it - try again next flush
+			if (!Stats_isBlank(address, FLASH_SECTOR_SIZE))
+			{
+				if (Flash_eraseSector(address) != FLASH_OK)
+				{
+					Stats_writeDone(0);
+					return;
+				}
+			}
+
+			for (record = 0 ; record < STATS_NUM_RECORDS ; record++)
+			{
+				if ((mLive[record] != STATS_NO_SLOT) &&
+						((mLive[record] / STATS_SECTOR_SLOTS) == (mNextSlot / STATS_SECTOR_SLOTS)))
+				{
+					mLive[record] = STATS_NO_SLOT;
+					mDirty |= (uint8_t)(1 << record);
+				}
+			}
+
+			//the record being written needs no carry
+			Stats_carry((uint8_t)(mNextSlot / STATS_SECTOR_SLOTS));
+			mDirty &= (uint8_t)~(1 << mFlushRecord);
+			break;
+		}
+
+		if (Stats_isBlank(address, STATS_ENTRY_SIZE))
+			break;
+
+		mNextSlot = (mNextSlot + 1) & (STATS_LOG_SLOTS - 1);
+	}
+
+	address = (uint16_t)mStore + (mNextSlot * STATS_ENTRY_SIZE);
+	Stats_writeDone(Flash_program(address, mEntry, STATS_ENTRY_SIZE) == FLASH_OK);
+}
+
+
+///////////////////////////////////////////
+//Returns 1 if length bytes of flash at address
+//are all erased
+static uint8_t Stats_isBlank(uint16_t address, uint16_t length)
+{
+	const uint8_t *far data = (const uint8_t *far)address;
+	uint16_t i = 0x00;
+
+	for (i = 0 ; i < length ; i++)
+	{
+		if (data[i] != 0xFF)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Stats_carry
+//Set dirty every record whose newest entry is not
+//in sector, so it is written there while its old
+//entry is still in the other sector.
+static void Stats_carry(uint8_t sector)
+{
+	uint8_t record = 0x00;
+
+	for (record = 0 ; record < STATS_NUM_RECORDS ; record++)
+	{
+		if ((mLive[record] != STATS_NO_SLOT) && ((mLive[record] / STATS_SECTOR_SLOTS) != sector))
+			mDirty |= (uint8_t)(1 << record);
+	}
+}
+
+#endif
+
+
+///////////////////////////////////////////
+//CRC-8, polynomial 0x07, init 0x00.  An erased page
+//(all 0xFF) does not pass.
+static uint8_t Stats_crc8(const uint8_t *far data, uint8_t length)
+{
+	uint8_t crc = 0x00;
+	uint8_t i = 0x00;
+	uint8_t j = 0x00;
+
+	for (i = 0 ; i < length ; i++)
+	{
+		crc ^= data[i];
+		for (j = 0 ; j < 8 ; j++)
+		{
+			if (crc & 0x80)
+				crc = (uint8_t)((crc << 1) ^ 0x07);
+			else
+				crc <<= 1;
+		}
+	}
+
+	return crc;
+}
+
+
+///////////////////////////////////////////
+//Returns 1 if any record has not been written
+uint8_t Stats_isDirty(void)
+{
+	return (mDirty != 0x00) ? 1 : 0;
+}
+
+
+#if INSTRUMENT
+///////////////////////////////////////////
+//Returns the number of log entries written since
+//power up, to compare with the number of updates
+uint16_t Stats_getWrites(void)
+{
+	return mBench.writes;
+}
+
+
+///////////////////////////////////////////
+//Stats_getBench
+//Copy the backend latencies, in timer counts
+//(TIMER_TICK_US each).  See Stats_Bench_t
+void Stats_getBench(Stats_Bench_t *far bench)
+{
+	*bench = mBench;
+}
+#endif
+
@@ -0,0 +1,154 @@
+/*
+ * stats.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Persistent game statistics.  A RAM shadow of the
+ * stat records with a dirty bit for each record.
+ * Gameplay only updates the shadow.  Dirty records
+ * are written back by Stats_flush(), one page write
+ * per call, queued on the i2c and not waited on.  It
+ * is called from the idle frames while the game over
+ * screen is up, so nothing during play waits on the
+ * i2c and a record is written at most once per game
+ * instead of once per change.
+ *
+ * Record Log:
+ * The eeprom is an append-only log of 8 byte entries,
+ * one per page, written in order around all 16 pages
+ * so the wear is spread over the whole part.  Each
+ * entry is a sequence number, the record id, the value
+ * and a CRC-8.  An update is one page write, no read
+ * first.  At power up all pages are scanned and the
+ * newest valid entry of each record is loaded.  A torn
+ * write fails the CRC and is skipped, the record keeps
+ * its previous value.
+ *
+ * The page after the one being written never holds
+ * the newest copy of a record - if it does, that
+ * record is written first (carried forward), so the
+ * oldest page can always be overwritten.  This needs
+ * fewer records than pages.
+ *
+ * Flash Backend:
+ * With STATS_BACKEND set to STATS_BACKEND_FLASH the
+ * same entries go in the internal flash store (see
+ * flash.h), 64 per sector.  An entry is only written
+ * to an erased slot.  The first entry in a sector
+ * erases it and every record with its newest entry in
+ * the other sector is set dirty and written ahead of
+ * any other.  They are all copied into this sector a
+ * few entries in, long before it is full and the
+ * other one is erased, so every record is always in
+ * flash.  Power lost before the copies are done sets
+ * them dirty again at Stats_init.  Reads are plain
+ * loads, the write is done before Stats_flush returns.
+ * The store only exists in this build, see flash.h
+ *
+ * Latency, about, an INSTRUMENT build measures it,
+ * timer counts from Stats_getBench:
+ * eeprom - scan ~18ms, read ~1.1ms, write ~1ms on the
+ *          bus then the 5ms write cycle
+ * flash  - scan ~1ms, read a few us, write ~0.4ms,
+ *          ~20ms erase once every 64 writes
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "eeprom.h"
+#include "flash.h"
+
+//where the log is kept, build time
+#define STATS_BACKEND_EEPROM		0
+#define STATS_BACKEND_FLASH			1
+
+#ifndef STATS_BACKEND
+#define STATS_BACKEND				STATS_BACKEND_EEPROM
+#endif
+
+//shadow size, sum of the record sizes
+#define STATS_SHADOW_SIZE			17
+
+//RTC ticks between page writes, covers the 5ms
+//write cycle at 100hz
+#define STATS_WRITE_TICKS			2
+
+//Log entry - one eeprom page
+//seq LSB, id, value MSB first, seq MSB, crc
+#define STATS_ENTRY_SIZE			8
+#define STATS_ENTRY_SEQ				0
+#define STATS_ENTRY_ID				1
+#define STATS_ENTRY_VALUE			2			//4 bytes
+#define STATS_ENTRY_SEQ_HI			6
+#define STATS_ENTRY_CRC				7
+
+//slots in the log, a power of two
+#if (STATS_BACKEND == STATS_BACKEND_EEPROM)
+#define STATS_LOG_SLOTS				EEPROM_NUM_PAGES
+#else
+#define STATS_SECTOR_SLOTS			(FLASH_SECTOR_SIZE / STATS_ENTRY_SIZE)
+#define STATS_LOG_SLOTS				(STATS_SECTOR_SLOTS * FLASH_STORE_SECTORS)
+#endif
+
+#define STATS_NO_SLOT				0xFF
+
+
+/////////////////////////////////////////
+//Records - id in the log and bit in the
+//dirty mask, 8 max, fewer than STATS_LOG_SLOTS
+typedef enum
+{
+	STATS_CYCLE_COUNT,			//games played
+	STATS_HIGH_SCORE,
+	STATS_HIGH_LEVEL,
+	STATS_SHOTS_FIRED,
+	STATS_SHOTS_HIT,
+	STATS_PLAY_TIME,			//RTC ticks in play
+	STATS_NUM_RECORDS
+}Stats_Record_t;
+
+
+#if INSTRUMENT
+/////////////////////////////////////////
+//Backend latency, in timer counts
+//scan - Stats_init log scan
+//read - one entry
+//write - last write, start to done
+//maxWrite - longest write, with the erases
+//writes - entries written since power up
+typedef struct
+{
+	uint16_t scan;
+	uint16_t read;
+	uint16_t write;
+	uint16_t maxWrite;
+	uint16_t writes;
+}Stats_Bench_t;
+#endif
+
+
+/////////////////////////////////////////
+//Function prototypes
+void Stats_init(void);
+
+unsigned long Stats_get(Stats_Record_t record);
+void Stats_set(Stats_Record_t record, unsigned long value);
+void Stats_add(Stats_Record_t record, uint16_t amount);
+void Stats_setMax(Stats_Record_t record, unsigned long value);
+uint8_t Stats_getAccuracy(void);
+
+void Stats_flush(void);
+uint8_t Stats_isDirty(void);
+
+#if INSTRUMENT
+uint16_t Stats_getWrites(void);
+void Stats_getBench(Stats_Bench_t *far bench);
+#endif
+
+
+#endif /* STATS_H_ */
@@ -5,17 +5,48 @@
  *      Author: danao
  */
 
+#include <hidef.h> /* for EnableInterrupts macro */
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
 #include "clock.h"
+#include "rtc.h"
+#include "timer.h"
+#include "spi.h"
+#include "i2c.h"
+#include "pwm.h"
+
+
+/////////////////////////////////////////////
+//Speed Scaling Variables
+//mSpeed - current speed
+//mPending - speed asked for, applied by Clock_poll
+//once the i2c is idle
+static Clock_Speed_t mSpeed = CLOCK_SPEED_HIGH;
+static Clock_Speed_t mPending = CLOCK_SPEED_HIGH;
+
+#if INSTRUMENT
+//mLatency - timer counts for the last switch
+//mMaxLatency - longest switch so far
+//mLastTick - RTC tick of the last switch
+//mResidency - RTC ticks spent at each speed,
+//not counting the current one
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static uint16_t mLatency = 0x00;
+static uint16_t mMaxLatency = 0x00;
+static unsigned long mLastTick = 0x00;
+static unsigned long mResidency[CLOCK_SPEED_NUM] = {0x00};
+#pragma DATA_SEG DEFAULT
+#endif
+
+static void Clock_apply(Clock_Speed_t speed);
 
 ////////////////////////////////////////////////////
 //Clock_init()
-//Configure the clock to use the external oscillator
-//as the clock source.  Note:  the default is using the
-//internal source, which I think is 1mhz, and sets up the
-//RTC for 1khz timeout.
+//Configure the ICS for the mode selected with
+//CLOCK_PROFILE and the bus divider CLOCK_BDIV.
+//See clock.h.  Note:  the default out of reset
+//is FEI with divide by 2, about 4mhz bus.
 //
 //From the datasheet:
 //ICSC1 - internal clock source control register 1
@@ -24,44 +55,283 @@
 //
 void Clock_init(void)
 {
+	//////////////////////////////////////////////////
+	//ICSSC - Status and Control Register
+	//DRS = 00
+	//DMX32 - 0
+	//the above gives FLL factor 512 and DCO range 16-20 mhz
+	ICSSC_DRST_DRS1 = 0;
+	ICSSC_DRST_DRS0 = 0;
+	ICSSC_DMX32 = 0;
+
+	//start at full speed, the RTC resets the
+	//time tick to 0 when it starts
+	mSpeed = CLOCK_SPEED_HIGH;
+	mPending = CLOCK_SPEED_HIGH;
+
+#if INSTRUMENT
+	mLatency = 0x00;
+	mMaxLatency = 0x00;
+	mLastTick = 0x00;
+	mResidency[CLOCK_SPEED_HIGH] = 0x00;
+	mResidency[CLOCK_SPEED_LOW] = 0x00;
+#endif
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEI)
+
 	////////////////////////////////////////////
-	//ICSC1 Register
-	//CLKS bits - 10 - external ref clock selected
-	ICSC1_CLKS1 = 1;
+	//FEI - FLL engaged, internal reference
+	//CLKS bits - 00 - FLL output
+	//IREFS - 1 - internal reference
+	ICSC1_CLKS1 = 0;
 	ICSC1_CLKS0 = 0;
-	
-	//RDIV - 100 - divider 512, high range, high gain 16mhz
-	//16mhz / 512 = 31.25khz, OK
-	ICSC1_RDIV2 = 1;
-	ICSC1_RDIV1 = 0;
-	ICSC1_RDIV0 = 0;
-	
-	//IREFS - internal reference select - 0 is external
-	ICSC1_IREFS = 0;
+	ICSC1_IREFS = 1;
 
-	////////////////////////////////////////////////////
-	//ICSC2 Register
-	//Bis divider - direct impact on the speed at which
-	//the device runs.  about 350khz for divider = 1 (00)
-	//and about 50mhz for a divider = 8 (11)
-	//Bus divider = 00 - clock divide 1
- 	ICSC2_BDIV1 = 0;
-	ICSC2_BDIV0 = 0;
+	//load the factory trim so the reference is
+	//31.25khz.  Erased (0xFF) means not programmed,
+	//leave the reset value.
+	if (NVICSTRM != 0xFF)
+	{
+		ICSTRM = NVICSTRM;
+		ICSSC_FTRIM = NVFTRIM_FTRIM;
+	}
+
+	ICSC2_LP = 0;			//FLL on
+	ICSC2_BDIV = CLOCK_BDIV;
+
+	while (!ICSSC_IREFST){};			//wait for internal reference
+	while (ICSSC_CLKST != 0x00){};		//wait for FLL output selected
 
+#else
+
+	////////////////////////////////////////////
+	//External oscillator - 16mhz xtal on PB6 / PB7
 	//set the range and gain based on speed of ext osc.
 	ICSC2_RANGE = 1;		//high range
 	ICSC2_HGO = 1;			//high gain
-	
-	ICSC2_LP = 1;			//FLL is disabled in bypass mode
 	ICSC2_EREFS = 1;		//oscillator is requested - important - set to 1
 	ICSC2_ERCLKEN = 1;		//enables external ref clock for serclk
-	
-	//////////////////////////////////////////////////
-	//ICSSC - Status and Control Register
-	//DRS = 00
-	//DMX32 - 0
-	//the above gives FLL factor 512 and DCO range 16-20 mhz
-	ICSSC_DRST_DRS1 = 0;
-	ICSSC_DRST_DRS0 = 0;	
-	ICSSC_DMX32 = 0;
+
+	while (!ICSSC_OSCINIT){};			//wait for the xtal to start
+
+	//RDIV - 100 - divider 512, high range, high gain 16mhz
+	//16mhz / 512 = 31.25khz, OK
+	ICSC1_RDIV = CLOCK_RDIV;
+
+	//IREFS - internal reference select - 0 is external
+	ICSC1_IREFS = 0;
+	while (ICSSC_IREFST){};				//wait for external reference
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEE)
+
+	//FEE - CLKS 00 - FLL output, FLL locked to the xtal
+	ICSC2_LP = 0;
+	ICSC1_CLKS1 = 0;
+	ICSC1_CLKS0 = 0;
+	while (ICSSC_CLKST != 0x00){};
+
+#else
+
+	//FBE / FBELP - CLKS 10 - external ref clock selected
+	ICSC1_CLKS1 = 1;
+	ICSC1_CLKS0 = 0;
+	while (ICSSC_CLKST != 0x02){};
+
+	//keep the xtal running in STOP3 so the bus is
+	//back right away, see Power_selectMode
+	ICSC2_EREFSTEN = 1;
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FBELP)
+	ICSC2_LP = 1;			//FLL is disabled in bypass mode
+#else
+	ICSC2_LP = 0;			//FLL keeps running in bypass mode
+#endif
+
+#endif
+
+	////////////////////////////////////////////////////
+	//Bus divider - 00 = 1, 01 = 2, 10 = 4, 11 = 8
+	ICSC2_BDIV = CLOCK_BDIV;
+
+#endif
+}
+
+
+////////////////////////////////////////////////////
+//Returns the current bus frequency in hz
+unsigned long Clock_getBusFreq(void)
+{
+	if (mSpeed == CLOCK_SPEED_LOW)
+		return CLOCK_BUS_LOW_FREQ_HZ;
+
+	return CLOCK_BUS_HIGH_FREQ_HZ;
 }
+
+
+////////////////////////////////////////////////////
+//Clock_setSpeed
+//Change the bus divider and re-derive the SPI, IIC
+//and TPM1 dividers so they keep the same timing.
+//While an i2c transfer is on the bus the change is
+//deferred to Clock_poll and CLOCK_DEFERRED is
+//returned, use Clock_setSpeed_blocking if the new
+//speed is needed right away.  Call with interrupts
+//enabled, ie, not from inside a DisableInterrupts
+//block.  Returns CLOCK_OK, CLOCK_DEFERRED or
+//CLOCK_ERROR for a bad speed.
+uint8_t Clock_setSpeed(Clock_Speed_t speed)
+{
+	if (speed >= CLOCK_SPEED_NUM)
+		return CLOCK_ERROR;
+
+	mPending = speed;
+
+	if (speed == mSpeed)
+		return CLOCK_OK;
+
+	if (I2C_isBusy())
+		return CLOCK_DEFERRED;
+
+	Clock_apply(speed);
+
+	return CLOCK_OK;
+}
+
+
+////////////////////////////////////////////////////
+//Clock_setSpeed_blocking
+//Clock_setSpeed that sleeps through the i2c transfer
+//holding it off, see I2C_waitIdle.  For work that
+//needs the speed now, ie, a render at HIGH so the
+//SPI is not 8x slower.
+void Clock_setSpeed_blocking(Clock_Speed_t speed)
+{
+	while (Clock_setSpeed(speed) == CLOCK_DEFERRED)
+		I2C_waitIdle();
+}
+
+
+////////////////////////////////////////////////////
+//Clock_poll
+//Apply a deferred speed change once the i2c is
+//idle.  Call from the main loop.
+void Clock_poll(void)
+{
+	if ((mPending != mSpeed) && !I2C_isBusy())
+		Clock_apply(mPending);
+}
+
+
+////////////////////////////////////////////////////
+//Clock_apply
+//BDIV takes effect on the next ICSOUT cycle, no
+//need to wait on a status bit.  The dividers are
+//all compile time values.  Going to the HIGH speed
+//they are set first and going LOW after, so no
+//peripheral runs faster than its rate while BDIV
+//and the dividers don't match.
+//
+//With INSTRUMENT the latency covers the divider
+//change and all the peripheral updates, in timer
+//counts.
+static void Clock_apply(Clock_Speed_t speed)
+{
+#if INSTRUMENT
+	uint16_t start = 0x00;
+	unsigned long tick = 0x00;
+#endif
+
+	DisableInterrupts;
+
+#if INSTRUMENT
+	start = Timer_getCount();
+	tick = RTC_getTimeTick();
+
+	mResidency[mSpeed] += (tick - mLastTick);
+	mLastTick = tick;
+#endif
+
+	mSpeed = speed;
+
+	if (speed == CLOCK_SPEED_LOW)
+	{
+		ICSC2_BDIV = CLOCK_BDIV_LOW;
+		SPI_updateClock();
+		I2C_updateClock();
+		PWM_updateClock();
+	}
+	else
+	{
+		SPI_updateClock();
+		I2C_updateClock();
+		PWM_updateClock();
+		ICSC2_BDIV = CLOCK_BDIV;
+	}
+
+#if INSTRUMENT
+	mLatency = Timer_elapsed(start);
+	if (mLatency > mMaxLatency)
+		mMaxLatency = mLatency;
+#endif
+
+	EnableInterrupts;
+}
+
+
+Clock_Speed_t Clock_getSpeed(void)
+{
+	return mSpeed;
+}
+
+
+#if INSTRUMENT
+////////////////////////////////////////////////////
+//Returns the latency of the last speed change,
+//in timer counts (TIMER_TICK_US each)
+uint16_t Clock_getLatency(void)
+{
+	return mLatency;
+}
+
+
+uint16_t Clock_getMaxLatency(void)
+{
+	return mMaxLatency;
+}
+
+
+////////////////////////////////////////////////////
+//Returns the number of RTC ticks spent at a speed
+//since Clock_init or the last Clock_clearStats,
+//including the time at the current speed.
+unsigned long Clock_getResidency(Clock_Speed_t speed)
+{
+	unsigned long result = 0x00;
+
+	if (speed >= CLOCK_SPEED_NUM)
+		return 0x00;
+
+	DisableInterrupts;
+	result = mResidency[speed];
+	if (speed == mSpeed)
+		result += (RTC_getTimeTick() - mLastTick);
+	EnableInterrupts;
+
+	return result;
+}
+
+
+////////////////////////////////////////////////////
+//Clear the latency and residency counters
+void Clock_clearStats(void)
+{
+	DisableInterrupts;
+	mLatency = 0x00;
+	mMaxLatency = 0x00;
+	mLastTick = RTC_getTimeTick();
+	mResidency[CLOCK_SPEED_HIGH] = 0x00;
+	mResidency[CLOCK_SPEED_LOW] = 0x00;
+	EnableInterrupts;
+}
+#endif
+
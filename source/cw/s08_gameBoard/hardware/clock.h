@@ -3,18 +3,142 @@
  *
  *  Created on: Aug 3, 2019
  *      Author: danao
- * 
- * The purpose of this file is to configure the 
- * clock source on the nxp mc9s08qe8 processor
- * to use the external clock.
- * 
+ *
+ * The purpose of this file is to configure the
+ * clock source on the nxp mc9s08qe8 processor.
+ *
+ * Clock Profiles:
+ * The ICS mode and bus divider are picked with
+ * CLOCK_PROFILE and CLOCK_BDIV below (or with -D on
+ * the command line).  The resulting bus frequency is
+ * published as CLOCK_BUS_FREQ_HZ and all peripheral
+ * dividers (SPI, SCI, IIC, TPM, ADC) are computed from
+ * it, so changing the clock is one setting here.
+ *
+ * FEI - internal 31.25khz reference, FLL x512 = 16mhz
+ * FEE - 16mhz xtal / 512 = 31.25khz, FLL x512 = 16mhz
+ * FBE - 16mhz xtal, FLL bypassed but running
+ * FBELP - 16mhz xtal, FLL bypassed and disabled
+ *
+ * ICSOUT = 16mhz / BDIV, bus = ICSOUT / 2
+ * BDIV = 0 - 8mhz bus, 1 - 4mhz, 2 - 2mhz, 3 - 1mhz
+ *
+ * The fixed system clock (ICSFFCLK) is the FLL
+ * reference, 31.25khz in all profiles.  It does not
+ * change with BDIV.  TPM2 uses it, see timer.c
+ *
+ * Speed Scaling:
+ * Clock_setSpeed() switches the bus between the HIGH
+ * (CLOCK_BDIV) and LOW (CLOCK_BDIV_LOW) dividers at
+ * run time and re-derives the SPI, IIC and TPM1
+ * dividers for the new bus.  A switch asked for while
+ * an i2c transfer is on the bus waits for Clock_poll
+ * in the main loop and returns CLOCK_DEFERRED,
+ * Clock_setSpeed_blocking waits for the bus instead.
+ * SPI and TPM1 are not checked,
+ * only switch between SPI transfers.  With INSTRUMENT
+ * the latency of each switch is measured with TPM2
+ * (TIMER_TICK_US per count) and the time spent at
+ * each speed is counted in RTC ticks.
+ *
  */
 
 #ifndef CLOCK_H_
 #define CLOCK_H_
 
+#include "config.h"
+
+#define CLOCK_PROFILE_FEI			0
+#define CLOCK_PROFILE_FEE			1
+#define CLOCK_PROFILE_FBE			2
+#define CLOCK_PROFILE_FBELP			3
+
+//////////////////////////////////////////
+//Clock selection
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE				CLOCK_PROFILE_FBELP
+#endif
+
+#ifndef CLOCK_BDIV
+#define CLOCK_BDIV					0
+#endif
+
+//////////////////////////////////////////
+//Sources
+#define CLOCK_XTAL_FREQ_HZ			16000000UL
+#define CLOCK_IREF_FREQ_HZ			31250UL		//trimmed internal reference
+#define CLOCK_RDIV					4			//high range, 100 = divide by 512
+#define CLOCK_FLL_FACTOR			512UL		//DRS = 00, DMX32 = 0
+
+#define CLOCK_XTAL_REF_FREQ_HZ		(CLOCK_XTAL_FREQ_HZ >> (CLOCK_RDIV + 5))
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEI)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_IREF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			(CLOCK_IREF_FREQ_HZ * CLOCK_FLL_FACTOR)
+#elif (CLOCK_PROFILE == CLOCK_PROFILE_FEE)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_XTAL_REF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			(CLOCK_XTAL_REF_FREQ_HZ * CLOCK_FLL_FACTOR)
+#elif (CLOCK_PROFILE == CLOCK_PROFILE_FBE) || (CLOCK_PROFILE == CLOCK_PROFILE_FBELP)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_XTAL_REF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			CLOCK_XTAL_FREQ_HZ
+#else
+#error "clock.h - unknown CLOCK_PROFILE"
+#endif
+
+#if (CLOCK_BDIV > 3)
+#error "clock.h - CLOCK_BDIV must be 0 to 3"
+#endif
+
+//////////////////////////////////////////
+//Published frequencies
+#define CLOCK_ICSOUT_FREQ_HZ		(CLOCK_DCO_FREQ_HZ >> CLOCK_BDIV)
+#define CLOCK_BUS_FREQ_HZ			(CLOCK_ICSOUT_FREQ_HZ / 2)
+
+
+//////////////////////////////////////////
+//Runtime speed scaling - see Clock_setSpeed()
+//Only BDIV changes, the ICS mode set in Clock_init
+//stays the same, so there is no FLL lock time.
+//HIGH is the CLOCK_BDIV bus, LOW defaults to
+//divide by 8 - 1mhz bus with the 16mhz xtal.
+#ifndef CLOCK_BDIV_LOW
+#define CLOCK_BDIV_LOW				3
+#endif
+
+#if (CLOCK_BDIV_LOW > 3) || (CLOCK_BDIV_LOW < CLOCK_BDIV)
+#error "clock.h - CLOCK_BDIV_LOW must be CLOCK_BDIV to 3"
+#endif
+
+#define CLOCK_BUS_HIGH_FREQ_HZ		CLOCK_BUS_FREQ_HZ
+#define CLOCK_BUS_LOW_FREQ_HZ		((CLOCK_DCO_FREQ_HZ >> CLOCK_BDIV_LOW) / 2)
+
+typedef enum
+{
+	CLOCK_SPEED_HIGH,
+	CLOCK_SPEED_LOW,
+	CLOCK_SPEED_NUM
+}Clock_Speed_t;
+
+//Clock_setSpeed results
+#define CLOCK_OK					0x00
+#define CLOCK_DEFERRED				0x01
+#define CLOCK_ERROR					0x02
+
+
 void Clock_init(void);
+unsigned long Clock_getBusFreq(void);
+
+uint8_t Clock_setSpeed(Clock_Speed_t speed);
+void Clock_setSpeed_blocking(Clock_Speed_t speed);
+void Clock_poll(void);
+Clock_Speed_t Clock_getSpeed(void);
 
+#if INSTRUMENT
+uint16_t Clock_getLatency(void);
+uint16_t Clock_getMaxLatency(void);
+unsigned long Clock_getResidency(Clock_Speed_t speed);
+void Clock_clearStats(void);
+#endif
 
 
 #endif /* CLOCK_H_ */
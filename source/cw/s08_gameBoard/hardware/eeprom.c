@@ -4,15 +4,19 @@
  *  Created on: Oct 13, 2019
  *      Author: danao
  *  
- *  Memory controller file for the 24AA01 / 24LC01B.
+ *  Memory controller file for the 24AA014 / 24LC014.
  *  The eeprom ic uses the i2c interface and uses 
- *  address 0x50.  The general format consists 
+ *  address 0x50, A2 - A0 low, see eeprom.h.  The general format consists 
  *  write:
  *  i2c address, 8bit memory address, data0, data1, data2...
  *  read:
  *  i2c address, 8bit memory address,  i2c address, data read0, data read 1, etc
  *  Memory address max = 7 bits, 0x7F
  *  
+ *  Writes go out as page writes (8 bytes max, can't
+ *  cross a page) and the write cycle is detected by
+ *  ack polling, see EEPROM_waitReady.
+ *  
  */
 
 #include <hidef.h> /* for EnableInterrupts macro */
@@ -26,13 +30,10 @@
 //////////////////////////////////////////
 //EEPROM_writeByte.
 //Writes 2 bytes to eeprom: memory address, data
-//
+//and waits for the write cycle to complete
 void EEPROM_writeByte(uint8_t memoryAddress, uint8_t data)
 {
-	uint8_t status = 0x00;
-	RTC_delay(EEPROM_WRITE_DELAY);
-	status = I2C_write2Bytes(I2C_ADDRESS, memoryAddress, data);
-	RTC_delay(EEPROM_WRITE_DELAY);
+	EEPROM_write(memoryAddress, &data, 1);
 }
 
 //////////////////////////////////////////
@@ -41,54 +42,83 @@ void EEPROM_writeByte(uint8_t memoryAddress, uint8_t data)
 uint8_t EEPROM_readByte(uint8_t memoryAddress)
 {
 	uint8_t result = 0x00;
-	RTC_delay(EEPROM_WRITE_DELAY);
-	result = I2C_memoryRead(I2C_ADDRESS, memoryAddress);
-	RTC_delay(EEPROM_WRITE_DELAY);
+	EEPROM_read(memoryAddress, &result, 1);
 	return result;
 }
 
 
 //////////////////////////////////////////
-//Reads the cycle count, increments the 
-//value, then writes it back, returns the 
-//new value.  
-//clearFlag = if set, clear the cycle counter
-//if 0, increment the counter
-uint16_t EEPROM_updateCycleCount(void)
+//EEPROM_write
+//Write length bytes starting at memoryAddress.
+//Split into page writes so none crosses a page
+//boundary, each followed by ack polling until the
+//write cycle is done.  Returns the status of the
+//I2C, IIC_READY_STATUS if everything was written.
+uint8_t EEPROM_write(uint8_t memoryAddress, const uint8_t *far data, uint8_t length)
 {
-	uint16_t result = 0x00;
-	uint8_t high = 0x00;
-	uint8_t low = 0x00;
-
-	result = EEPROM_readCycleCount();
-	result += 1;
-	
-	//else, do nothing, and result = 0	
-	high = (uint8_t)((result >> 8) & 0xFF);
-	low = (uint8_t)(result & 0xFF);
-	
-	EEPROM_writeByte(EEPROM_ADDRESS_CYCLE_COUNT_MSB, high);
-	EEPROM_writeByte(EEPROM_ADDRESS_CYCLE_COUNT_LSB, low);
-	
-	return result;
+	uint8_t status = IIC_READY_STATUS;
+	uint8_t count = 0x00;
+
+	if ((memoryAddress >= EEPROM_SIZE) || (length > (EEPROM_SIZE - memoryAddress)))
+		return IIC_ERROR_STATUS;
+
+	while (length > 0)
+	{
+		//bytes left in this page
+		count = EEPROM_PAGE_SIZE - (memoryAddress & (EEPROM_PAGE_SIZE - 1));
+		if (count > length)
+			count = length;
+
+		status = I2C_memoryWriteArray(I2C_ADDRESS, memoryAddress, EEPROM_ADDRESS_SIZE, data, count);
+		if (status != IIC_READY_STATUS)
+			return status;
+
+		status = EEPROM_waitReady();
+		if (status != IIC_READY_STATUS)
+			return status;
+
+		memoryAddress += count;
+		data += count;
+		length -= count;
+	}
+
+	return status;
+}
+
+
+//////////////////////////////////////////
+//EEPROM_read
+//Read length bytes starting at memoryAddress into
+//data with one sequential read.  The address
+//counter in the part rolls over from the last byte
+//to the first, the length is checked so it doesn't.
+uint8_t EEPROM_read(uint8_t memoryAddress, uint8_t *far data, uint8_t length)
+{
+	if ((memoryAddress >= EEPROM_SIZE) || (length > (EEPROM_SIZE - memoryAddress)))
+		return IIC_ERROR_STATUS;
+
+	return I2C_memoryReadArray(I2C_ADDRESS, memoryAddress, EEPROM_ADDRESS_SIZE, data, length);
 }
 
 
-/////////////////////////////////////////////////
-//Reads the current cycle count from EEPROM
-//and returns the value
-uint16_t EEPROM_readCycleCount(void)
+//////////////////////////////////////////
+//EEPROM_waitReady
+//Ack polling - the part does not ack its address
+//during the internal write cycle.  Send the address
+//until it acks or EEPROM_POLL_TICKS RTC ticks have
+//passed, with interrupts enabled for the tick.
+//Returns IIC_READY_STATUS when the part is ready,
+//IIC_ERROR_STATUS on a timeout.
+uint8_t EEPROM_waitReady(void)
 {
-	uint16_t low = 0x00;
-	uint16_t high = 0x00;
-	uint16_t result = 0x00;
-	
-	low = EEPROM_readByte(EEPROM_ADDRESS_CYCLE_COUNT_LSB);
-	high = EEPROM_readByte(EEPROM_ADDRESS_CYCLE_COUNT_MSB);
-
-	result = ((high & 0xFF) << 8);
-	result |= (low & 0xFF);
-	
-	return result;
+	uint16_t start = (uint16_t)RTC_getTimeTick();
+
+	do
+	{
+		if (I2C_probe(I2C_ADDRESS) == IIC_READY_STATUS)
+			return IIC_READY_STATUS;
+	} while ((uint16_t)((uint16_t)RTC_getTimeTick() - start) < EEPROM_POLL_TICKS);
+
+	return IIC_ERROR_STATUS;
 }
 
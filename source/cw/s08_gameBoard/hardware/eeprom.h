@@ -12,18 +12,41 @@
 #include "derivative.h" /* include peripheral declarations */
 #include "config.h"
 
-//addresses
-#define EEPROM_WRITE_DELAY						((uint8_t)1)
+//24AA014 / 24LC014 - 128 bytes, A2 - A0 strapped low
+//for 0x50.  Not the 24AA01 / 24LC01B, they ignore the
+//address pins and answer 0x50 - 0x57 over the asset
+//eeprom, see assets.h.  The part has 16 byte pages,
+//writes here are kept to 8 byte pages, aligned, so
+//the stats log layout is the same on either part.
+//Writes can not cross a page boundary, the address
+//wraps to the start of the page.  A write cycle takes
+//up to 5ms, the part does not ack its address until
+//it is done.  Ack polling runs to a deadline in RTC
+//ticks, not a count of tries - a try takes longer at
+//the low bus speed or a slower SCL.  The tick can
+//come right after the start, so 2 ticks is at least
+//10ms at 100hz.  Set it with -D for a faster tick,
+//at least 5ms plus one tick.
+#define EEPROM_SIZE								128
+#define EEPROM_PAGE_SIZE						8
+#ifndef EEPROM_POLL_TICKS
+#define EEPROM_POLL_TICKS						2
+#endif
+#define EEPROM_ADDRESS_SIZE						1		//memory address bytes
 
+#define EEPROM_NUM_PAGES						(EEPROM_SIZE / EEPROM_PAGE_SIZE)
+
+//addresses - the whole part is the stats log, see
+//stats.c.  The cycle count was kept here before the
+//log, it is read once to carry it over.
 #define EEPROM_ADDRESS_CYCLE_COUNT_MSB			((uint8_t)0x02)
 #define EEPROM_ADDRESS_CYCLE_COUNT_LSB			((uint8_t)0x03)
 
 void EEPROM_writeByte(uint8_t memoryAddress, uint8_t data);
 uint8_t EEPROM_readByte(uint8_t memoryAddress);
 
-//stats
-//game cycle count.
-uint16_t EEPROM_updateCycleCount(void);
-uint16_t EEPROM_readCycleCount(void);
+uint8_t EEPROM_write(uint8_t memoryAddress, const uint8_t *far data, uint8_t length);
+uint8_t EEPROM_read(uint8_t memoryAddress, uint8_t *far data, uint8_t length);
+uint8_t EEPROM_waitReady(void);
 
 #endif /* EEPROM_H_ */
@@ -0,0 +1,152 @@
+/*
+ * flash.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Internal flash erase and program.  See flash.h
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "flash.h"
+#include "clock.h"
+
+
+///////////////////////////////////////////
+//RAM routine - launch the command and wait for it
+//to finish.  Copied to the stack by Flash_command
+//with the FSTAT address filled in.  Branches are
+//relative so it runs from any address.
+//
+//		LDA		#FCBEF_MASK
+//		STA		FSTAT			;launch the command
+//		NOP						;4 cycles before reading
+//		NOP						;the flags
+//		NOP
+//		NOP
+//loop:	LDA		FSTAT
+//		BIT		#FCCF_MASK
+//		BEQ		loop			;until the command is done
+//		RTS
+#define FLASH_CODE_LAUNCH_ADDR		3
+#define FLASH_CODE_WAIT_ADDR		10
+
+static const uint8_t mRamCode[] =
+{
+	0xA6, FSTAT_FCBEF_MASK,
+	0xC7, 0x00, 0x00,
+	0x9D, 0x9D, 0x9D, 0x9D,
+	0xC6, 0x00, 0x00,
+	0xA5, FSTAT_FCCF_MASK,
+	0x27, 0xF9,
+	0x81
+};
+
+
+static uint8_t Flash_command(uint16_t address, uint8_t data, uint8_t command);
+
+
+///////////////////////////////////////////
+//Flash_init
+//Set the flash clock divider.  Write once, call
+//once at power up.
+void Flash_init(void)
+{
+	if (!FCDIV_DIVLD)
+		FCDIV = (uint8_t)((FLASH_PRDIV8 << 6) | FLASH_DIV);
+}
+
+
+///////////////////////////////////////////
+//Erase the 512 byte sector with address in it, at
+//the HIGH bus speed for FCLK.  FLASH_ERROR if the
+//speed change is held off by an i2c transfer.
+//Returns FLASH_OK or FLASH_ERROR.
+uint8_t Flash_eraseSector(uint16_t address)
+{
+	uint8_t result = FLASH_OK;
+	Clock_Speed_t speed = Clock_getSpeed();
+
+	if (Clock_setSpeed(CLOCK_SPEED_HIGH) == CLOCK_OK)
+		result = Flash_command(address, 0x00, mPageErase);
+	else
+		result = FLASH_ERROR;
+	(void)Clock_setSpeed(speed);
+
+	return result;
+}
+
+
+///////////////////////////////////////////
+//Flash_program
+//Program length bytes of data starting at address,
+//one byte program command each.  The bytes have to
+//be erased - programming only clears bits.  One
+//switch to the HIGH bus speed for all of them,
+//FLASH_ERROR if an i2c transfer holds it off.
+//Returns FLASH_OK or FLASH_ERROR.
+uint8_t Flash_program(uint16_t address, const uint8_t *far data, uint8_t length)
+{
+	uint8_t i = 0x00;
+	uint8_t result = FLASH_OK;
+	Clock_Speed_t speed = Clock_getSpeed();
+
+	if (Clock_setSpeed(CLOCK_SPEED_HIGH) != CLOCK_OK)
+		result = FLASH_ERROR;
+
+	for (i = 0 ; (i < length) && (result == FLASH_OK) ; i++)
+		result = Flash_command(address + i, data[i], mByteProg);
+
+	(void)Clock_setSpeed(speed);
+
+	return result;
+}
+
+
+///////////////////////////////////////////
+//Flash_command
+//Run one flash command.  Writing the data to the
+//array latches the address, then the command, then
+//the RAM routine launches it and waits, interrupts
+//disabled from the launch until it is done.  The
+//caller has the bus at the HIGH speed - the speed
+//switch is kept off this stack frame, the routine
+//copy is already on it.
+static uint8_t Flash_command(uint16_t address, uint8_t data, uint8_t command)
+{
+	uint8_t code[sizeof(mRamCode)];
+	uint8_t i = 0x00;
+	uint8_t result = FLASH_OK;
+
+	for (i = 0 ; i < sizeof(mRamCode) ; i++)
+		code[i] = mRamCode[i];
+
+	code[FLASH_CODE_LAUNCH_ADDR] = (uint8_t)((uint16_t)&FSTAT >> 8);
+	code[FLASH_CODE_LAUNCH_ADDR + 1] = (uint8_t)((uint16_t)&FSTAT & 0xFF);
+	code[FLASH_CODE_WAIT_ADDR] = (uint8_t)((uint16_t)&FSTAT >> 8);
+	code[FLASH_CODE_WAIT_ADDR + 1] = (uint8_t)((uint16_t)&FSTAT & 0xFF);
+
+	DisableInterrupts;
+
+	//clear any errors from the last command
+	if (FSTAT & (FSTAT_FPVIOL_MASK | FSTAT_FACCERR_MASK))
+		FSTAT = FSTAT_FPVIOL_MASK | FSTAT_FACCERR_MASK;
+
+	while (!FSTAT_FCBEF){};
+
+	*(volatile uint8_t *far)address = data;
+	FCMD = command;
+
+	((void (*)(void))(uint16_t)code)();
+
+	if (FSTAT & (FSTAT_FPVIOL_MASK | FSTAT_FACCERR_MASK))
+		result = FLASH_ERROR;
+
+	EnableInterrupts;
+
+	return result;
+}
@@ -0,0 +1,66 @@
+/*
+ * flash.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Erase and program the internal flash.  The part has
+ * one flash array, so it can't be read while a command
+ * runs - the launch and the wait for the command to
+ * finish are copied to the stack and run from RAM,
+ * with interrupts disabled (the vectors and ISRs are
+ * in flash too).
+ *
+ * FCLK has to be 150 - 200khz.  FCDIV is write once,
+ * it is set for the HIGH bus speed.  Flash_eraseSector
+ * and Flash_program switch to the HIGH speed once for
+ * the whole call, not per byte.
+ *
+ * Sector erase is 4000 FCLK cycles, about 20ms with
+ * interrupts disabled.  Byte program is about 45us.
+ *
+ * The store is the FLASH_STORE_SECTORS sectors at
+ * 0xFA00 - 0xFDFF, just below the sector with the
+ * vectors, which can't be used.  It is a const array
+ * in the FLASH_STORE segment, which Project.prm
+ * places in its own STORE_ROM segment, so the log
+ * stays at the same address when the code grows or
+ * shrinks.  Only the STATS_BACKEND_FLASH build
+ * defines it, the EEPROM build lets constants
+ * (ROM_VAR) use the 1K instead.
+ *
+ */
+
+#ifndef FLASH_H_
+#define FLASH_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "clock.h"
+
+#define FLASH_SECTOR_SIZE			512
+#define FLASH_STORE_SECTORS			2
+
+#define FLASH_FCLK_MAX_HZ			200000UL
+
+//FCDIV - bus / 8 first above 12.8mhz, then
+//divide by DIV + 1, rounded so FCLK <= 200khz
+#if (CLOCK_BUS_HIGH_FREQ_HZ > 12800000UL)
+#define FLASH_PRDIV8				1
+#define FLASH_DIV					(((CLOCK_BUS_HIGH_FREQ_HZ / 8) + FLASH_FCLK_MAX_HZ - 1) / FLASH_FCLK_MAX_HZ - 1)
+#else
+#define FLASH_PRDIV8				0
+#define FLASH_DIV					((CLOCK_BUS_HIGH_FREQ_HZ + FLASH_FCLK_MAX_HZ - 1) / FLASH_FCLK_MAX_HZ - 1)
+#endif
+
+#define FLASH_OK					1
+#define FLASH_ERROR					0
+
+
+void Flash_init(void);
+uint8_t Flash_eraseSector(uint16_t address);
+uint8_t Flash_program(uint16_t address, const uint8_t *far data, uint8_t length);
+
+
+#endif /* FLASH_H_ */
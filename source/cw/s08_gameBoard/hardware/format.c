@@ -0,0 +1,205 @@
+/*
+ * format.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Integer to text, no divide.  See format.h
+ *
+ */
+
+#include <stddef.h>
+#include "config.h"
+#include "format.h"
+
+
+/////////////////////////////////////////////
+//Powers of ten, one per digit above the ones
+static const uint16_t mPowers[FORMAT_UNSIGNED_MAX - 1] =
+{
+	10000, 1000, 100, 10
+};
+
+static const uint32_t mLongPowers[FORMAT_LONG_MAX - 1] =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL
+};
+
+static const char mHexDigits[16] =
+{
+	'0', '1', '2', '3', '4', '5', '6', '7',
+	'8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+
+static uint8_t Format_digits(char *far buffer, uint16_t value, uint8_t width);
+
+
+///////////////////////////////////////////
+//Format_unsigned
+//0 - 65535, no leading zeros
+uint8_t Format_unsigned(char *far buffer, uint16_t value)
+{
+	return Format_digits(buffer, value, 1);
+}
+
+
+///////////////////////////////////////////
+//Format_signed
+//-32768 - 32767.  The magnitude is taken unsigned,
+//-32768 has no positive int16_t.
+uint8_t Format_signed(char *far buffer, int16_t value)
+{
+	if (value >= 0)
+		return Format_digits(buffer, (uint16_t)value, 1);
+
+	buffer[0] = '-';
+	return 1 + Format_digits(buffer + 1, (uint16_t)(0 - (uint16_t)value), 1);
+}
+
+
+///////////////////////////////////////////
+//Format_unsignedLong
+//Up to 10 digits.  Anything that fits 16 bits takes
+//the 16 bit path, 32 bit subtracts cost four times
+//as much.
+uint8_t Format_unsignedLong(char *far buffer, uint32_t value)
+{
+	uint8_t n = 0x00;
+	uint8_t i = 0x00;
+	char digit = '0';
+
+	if (value <= 0xFFFFUL)
+		return Format_digits(buffer, (uint16_t)value, 1);
+
+	for (i = 0 ; i < (FORMAT_LONG_MAX - 1) ; i++)
+	{
+		digit = '0';
+		while (value >= mLongPowers[i])
+		{
+			value -= mLongPowers[i];
+			digit++;
+		}
+
+		if ((digit != '0') || n)
+			buffer[n++] = digit;
+	}
+
+	buffer[n++] = (char)('0' + (uint8_t)value);
+	buffer[n] = 0x00;
+
+	return n;
+}
+
+
+///////////////////////////////////////////
+//Format_padded
+//Zero padded to width digits, 1 - 5.  A value
+//wider than width is all there, not cut.
+uint8_t Format_padded(char *far buffer, uint16_t value, uint8_t width)
+{
+	return Format_digits(buffer, value, width);
+}
+
+
+///////////////////////////////////////////
+//Format_tenths
+//value in tenths, 235 is "23.5", -5 is "-0.5".
+//The last digit is the tenths - the digits go out
+//at least 2 wide and the last one moves over for
+//the point, no divide by 10.
+uint8_t Format_tenths(char *far buffer, int16_t value)
+{
+	uint8_t n = 0x00;
+	uint16_t magnitude = (uint16_t)value;
+
+	if (value < 0)
+	{
+		buffer[n++] = '-';
+		magnitude = (uint16_t)(0 - (uint16_t)value);
+	}
+
+	n += Format_digits(buffer + n, magnitude, 2);
+
+	buffer[n] = buffer[n - 1];
+	buffer[n - 1] = '.';
+	n++;
+	buffer[n] = 0x00;
+
+	return n;
+}
+
+
+///////////////////////////////////////////
+//Format_hex
+//digits 1 - 4 hex digits, upper case, no 0x.
+//Always digits wide, the high ones are cut.
+uint8_t Format_hex(char *far buffer, uint16_t value, uint8_t digits)
+{
+	uint8_t n = 0x00;
+
+	if (digits < 1)
+		digits = 1;
+	if (digits > 4)
+		digits = 4;
+
+	while (digits--)
+		buffer[n++] = mHexDigits[(value >> (digits << 2)) & 0x0F];
+
+	buffer[n] = 0x00;
+
+	return n;
+}
+
+
+///////////////////////////////////////////
+//Format_string
+//Copy a 0x00 terminated string, for the text
+//between numbers
+uint8_t Format_string(char *far buffer, const char *far string)
+{
+	uint8_t n = 0x00;
+
+	while (string[n])
+	{
+		buffer[n] = string[n];
+		n++;
+	}
+
+	buffer[n] = 0x00;
+
+	return n;
+}
+
+
+///////////////////////////////////////////
+//Format_digits
+//Count each digit by subtracting its power of ten,
+//at most 9 times.  Leading zeros are skipped until
+//the first digit, or until there are width digits
+//left, 1 - 5.  The ones are what is left over.
+static uint8_t Format_digits(char *far buffer, uint16_t value, uint8_t width)
+{
+	uint8_t n = 0x00;
+	uint8_t i = 0x00;
+	char digit = '0';
+
+	for (i = 0 ; i < (FORMAT_UNSIGNED_MAX - 1) ; i++)
+	{
+		digit = '0';
+		while (value >= mPowers[i])
+		{
+			value -= mPowers[i];
+			digit++;
+		}
+
+		if ((digit != '0') || n || ((FORMAT_UNSIGNED_MAX - i) <= width))
+			buffer[n++] = digit;
+	}
+
+	buffer[n++] = (char)('0' + (uint8_t)value);
+	buffer[n] = 0x00;
+
+	return n;
+}
@@ -0,0 +1,61 @@
+/*
+ * format.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Integer to text without sprintf or a divide.  The
+ * HCS08 DIV is 16 by 8 bits only, a 16 or 32 bit % and
+ * / is a library loop, and sprintf pulls in all of
+ * printf for a few numbers.
+ *
+ * Decimal digits are counted by subtracting powers of
+ * ten, 10000 down to 10, at most 9 subtracts a digit,
+ * leading zeros skipped.  Hex is shifts and a table.
+ *
+ * Every function writes into the caller's buffer,
+ * adds a 0x00 after the text and returns the length
+ * without it.  Calls chain, each one starting where
+ * the last one stopped:
+ *
+ * n = Format_string(buffer, "T=");
+ * n += Format_tenths(buffer + n, temperature);
+ *
+ * The buffer needs room for the text and the 0x00 -
+ * the _MAX below plus 1, 6 for an unsigned, 7 signed,
+ * 8 tenths, 11 for an unsigned long.  Nothing checks.
+ *
+ * What it buys is ROM - no printf - and no long
+ * divide library calls on the HCS08, not speed on a
+ * PC.  On the host (source/host/format) the 16 bit
+ * calls are about as fast as sprintf, hex is much
+ * faster and Format_unsignedLong is slower, 0.6 -
+ * 0.7x - a 64 bit core divides by 10 in a few cycles
+ * and the subtract loop can't beat that.  Use the
+ * bench for the checks and the code size, not for
+ * board speed.
+ *
+ */
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stddef.h>
+#include "config.h"
+
+#define FORMAT_UNSIGNED_MAX			5			//65535
+#define FORMAT_SIGNED_MAX			6			//-32768
+#define FORMAT_LONG_MAX				10			//4294967295
+#define FORMAT_TENTHS_MAX			7			//-3276.8
+
+
+uint8_t Format_unsigned(char *far buffer, uint16_t value);
+uint8_t Format_signed(char *far buffer, int16_t value);
+uint8_t Format_unsignedLong(char *far buffer, uint32_t value);
+uint8_t Format_padded(char *far buffer, uint16_t value, uint8_t width);
+uint8_t Format_tenths(char *far buffer, int16_t value);
+uint8_t Format_hex(char *far buffer, uint16_t value, uint8_t digits);
+uint8_t Format_string(char *far buffer, const char *far string);
+
+
+#endif /* FORMAT_H_ */
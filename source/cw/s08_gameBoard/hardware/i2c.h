@@ -9,6 +9,44 @@
  *  approach and ISR generally follow along with the peripheral
  *  guide.  The light sensor breakout board from Adafruit is used
  *  to test the i2c.  The 7bit address is 0x39
+ *  
+ *  Transaction Queue:
+ *  Transfers are described by an I2C_Transfer_t owned by
+ *  the caller: address, memory address, tx buffer, rx
+ *  buffer and a callback.  The ISR reads and writes the
+ *  caller's buffers directly, nothing is copied, and the
+ *  lengths are only limited by the 16 bit counts.
+ *  I2C_submit() adds it to the queue and
+ *  returns right away.  The ISR runs the tx phase, then
+ *  a repeated start (I2C_FLAG_RESTART) or a stop and
+ *  start for the rx phase, and starts the next queued
+ *  transfer back to back.  Completed transfers are
+ *  handed back in order by I2C_poll() from the main
+ *  loop, which calls the callbacks.  The descriptor and
+ *  buffers must stay valid until then.
+ *  
+ *  The blocking functions below build a descriptor on
+ *  the stack, submit it and sleep until it is done.
+ *  Don't call them from a callback.
+ *  
+ *  Shared Driver:
+ *  This file and i2c.c are the same in every project
+ *  that uses the IIC (s08_gameBoard, s08_i2c), keep
+ *  the copies identical.  They need clock.h for the
+ *  bus frequencies, power.h and the RTC time tick.
+ *  The ISR state is at fixed addresses 0x244 - 0x25E,
+ *  keep that range out of the linker RAM segment.
+ *  
+ *  Timeouts and Bus Recovery:
+ *  Every phase of a transfer has to make progress
+ *  within I2C_TIMEOUT_TICKS RTC ticks, checked from
+ *  I2C_poll() and the blocking wait.  Waits on the bus
+ *  busy flag are bounded spins.  On a timeout the
+ *  transfer fails with IIC_ERROR_STATUS and the bus is
+ *  recovered - up to 9 SCL pulses until the slave lets
+ *  go of SDA, then a stop - before the next transfer
+ *  starts.  Worst case is 23 half periods of ~5us at
+ *  the full bus speed, about 1ms at the 1mhz bus.
  */
 
 #ifndef I2C_H_
@@ -18,27 +56,138 @@
 #include <hidef.h> /* for EnableInterrupts macro */
 #include "derivative.h" /* include peripheral declarations */
 #include "config.h"
+#include "clock.h"
 
 //I2C Address for the eeprom ic
 #define I2C_ADDRESS			(0x50 << 1)
 
-#define I2C_BUFFER_SIZE			4
+
+//SCL rate.  IICF is computed from the bus clock,
+//standard mode unless set with -D
+#define I2C_SCL_STANDARD_HZ		100000UL
+#define I2C_SCL_FAST_HZ			400000UL
+
+#ifndef I2C_SCL_FREQ_HZ
+#define I2C_SCL_FREQ_HZ			I2C_SCL_STANDARD_HZ
+#endif
+
+#if (I2C_SCL_FREQ_HZ > I2C_SCL_FAST_HZ)
+#error "i2c.h - I2C_SCL_FREQ_HZ above fast mode"
+#endif
+
+//IICF for the fastest SCL not above I2C_SCL_FREQ_HZ,
+//computed at compile time for each bus speed.
+//SCL = bus / (mul * div), mul 1, 2, 4 (MULT 00, 01,
+//10) and div from the ICR column of Table 12-4.
+//I2C_IICF_FOR is every mul * div there is, smallest
+//first, the smallest mul for a tie.
+#define I2C_SCL_DIV(bus)		(((bus) + I2C_SCL_FREQ_HZ - 1) / I2C_SCL_FREQ_HZ)
+#define I2C_IICF(bus)			((uint8_t)I2C_IICF_FOR(I2C_SCL_DIV(bus)))
+#define I2C_IICF_FOR(d)			(((d) <= 20) ? 0x00 : ((d) <= 22) ? 0x01 : ((d) <= 24) ? 0x02 :	\
+								((d) <= 26) ? 0x03 : ((d) <= 28) ? 0x04 : ((d) <= 30) ? 0x05 :	\
+								((d) <= 32) ? 0x09 : ((d) <= 34) ? 0x06 : ((d) <= 36) ? 0x0A :	\
+								((d) <= 40) ? 0x07 : ((d) <= 44) ? 0x0C : ((d) <= 48) ? 0x0D :	\
+								((d) <= 52) ? 0x43 : ((d) <= 56) ? 0x0E : ((d) <= 60) ? 0x45 :	\
+								((d) <= 64) ? 0x12 : ((d) <= 68) ? 0x0F : ((d) <= 72) ? 0x13 :	\
+								((d) <= 80) ? 0x14 : ((d) <= 88) ? 0x15 : ((d) <= 96) ? 0x19 :	\
+								((d) <= 104) ? 0x16 : ((d) <= 112) ? 0x1A : ((d) <= 120) ? 0x85 :	\
+								((d) <= 128) ? 0x17 : ((d) <= 136) ? 0x4F : ((d) <= 144) ? 0x1C :	\
+								((d) <= 160) ? 0x1D : ((d) <= 176) ? 0x55 : ((d) <= 192) ? 0x1E :	\
+								((d) <= 208) ? 0x56 : ((d) <= 224) ? 0x22 : ((d) <= 240) ? 0x1F :	\
+								((d) <= 256) ? 0x23 : ((d) <= 272) ? 0x8F : ((d) <= 288) ? 0x24 :	\
+								((d) <= 320) ? 0x25 : ((d) <= 352) ? 0x95 : ((d) <= 384) ? 0x26 :	\
+								((d) <= 416) ? 0x96 : ((d) <= 448) ? 0x2A : ((d) <= 480) ? 0x27 :	\
+								((d) <= 512) ? 0x2B : ((d) <= 576) ? 0x2C : ((d) <= 640) ? 0x2D :	\
+								((d) <= 768) ? 0x2E : ((d) <= 896) ? 0x32 : ((d) <= 960) ? 0x2F :	\
+								((d) <= 1024) ? 0x33 : ((d) <= 1152) ? 0x34 : ((d) <= 1280) ? 0x35 :	\
+								((d) <= 1536) ? 0x36 : ((d) <= 1792) ? 0x3A : ((d) <= 1920) ? 0x37 :	\
+								((d) <= 2048) ? 0x3B : ((d) <= 2304) ? 0x3C : ((d) <= 2560) ? 0x3D :	\
+								((d) <= 3072) ? 0x3E : ((d) <= 3584) ? 0x7A : ((d) <= 3840) ? 0x3F :	\
+								((d) <= 4096) ? 0x7B : ((d) <= 4608) ? 0x7C : ((d) <= 5120) ? 0x7D :	\
+								((d) <= 6144) ? 0x7E : ((d) <= 7168) ? 0xBA : ((d) <= 7680) ? 0x7F :	\
+								((d) <= 8192) ? 0xBB : ((d) <= 9216) ? 0xBC : ((d) <= 10240) ? 0xBD :	\
+								((d) <= 12288) ? 0xBE : 0xBF)
+
+//RTC ticks allowed for each phase of a transfer,
+//at least 1 tick - 10ms at 100hz, 1ms at 1khz
+#ifndef I2C_TIMEOUT_TICKS
+#define I2C_TIMEOUT_TICKS		2
+#endif
+
+//bounded spins on IICS_BUSY, a stop takes a few SCL
+//periods.  ~1ms at 8 loop cycles per pass.
+#define I2C_BUSY_SPIN_MAX		((uint16_t)(CLOCK_BUS_FREQ_HZ / 8000UL))
+
+//bus recovery - SCL pulses and the half period
+//delay loop count, ~5us at the full bus speed
+#define I2C_RECOVER_PULSES		9
+#define I2C_RECOVER_DELAY		((uint8_t)(CLOCK_BUS_FREQ_HZ / 1600000UL) + 1)
 
 #define IIC_ERROR_STATUS 0
 #define IIC_READY_STATUS 1
 #define IIC_HEADER_SENT_STATUS 2
 #define IIC_DATA_TRANSMISION_STATUS 3
 #define IIC_DATA_SENT_STATUS 4
+#define IIC_QUEUED_STATUS 5
+
+//transfer flags
+#define I2C_FLAG_RESTART		BIT0		//repeated start between tx and rx
+
+
+/////////////////////////////////////////
+//Transfer Descriptor
+//address - 8 bit bus address, bit 0 is set by the driver
+//memoryAddress / memoryAddressSize - register or memory
+//address sent MSB first ahead of txData, size 0, 1 or 2
+//txData / txLength - bytes to write, 0 for none
+//rxData / rxLength - bytes to read after the write, 0 for none
+//flags - I2C_FLAG_xx
+//callback - called from I2C_poll when done, can be NULL
+//status - IIC_QUEUED_STATUS until done, then
+//IIC_READY_STATUS or IIC_ERROR_STATUS
+//next - used by the queue
+typedef struct I2C_Transfer
+{
+	uint8_t address;
+	uint16_t memoryAddress;
+	uint8_t memoryAddressSize;
+	const uint8_t *far txData;
+	uint16_t txLength;
+	uint8_t *far rxData;
+	uint16_t rxLength;
+	uint8_t flags;
+	void (*callback)(struct I2C_Transfer *far xfer);
+	volatile uint8_t status;
+	struct I2C_Transfer *far next;
+}I2C_Transfer_t;
+
 
 void I2C_init(void);
+void I2C_updateClock(void);
+void I2C_recoverBus(void);
+
+void I2C_submit(I2C_Transfer_t *far xfer);
+void I2C_poll(void);
+uint8_t I2C_isBusy(void);
+void I2C_waitIdle(void);
+uint8_t I2C_transfer(I2C_Transfer_t *far xfer);
+
+uint16_t I2C_getTimeouts(void);
+uint16_t I2C_getRecoveries(void);
 
 uint8_t I2C_write1Byte(uint8_t address, uint8_t data0);
 uint8_t I2C_write2Bytes(uint8_t address, uint8_t data0, uint8_t data1);
 uint8_t I2C_readDataByte(uint8_t address);
 
+uint8_t I2C_readArray(uint8_t address, uint8_t *far data, uint16_t length);
+
 uint8_t I2C_memoryRead(uint8_t address, uint8_t memoryAddress);
 uint8_t I2C_memoryWrite(uint8_t address, uint8_t memoryAddress, uint8_t data);
 
+uint8_t I2C_memoryReadArray(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, uint8_t *far data, uint16_t length);
+uint8_t I2C_memoryWriteArray(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, const uint8_t *far data, uint16_t length);
+uint8_t I2C_probe(uint8_t address);
+
 void I2C_interruptHandler(void);
 
 
@@ -25,8 +25,13 @@
 
 /////////////////////////////////////////////////////
 //Framebuffer allocated to memory location 0x100
+//One band of the play area, see lcd.h
 volatile uint8_t frameBuffer[FRAME_BUFFER_SIZE] @ 0x100u;
 
+//mBandPage - play area page at the start of the
+//frame buffer, set by LCD_renderFrameBuffer
+static uint8_t mBandPage = 0x00;
+
 
 ////////////////////////////////////////////////
 //Waste CPU cycles
@@ -194,21 +199,17 @@ void LCD_clearFrameBuffer(uint8_t value, uint8_t update)
 	for (index = 0 ; index < FRAME_BUFFER_SIZE ; index++)
 		frameBuffer[index] = value;
 	
-	//update the contents of the display
+	//update the contents of the display, the whole
+	//play area, not just the band in the buffer
 	if (update == 1)
 	{
-		index = 0x00;
-		
-		LCD_setColumn(FRAME_BUFFER_OFFSET_X);
-		LCD_setPage(FRAME_BUFFER_START_PAGE);
-		
 		for (i = FRAME_BUFFER_START_PAGE ; i < FRAME_BUFFER_STOP_PAGE + 1 ; i++)
 		{
 			LCD_setColumn(FRAME_BUFFER_OFFSET_X);	//reset the x
 			LCD_setPage(i);							//increment the page
 			
 			for (j = 0 ; j < FRAME_BUFFER_WIDTH ; j++)
-				LCD_writeData(frameBuffer[index++]);
+				LCD_writeData(value);
 		}
 	}
 }
@@ -245,25 +246,57 @@ void LCD_clearBackground(uint8_t value)
 //Update the display with the contents of the
 //framebuffer.  The buffer is displayed at 
 //FRAME_BUFFER_OFFSET_X and FRAME_BUFFER_START_PAGE
-//over a height of FRAME_BUFFER_NUM_PAGES
+//plus the band, over a height of
+//FRAME_BUFFER_BAND_PAGES or what is left of the
+//play area
 //
 void LCD_updateFrameBuffer(void)
 {
-	uint8_t i, j;
-	uint16_t element = 0;
+	uint8_t i;
 	
 	volatile uint8_t *far ptr = frameBuffer;
 		
-	for (i = FRAME_BUFFER_START_PAGE ; i < FRAME_BUFFER_STOP_PAGE + 1 ; i++)
+	for (i = 0 ; i < FRAME_BUFFER_BAND_PAGES ; i++)
 	{
+		if ((mBandPage + i) >= FRAME_BUFFER_NUM_PAGES)
+			break;
+		
 		LCD_setColumn(FRAME_BUFFER_OFFSET_X);
-		LCD_setPage(i);
+		LCD_setPage(FRAME_BUFFER_START_PAGE + mBandPage + i);
 		LCD_writeDataBurst((uint8_t *far)ptr, FRAME_BUFFER_WIDTH);		
 		ptr += FRAME_BUFFER_WIDTH;
 	}	
 }
 
 
+//////////////////////////////////////////////
+//LCD_renderFrameBuffer
+//Redraw the whole play area one band at a time -
+//clear the buffer, call draw to fill it, send it.
+//draw runs FRAME_BUFFER_NUM_BANDS times a frame and
+//has to draw the same thing each time, only the
+//part in the band is kept.  The sprite rows outside
+//the band are skipped, see LCD_drawEnemyBitmap, so
+//the extra cost of a band is the walk over the
+//objects.  Leaves the first band selected.
+//Nothing here needs interrupts disabled, no ISR
+//touches the SPI or the frame buffer.
+void LCD_renderFrameBuffer(void (*draw)(void))
+{
+	uint8_t band = 0x00;
+	
+	for (band = 0 ; band < FRAME_BUFFER_NUM_BANDS ; band++)
+	{
+		mBandPage = band * FRAME_BUFFER_BAND_PAGES;
+		LCD_clearFrameBuffer(0x00, 0);
+		draw();
+		LCD_updateFrameBuffer();
+	}
+	
+	mBandPage = 0x00;
+}
+
+
 
 ////////////////////////////////////////////////////
 //LCD_drawString.
@@ -346,49 +379,6 @@ void LCD_drawStringLength(uint8_t row, uint8_t col, char *far mystring, uint8_t
 
 
 
-//////////////////////////////////////////
-//Print val into buffer of max size size.
-//returns the number of characters in the
-//the buffer.  Assumes the buffer
-//is clear prior to writing to it.
-uint8_t LCD_decimalToBuffer(unsigned int val, char far* buffer, uint8_t size)
-{
-    uint8_t i = 0;
-    char digit;
-    uint8_t num = 0;
-    char t;
-    
-    //test for a zero value
-    if (val == 0)
-    {
-    	buffer[0] = '0';
-    	buffer[1] = 0x00;
-    	return 1;
-    }
-
-    while (val > 0)
-    {
-        digit = (char)(val % 10);
-        buffer[num] = (0x30 + digit) & 0x7F;
-        num++;
-        val = val / 10;
-    }
-
-    //reverse in place
-    for (i = 0 ; i < num / 2 ; i++)
-    {
-        t = buffer[i];
-        buffer[i] = buffer[num - i - 1];
-        buffer[num - i - 1] = t;
-    }
-
-    buffer[num] = 0x00;     //null terminated
-
-    return num;
-}
-
-
-
 ///////////////////////////////////////////////////////////////
 //Draws image onto LCD directly.  Images are assumed to be page
 //aligned (width of a multiple of a page) and 1 bit per pixel 
@@ -456,13 +446,19 @@ void LCD_putPixelRam(uint16_t x, uint16_t y, uint8_t color, uint8_t update)
 	uint16_t element = 0x00;    //frame buffer element
 	uint8_t elementValue = 0x00;    
 	uint8_t bitShift = 0x00;
+	uint8_t page = 0x00;
 
     //test for valid input
 	if ((x > (FRAME_BUFFER_WIDTH - 1)) || (y > (FRAME_BUFFER_HEIGHT - 1)))
 		return;
 	
+	//not in the band that is in the buffer
+	page = (uint8_t)(y >> 3);
+	if ((page < mBandPage) || (page >= (mBandPage + FRAME_BUFFER_BAND_PAGES)))
+		return;
+	
 	//element the frame buffer to read / write
-	element = ((y >> 3) * FRAME_BUFFER_WIDTH) + x;
+	element = ((page - mBandPage) * FRAME_BUFFER_WIDTH) + x;
 	
 	//offset - MSB on bottom
 	if (y < 8)
@@ -598,7 +594,8 @@ void LCD_drawImageRam(uint16_t xPosition, uint16_t yPosition, Image_t image, uin
 //Transparency assumed 0 (ie, don't draw 0 pixels)
 //and update assumed to be 0 (ie, no update to the LCD)
 //Attempt to reduce code size
-void LCD_drawEnemyBitmap(uint16_t xPosition, uint16_t yPosition)
+//image - bmenemy1Bmp or a sprite from the assets
+void LCD_drawEnemyBitmap(uint16_t xPosition, uint16_t yPosition, const ImageData *far image)
 {
 	uint8_t bitValue = 0;
 	uint8_t p = 0;
@@ -612,11 +609,27 @@ void LCD_drawEnemyBitmap(uint16_t xPosition, uint16_t yPosition)
 	uint16_t y = yPosition;
 	 
 	//set the pointer
-	uint8_t *far ptr = bmenemy1Bmp.pImageData;
-	sizeX = bmenemy1Bmp.xSize;
-	sizeY = bmenemy1Bmp.ySize;
+	uint8_t *far ptr = image->pImageData;
+	uint16_t top = (uint16_t)mBandPage << 3;
+	uint16_t bottom = (uint16_t)(mBandPage + FRAME_BUFFER_BAND_PAGES) << 3;
+	uint16_t first = 0x00;
+	sizeX = image->xSize;
+	sizeY = image->ySize;
+	
+	//no rows in the band, skip the pixel loop
+	if (((yPosition + sizeY) <= top) || (yPosition >= bottom))
+		return;
+	
+	//only the rows in the band
+	if (yPosition < top)
+		first = top - yPosition;
+	if ((yPosition + sizeY) > bottom)
+		sizeY = (uint8_t)(bottom - yPosition);
+	
+	y = yPosition + first;
+	counter = first * (sizeX / 8);
 	         
-    for (i = 0 ; i < sizeY ; i++)
+    for (i = first ; i < sizeY ; i++)
     {
 		x = xPosition;        //reset the x position
 		
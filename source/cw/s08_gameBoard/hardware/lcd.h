@@ -18,7 +18,8 @@
  *  RAM is limited to 512 bytes.
  *  Framebuffer that is 64 x 48, offset 16 pixels to the 
  *  left and 8 pixels down.  This gives padding around the 
- *  edges of the main display.  Outside area is used for
+ *  edges of the main display, drawn in bands, see
+ *  FRAME_BUFFER_BAND_PAGES.  Outside area is used for
  *  drawing icons, score, etc.  
  *  
  *  
@@ -48,8 +49,15 @@
 
 //////////////////////////////////////////////
 //Note:  Frame buffer is not the full size of the
-//LCD due to memory constraints.
-#define FRAME_BUFFER_SIZE		320
+//LCD due to memory constraints.  The play area is
+//64 x 40, 5 pages, but the buffer only holds a band
+//of FRAME_BUFFER_BAND_PAGES - 128 bytes instead of
+//320.  LCD_renderFrameBuffer() clears, draws and
+//sends one band at a time, pixels outside the band
+//are dropped.  FRAME_BUFFER_BAND_PAGES 5 is the
+//whole play area in one pass, 320 bytes, for a
+//board with the RAM.  See source/host/render for
+//the cost of each band size.
 #define FRAME_BUFFER_WIDTH		64
 #define FRAME_BUFFER_HEIGHT		40
 #define FRAME_BUFFER_OFFSET_X	19
@@ -57,6 +65,15 @@
 #define FRAME_BUFFER_START_PAGE	2
 #define FRAME_BUFFER_STOP_PAGE	6
 #define FRAME_BUFFER_NUM_PAGES	5
+#ifndef FRAME_BUFFER_BAND_PAGES
+#define FRAME_BUFFER_BAND_PAGES	2
+#endif
+#define FRAME_BUFFER_NUM_BANDS	((FRAME_BUFFER_NUM_PAGES + FRAME_BUFFER_BAND_PAGES - 1) / FRAME_BUFFER_BAND_PAGES)
+#define FRAME_BUFFER_SIZE		(FRAME_BUFFER_BAND_PAGES * FRAME_BUFFER_WIDTH)
+
+#if (FRAME_BUFFER_BAND_PAGES < 1) || (FRAME_BUFFER_BAND_PAGES > FRAME_BUFFER_NUM_PAGES)
+#error "lcd.h - FRAME_BUFFER_BAND_PAGES must be 1 to FRAME_BUFFER_NUM_PAGES"
+#endif
 
 #define LCD_PLAYER_PAGE				7
 #define LCD_SCORE_PAGE				0
@@ -79,18 +96,17 @@ void LCD_clearPage(uint8_t page, uint8_t value);
 void LCD_clearFrameBuffer(uint8_t value, uint8_t update);
 void LCD_clearBackground(uint8_t value);
 void LCD_updateFrameBuffer(void);
+void LCD_renderFrameBuffer(void (*draw)(void));
 
 void LCD_drawString(uint8_t row, uint8_t col, char *far myString);
 void LCD_drawStringLength(uint8_t row, uint8_t col, char *far mystring, uint8_t length);
 
-uint8_t LCD_decimalToBuffer(unsigned int val, char far* buffer, uint8_t size);
-
 void LCD_drawImagePage(uint8_t x, uint8_t y, Image_t image);
 
 //functions that manipulate the framebuffer
 void LCD_putPixelRam(uint16_t x, uint16_t y, uint8_t color, uint8_t update);
 void LCD_drawImageRam(uint16_t xPosition, uint16_t yPosition, Image_t image, uint8_t trans, uint8_t update);
-void LCD_drawEnemyBitmap(uint16_t xPosition, uint16_t yPosition);
+void LCD_drawEnemyBitmap(uint16_t xPosition, uint16_t yPosition, const ImageData *far image);
 
 #endif /* LCD_H_ */
 
@@ -29,12 +29,12 @@
 //Configure output compare, output on PC0, toggle
 //pin on counter match.
 //PTCDD Bit 0 - No need to set as output
-//freq should be between 100hz and 20000hz for prescale = 8
+//freq should be between 100hz and 20000hz for a 1mhz timer clock
 void PWM_init(unsigned long freq)
 {
 	unsigned long reloadValue = 0x00;
 	
-	reloadValue = (1000000 / (2*freq)) - 1;
+	reloadValue = (PWM_TIMER_FREQ_HZ / (2*freq)) - 1;
 	
 	//TPM1SC - status and control register
 	TPM1SC_TOIE = 0;		//no interrupt
@@ -45,10 +45,8 @@ void PWM_init(unsigned long freq)
 	TPM1SC_CLKSA = 1;		//clk source - 01 - bus clock
 	
 	//prescaler bits - 000 = prescale = 1
-	//011 - prescale 8
-	TPM1SC_PS2 = 0;
-	TPM1SC_PS1 = 1;
-	TPM1SC_PS0 = 1;
+	//011 - prescale 8.  See PWM_PRESCALE in pwm.h
+	PWM_updateClock();
 	
 	//counter register - write any number to high or low
 	//clears counter.  Global, so affects all channels
@@ -63,13 +61,13 @@ void PWM_init(unsigned long freq)
 	//For Example: A pin change at 500hz
 	//Value = (8000000 / 8 / 500) - 1
 	//Value = 999
-	//Frequencies should be able to divide into 1000000
+	//Frequencies should be able to divide into PWM_TIMER_FREQ_HZ
 	TPM1C2VH = (uint8_t)((reloadValue) >> 8);
-	TPM1C2VL = (uint8_t)((reloadValue) % 0xFF);
+	TPM1C2VL = (uint8_t)((reloadValue) & 0xFF);
 	
 	//Modulo registers - set same as reload value	
 	TPM1MODH = (uint8_t)((reloadValue) >> 8);
-	TPM1MODL = (uint8_t)((reloadValue) % 0xFF);
+	TPM1MODL = (uint8_t)((reloadValue) & 0xFF);
 	
 	//status and control register TPM1CnSC
 	//Configure for output compare, toggle on a match, channel 2
@@ -89,6 +87,20 @@ void PWM_init(unsigned long freq)
 }
 
 
+/////////////////////////////////////////////
+//PWM_updateClock()
+//Set the TPM1 prescaler for the current bus speed.
+//The timer clock is the same at both speeds, see
+//pwm.h, so the reload values are left alone.
+void PWM_updateClock(void)
+{
+	if (Clock_getSpeed() == CLOCK_SPEED_LOW)
+		TPM1SC_PS = PWM_PRESCALE(CLOCK_BUS_LOW_FREQ_HZ);
+	else
+		TPM1SC_PS = PWM_PRESCALE(CLOCK_BUS_HIGH_FREQ_HZ);
+}
+
+
 /////////////////////////////////////////////
 //PWM_setFrequency()
 //Set range from 100 to 20000 hz.  If the value
@@ -97,15 +109,15 @@ void PWM_setFrequency(unsigned long freq)
 {
 	unsigned long reloadValue = 0x00;
 	
-	reloadValue = (1000000 / (2*freq)) - 1;
+	reloadValue = (PWM_TIMER_FREQ_HZ / (2*freq)) - 1;
 	
 	//set the registers
 	TPM1C2VH = (uint8_t)((reloadValue) >> 8);
-	TPM1C2VL = (uint8_t)((reloadValue) % 0xFF);
+	TPM1C2VL = (uint8_t)((reloadValue) & 0xFF);
 	
 	//Modulo registers - set same as reload value
 	TPM1MODH = (uint8_t)((reloadValue) >> 8);
-	TPM1MODL = (uint8_t)((reloadValue) % 0xFF);
+	TPM1MODL = (uint8_t)((reloadValue) & 0xFF);
 
 }
 
@@ -116,15 +128,15 @@ void PWM_setFreq_kHz(uint8_t far freq)
 	unsigned long reloadValue = 0x00;
 	unsigned long _freq = ((unsigned long)freq) * 1000;
 	
-	reloadValue = (1000000 / (2*_freq)) - 1;
+	reloadValue = (PWM_TIMER_FREQ_HZ / (2*_freq)) - 1;
 	
 	//set the registers
 	TPM1C2VH = (uint8_t)((reloadValue) >> 8);
-	TPM1C2VL = (uint8_t)((reloadValue) % 0xFF);
+	TPM1C2VL = (uint8_t)((reloadValue) & 0xFF);
 	
 	//Modulo registers - set same as reload value
 	TPM1MODH = (uint8_t)((reloadValue) >> 8);
-	TPM1MODL = (uint8_t)((reloadValue) % 0xFF);	
+	TPM1MODL = (uint8_t)((reloadValue) & 0xFF);	
 }
 
 
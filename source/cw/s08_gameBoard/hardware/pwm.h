@@ -11,6 +11,31 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
+
+//////////////////////////////////////////////
+//Timer clock - TPM1 runs from the bus clock with
+//the largest prescaler that keeps the timer clock
+//at or above 1mhz.  With the 16mhz xtal that is
+//1mhz for all the BDIV settings, so the reload
+//values computed from PWM_TIMER_FREQ_HZ stay the
+//same when Clock_setSpeed changes the bus.  Only
+//the prescaler is updated.
+#define PWM_TIMER_TARGET_HZ			1000000UL
+
+#define PWM_PRESCALE(bus)	(((bus) >= (PWM_TIMER_TARGET_HZ << 7)) ? 7 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 6)) ? 6 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 5)) ? 5 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 4)) ? 4 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 3)) ? 3 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 2)) ? 2 :	\
+							((bus) >= (PWM_TIMER_TARGET_HZ << 1)) ? 1 : 0)
+
+#define PWM_TIMER_FREQ_HZ	(CLOCK_BUS_FREQ_HZ >> PWM_PRESCALE(CLOCK_BUS_FREQ_HZ))
+
+#if ((CLOCK_BUS_LOW_FREQ_HZ >> PWM_PRESCALE(CLOCK_BUS_LOW_FREQ_HZ)) != PWM_TIMER_FREQ_HZ)
+#error "pwm.h - timer clock differs between clock speeds"
+#endif
 
 #define PWM_MIN_FREQ				100
 #define PWM_MAX_FREQ				20000
@@ -18,6 +43,7 @@
 #define PWM_DEFAULT_FREQ			1000
 
 void PWM_init(unsigned long freq);
+void PWM_updateClock(void);
 void PWM_setFrequency(unsigned long freq);
 
 void PWM_setFreq_kHz(uint8_t far freq);
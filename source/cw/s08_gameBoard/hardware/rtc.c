@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include "config.h"
 #include "rtc.h"
+#include "power.h"
 
 //global time tick for delay function
 volatile unsigned long gTimeTick = 0x00;
@@ -99,10 +100,16 @@ unsigned long RTC_getTimeTick(void)
 /////////////////////////////////////////////
 //Delay in units of timebase for RTC interrupt
 //ie, For RTC configured to 1khz timeout, units in ms
+//The core sleeps between ticks, see power.h.
 void RTC_delay(unsigned int delay)
 {
-	volatile unsigned long temp = delay + gTimeTick;
-	while (temp > gTimeTick){};	
+	unsigned long temp = 0x00;
+
+	DisableInterrupts;
+	temp = delay + gTimeTick;
+	EnableInterrupts;
+
+	POWER_SLEEP_WHILE(temp > gTimeTick);
 }
 
 
@@ -0,0 +1,94 @@
+/*
+ * stack.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Stack high water mark and guard check.  See stack.h
+ *
+ * The stack segment bounds come from the linker,
+ * __SEG_START_SSTACK is the lowest address and
+ * __SEG_END_SSTACK is one past the highest.  The
+ * stack grows down from the end.
+ *
+ */
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "stack.h"
+
+//linker defined, see the .prm file
+extern char far __SEG_START_SSTACK[];
+extern char far __SEG_END_SSTACK[];
+
+//mOverflow - set once the guard bytes are hit,
+//stays set until reset
+static uint8_t mOverflow = 0x00;
+
+
+///////////////////////////////////////////
+//Stack_init
+//The paint is done in _Startup, nothing to do
+//here except clear the overflow flag.  Startup
+//does not init the statics (__ONLY_INIT_SP)
+void Stack_init(void)
+{
+	mOverflow = 0x00;
+}
+
+
+///////////////////////////////////////////
+//Returns the size of the stack segment in bytes
+uint16_t Stack_getSize(void)
+{
+	return (uint16_t)(__SEG_END_SSTACK - __SEG_START_SSTACK);
+}
+
+
+///////////////////////////////////////////
+//Stack_getHighWater
+//Returns the most bytes of stack ever used.
+//Scans up from the bottom for the first byte
+//that is not the paint byte.  Can be off by one
+//if the last byte pushed happened to be the same
+//as the paint byte.
+uint16_t Stack_getHighWater(void)
+{
+	char *far ptr = __SEG_START_SSTACK;
+
+	while ((ptr < __SEG_END_SSTACK) && (*ptr == (char)STACK_PAINT_BYTE))
+		ptr++;
+
+	return (uint16_t)(__SEG_END_SSTACK - ptr);
+}
+
+
+///////////////////////////////////////////
+//Stack_checkGuard
+//Returns 1 if the guard bytes at the bottom of
+//the stack are untouched.  Returns 0 and sets the
+//overflow flag if not.
+uint8_t Stack_checkGuard(void)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < STACK_GUARD_SIZE ; i++)
+	{
+		if (__SEG_START_SSTACK[i] != (char)STACK_PAINT_BYTE)
+		{
+			mOverflow = 1;
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+
+///////////////////////////////////////////
+//Returns 1 if the guard check ever failed
+uint8_t Stack_isOverflow(void)
+{
+	return mOverflow;
+}
@@ -0,0 +1,57 @@
+/*
+ * stack.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Stack high water mark.  _Startup in start08.c fills
+ * the whole stack segment (SSTACK, STACKSIZE in the
+ * .prm file) with STACK_PAINT_BYTE before it jumps to
+ * main.  Anything that is still the paint byte has
+ * never been used, so scanning up from the bottom
+ * gives the deepest the stack has been since reset.
+ *
+ * The bottom STACK_GUARD_SIZE bytes are the guard.
+ * If any of those changed, the stack reached the end
+ * of its segment and the next push lands in whatever
+ * the linker put below it - the stack shares Z_RAM
+ * with DEFAULT_RAM, so game, rtc and sched state.
+ * Stack_checkGuard() is called once per frame and
+ * the frame sets the red LED while Stack_isOverflow()
+ * is set, Stack_getHighWater() is shown on the game
+ * over screen.
+ *
+ * What the guard does not cover:
+ * - it is checked once per frame, the RAM below has
+ *   already been written when it trips.
+ * - a function that reserves more than 4 bytes of
+ *   locals past the end and writes below the guard
+ *   without touching it, or pushes the paint byte
+ *   onto it, is missed.
+ * - the frame buffer (0x100) and FAR_RAM (0x180 -
+ *   0x23F) are above the stack, see Memory Allocation
+ *   in main.c.  An overflow runs through DEFAULT_RAM
+ *   first and can't reach them, a bad pointer or a
+ *   pop past the top can and the guard never sees it.
+ *
+ */
+
+#ifndef STACK_H_
+#define STACK_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+
+#define STACK_PAINT_BYTE			0xA5
+#define STACK_GUARD_SIZE			4
+
+
+void Stack_init(void);
+uint16_t Stack_getSize(void);
+uint16_t Stack_getHighWater(void);
+uint8_t Stack_checkGuard(void);
+uint8_t Stack_isOverflow(void);
+
+
+#endif /* STACK_H_ */
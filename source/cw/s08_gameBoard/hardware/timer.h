@@ -0,0 +1,33 @@
+/*
+ * timer.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Free running timer on TPM2 for measuring how long
+ * things take.  TPM1 is used for the PWM output, so
+ * use TPM2 clocked from the fixed system clock
+ * (ICSFFCLK), which does not change with the bus
+ * divider.  With the 16mhz xtal and RDIV = 512 that
+ * is 31.25khz, or 32us per count, and the counter
+ * rolls over about every 2 seconds.
+ *
+ * Only built with INSTRUMENT, see config.h
+ *
+ */
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "clock.h"
+
+#define TIMER_TICK_US			(1000000UL / CLOCK_FIXED_FREQ_HZ)
+
+void Timer_init(void);
+uint16_t Timer_getCount(void);
+uint16_t Timer_elapsed(uint16_t start);
+
+#endif /* TIMER_H_ */
@@ -19,6 +19,7 @@
 #define __NO_MAIN_OFFSET    /* we do not need the main field in the startup data descriptor */
 
 #include <start08.h>
+#include "stack.h"         /* STACK_PAINT_BYTE */
 
 #ifdef __cplusplus
 #define __EXTERN_C  extern "C"
@@ -29,6 +30,8 @@
 /*lint -esym(752, main) main is used in HLI */
 __EXTERN_C extern void main(void); /* prototype of main function */
 
+extern char __SEG_START_SSTACK[]; /* symbol defined by the linker for the start of the stack */
+
 /*lint -e961 -e537 -e451 non_bank.sgm is not a regular header file - it contains a CODE_SEG pragma only */
 #include "non_bank.sgm"
 /*lint +e961 +e537 +e451 */
@@ -304,6 +307,18 @@ __EXTERN_C void _Startup(void) {
     called from: _PRESTART-code generated by the Linker
 */
   INIT_SP_FROM_STARTUP_DESC(); /*lint !e960 MISRA 14.3 REQ, not a null statement (instead: several HLI statements) */
+
+  /* paint the whole stack segment for the high water mark, see stack.h */
+  /* nothing has been pushed yet, so this does not overwrite anything   */
+  asm {
+             LDHX   #__SEG_START_SSTACK
+             LDA    #STACK_PAINT_BYTE
+Paint_0:
+             STA    0,X
+             AIX    #1
+             CPHX   #__SEG_END_SSTACK
+             BNE    Paint_0
+  }
   
 #ifndef  __ONLY_INIT_SP
   Init(); /*lint !e522 function 'Init' contains inline assembly */
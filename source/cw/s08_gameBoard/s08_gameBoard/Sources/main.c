@@ -38,8 +38,20 @@
  * Use the tiny memory model, so that variables assigned
  * starting at 0x60 to 0xFF
  * 
- * Frame buffer assigned at 0x100 and size = 320 bytes
- * Remaining 32 bytes available starting at 0x240
+ * Z_RAM 0x60 - 0xFF - 64 byte stack, 96 for DEFAULT_RAM
+ * game 65, rtc 4, sched 12, main 2, clock 4, lcd /
+ * power / stack 3 - 90 used
+ * 
+ * Frame buffer assigned at 0x100 and size = 128 bytes,
+ * 2 of the 5 play area pages, see lcd.h
+ * 
+ * RAM 0x180 - 0x23F - FAR_RAM, 192 bytes, the linker
+ * checks it.  assets 117, stats 56, main 10 - 183 used
+ * INSTRUMENT - assets 73 (2 slots), stats 66, main 16,
+ * sched 8, power 12, clock 16 - 191 used
+ * 
+ * 0x240 - 0x25F - fixed addresses, game score / level
+ * and the i2c ISR state, outside the linker segments
  * 
  * 7947
  * 527
@@ -60,19 +72,73 @@
 #include "eeprom.h"
 #include "pwm.h"
 #include "lcd.h"
+#include "format.h"
 #include "game.h"
 #include "sound.h"
+#include "stats.h"
+#include "assets.h"
+#include "flash.h"
+#include "power.h"
+#include "sched.h"
+#include "stack.h"
 
 //prototypes
 void System_init(void);
+void Task_frame(void);
+void Task_gameOver(void);
+uint8_t Task_gameOverThread(Sched_Pt_t *far pt);
+#if INSTRUMENT
+static uint8_t Instrument_draw(uint8_t item);
+#endif
+
+//the frame buffer is at 0x100 and FAR_RAM starts
+//at 0x180, see Memory Allocation and Project.prm
+#if (FRAME_BUFFER_SIZE > 0x80)
+#error "main.c - frame buffer runs into FAR_RAM, see Project.prm"
+#endif
 
 //variables in main.
 static unsigned int gameLoopCounter = 0x00;
-uint8_t length = 0x00;
-static char far printBuffer[GAME_PRINT_BUFFER_SIZE] = {0x00};
-uint16_t cycleCounter = 0x00;
-uint8_t launchResult = 0x00;
-uint8_t missileFlag = 0x00;
+
+//only touched between frames, FAR_RAM.  The
+//INSTRUMENT counters are up to unsigned long.
+#if INSTRUMENT
+#define PRINT_BUFFER_SIZE	(FORMAT_LONG_MAX + 1)
+#else
+#define PRINT_BUFFER_SIZE	(FORMAT_UNSIGNED_MAX + 1)
+#endif
+
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static char far printBuffer[PRINT_BUFFER_SIZE] = {0x00};
+static Sched_Pt_t gameOverPt = {0x00};
+#if INSTRUMENT
+static uint8_t instrumentItem = 0x00;
+#endif
+#pragma DATA_SEG DEFAULT
+
+
+////////////////////////////////////////////
+//Task table - RTC at 100hz, 10ms per tick
+//Task_frame - one game frame, about the same
+//rate as the old loop (155ms).  While the game
+//over sequence runs the frames are idle and write
+//the stats back.
+//Task_gameOver - game over sequence, checks the
+//flag every tick and runs as a protothread.
+//Index in the table is the index for Sched_getWcet
+#define FRAME_TICKS		16
+#define TASK_GAME_OVER	0
+#define TASK_FRAME		1
+
+static const Sched_Task_t taskTable[] =
+{
+	//task				period	offset	priority
+	{Task_gameOver,		1,		0,		0},
+	{Task_frame,		FRAME_TICKS,	1,		1},
+};
+
+#define NUM_TASKS		(sizeof(taskTable) / sizeof(Sched_Task_t))
+
 
 void main(void) 
 {
@@ -80,136 +146,341 @@ void main(void)
 	System_init();				//configure system level config bits
 	Clock_init();				//configure clock for external
 	RTC_init_internal(RTC_FREQ_100HZ);	//use internal timer for 100hz interrupt
+	Power_init();				//sleep in WAIT / STOP3 between interrupts
+	Stack_init();				//stack painted in _Startup, see stack.h
 	
 	GPIO_init();				//IO
 	PWM_init(1000);				//PWM output on PC0
 	SPI_init();					//configure the SPI
 	I2C_init();					//configure i2c on PA2 and PA3
 	LCD_init();					//configure the LCD	
+	Assets_init();				//asset cache, before the game prefetches
 	Game_init();				//initialize the game
 	Sound_init();
+	SCHED_PT_INIT(&gameOverPt);
+	Sched_init(taskTable, NUM_TASKS);
 	EnableInterrupts;			//enable interrupts
+	(void)Clock_setSpeed(CLOCK_SPEED_LOW);	//full speed only to render
+	Flash_init();				//flash clock divider, for the stats
+	Stats_init();				//load the stats log
 	
 	while (1)
-	{	
-		
+	{
+		Sched_run();
+		I2C_poll();				//i2c completion callbacks
+		Clock_poll();			//speed change held off by the i2c
+		Assets_poll();			//next asset read, between frames
+	}
+}
 
-		//check for player move - move left
-		if (!(PTAD & BIT0))
-			Game_playerMoveLeft();
-		
-		//check for player move - move right
-		if (!(PTBD & BIT0))
-			Game_playerMoveRight();
-				
-		//check flag button press - fire
-		if (Game_flagGetButtonPress() == 1)
-		{
-			Game_flagClearButtonPress();
-			launchResult = Game_missilePlayerLaunch();
-			if (launchResult == 1)
-				Sound_playPlayerFire_blocking();
-		}
 
-		//check flag enemy missile launch
-		if (!(gameLoopCounter % 10))
-		{
-			launchResult = Game_missileEnemyLaunch();			
-			if (launchResult == 1)
-				Sound_playEnemyFire_blocking();
-		}
-		
-		//check flag player hit
-		if (Game_flagGetPlayerHitFlag() == 1)
-		{
-			Game_flagClearPlayerHitFlag();
-			Game_playExplosionPlayer_withSound();
-		}
-		
-		//check flag - enemy hit flag
-		if (Game_flagGetEnemyHitFlag() == 1)
+//////////////////////////////////////////////
+//Task_frame
+//One game frame - read the buttons, launch missiles,
+//handle the flags, move everything and redraw.
+//Nothing to do while the game over sequence runs,
+//except write back the stats one page per frame.
+//Game logic and sounds run at the low clock speed,
+//render and flush to the LCD at the high speed.
+//The stack guard is checked every frame, red LED on
+//from then on if the stack ran past the end of its
+//segment - the sounds clear it, so set it again.
+void Task_frame(void)
+{
+	uint8_t length = 0x00;
+	uint8_t launchResult = 0x00;
+	
+	(void)Stack_checkGuard();
+	if (Stack_isOverflow())
+		GPIO_setRed();
+
+	if (Game_flagGetGameOverFlag() == 1)
+	{
+		Stats_flush();
+		return;
+	}
+
+	Stats_add(STATS_PLAY_TIME, FRAME_TICKS);
+
+	//check for player move - move left
+	if (!(PTAD & BIT0))
+		Game_playerMoveLeft();
+	
+	//check for player move - move right
+	if (!(PTBD & BIT0))
+		Game_playerMoveRight();
+			
+	//check flag button press - fire
+	if (Game_flagGetButtonPress() == 1)
+	{
+		Game_flagClearButtonPress();
+		launchResult = Game_missilePlayerLaunch();
+		if (launchResult == 1)
 		{
-			Game_flagClearEnemyHitFlag();
-			Sound_playEnemyExplode_blocking();
+			Stats_add(STATS_SHOTS_FIRED, 1);
+			Sound_playPlayerFire_blocking();
 		}
+	}
+
+	//check flag enemy missile launch
+	if (!(gameLoopCounter % 10))
+	{
+		launchResult = Game_missileEnemyLaunch();			
+		if (launchResult == 1)
+			Sound_playEnemyFire_blocking();
+	}
+	
+	//check flag player hit
+	if (Game_flagGetPlayerHitFlag() == 1)
+	{
+		Game_flagClearPlayerHitFlag();
+		Game_playExplosionPlayer_withSound();
+	}
+	
+	//check flag - enemy hit flag
+	if (Game_flagGetEnemyHitFlag() == 1)
+	{
+		Game_flagClearEnemyHitFlag();
+		Stats_add(STATS_SHOTS_HIT, 1);
+		Sound_playEnemyExplode_blocking();
+	}
+	
+	//check level up flag
+	if (Game_flagGetLevelUpFlag() == 1)
+	{
+		Game_flagClearLevelUpFlag();	//clear the flag
+		Game_levelUp();					//level up			
+		Sound_playLevelUp_blocking();	//play sound
+	}
+	
+	//game over - the game over task picks it up
+	if (Game_flagGetGameOverFlag() == 1)
+		return;
+	
+	//move enemy and missile				
+	Game_enemyMove();					//move enemy
+	(void)Game_missileMove();			//move all missiles
+
+	//enemy and missiles, band by band.  The tick
+	//and the i2c keep running, see lcd.c
+	Clock_setSpeed_blocking(CLOCK_SPEED_HIGH);	//full speed for the SPI
+	LCD_renderFrameBuffer(Game_fieldDraw);
+	
+	//update the rest with interrupts disabled
+	DisableInterrupts;					//stop the timer
+	Game_playerDraw();					//update player image
+	
+	//display the header info - score, level, num players
+	LCD_drawString(0, 0, "S:");
+	length = Format_unsigned(printBuffer, Game_getGameScore());
+	LCD_drawStringLength(0, 18, printBuffer, length);
+
+	LCD_drawString(0, 60, "L:");
+	length = Format_unsigned(printBuffer, Game_getGameLevel());
+	LCD_drawStringLength(0, 74, printBuffer, length);
+	
+	switch(Game_getNumPlayers())
+	{
+		case 3:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON3);	break;
+		case 2:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON2);	break;
+		case 1:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON1);	break;
+	}
+
+	//reenable interrupts
+	EnableInterrupts;
+	(void)Clock_setSpeed(CLOCK_SPEED_LOW);
+
+	gameLoopCounter++;
+	GPIO_toggleGreen();
+}
+
+
+//////////////////////////////////////////////
+//Task_gameOver
+//Scheduler entry for the game over protothread.
+void Task_gameOver(void)
+{
+	Task_gameOverThread(&gameOverPt);
+}
+
+
+//////////////////////////////////////////////
+//Task_gameOverThread
+//Waits for the game over flag, plays the sound,
+//updates the stats and starts writing them back,
+//then flashes the game over screen every 500ms
+//until a button is pressed.  The bottom row shows
+//the stack high water mark against its size.  The
+//frame task is idle the whole time and writes the
+//rest.
+uint8_t Task_gameOverThread(Sched_Pt_t *far pt)
+{
+	uint8_t length = 0x00;
+	uint8_t col = 0x00;
+	
+	SCHED_PT_BEGIN(pt);
+
+	SCHED_PT_WAIT_UNTIL(pt, Game_flagGetGameOverFlag() == 1);
+
+	Sound_playGameOver_blocking();
+	
+	//update the stats in RAM, the first page
+	//write goes out now
+	Stats_add(STATS_CYCLE_COUNT, 1);
+	Stats_setMax(STATS_HIGH_SCORE, Game_getGameScore());
+	Stats_setMax(STATS_HIGH_LEVEL, Game_getGameLevel());
+	Stats_flush();
+
+	while (Game_flagGetGameOverFlag() == 1)
+	{
+		Clock_setSpeed_blocking(CLOCK_SPEED_HIGH);
+		Game_playGameOver();
 		
-		//check level up flag
-		if (Game_flagGetLevelUpFlag() == 1)
-		{
-			Game_flagClearLevelUpFlag();	//clear the flag
-			Game_levelUp();					//level up			
-			Sound_playLevelUp_blocking();	//play sound
-		}
+		//draw the new cycle counter
+		LCD_drawString(1, 0, "Game#:");
+		length = Format_unsigned(printBuffer, (uint16_t)Stats_get(STATS_CYCLE_COUNT));
+		LCD_drawStringLength(1, 50, printBuffer, length);
+
+		//high score and accuracy
+		LCD_drawString(0, 0, "Hi:");
+		length = Format_unsigned(printBuffer, (uint16_t)Stats_get(STATS_HIGH_SCORE));
+		LCD_drawStringLength(0, 26, printBuffer, length);
+		length = Format_unsigned(printBuffer, Stats_getAccuracy());
+		LCD_drawStringLength(0, 70, printBuffer, length);
+		LCD_drawString(0, 70 + (length << 3), "%");
+
+		//deepest stack use since reset / segment size
+		LCD_drawString(7, 0, "Stk:");
+		length = Format_unsigned(printBuffer, Stack_getHighWater());
+		LCD_drawStringLength(7, 34, printBuffer, length);
+		col = 34 + (length << 3);
+		LCD_drawString(7, col, "/");
+		length = Format_unsigned(printBuffer, Stack_getSize());
+		LCD_drawStringLength(7, col + 8, printBuffer, length);
+
+#if INSTRUMENT
+		instrumentItem = Instrument_draw(instrumentItem);
+#endif
+		(void)Clock_setSpeed(CLOCK_SPEED_LOW);
 		
-		//check flag - game over
-		if (Game_flagGetGameOverFlag() == 1)
+		//if either left or right
+		if ((!(PTAD & BIT0)) || (!(PTBD & BIT0)))
 		{
-			Sound_playGameOver_blocking();
+			Game_flagClearGameOverFlag();
 			
-			//update the cycle counter - pass 0 as the
-			//clear flag
-			cycleCounter = EEPROM_updateCycleCount();
-
-			while (Game_flagGetGameOverFlag() == 1)
-			{
-				Game_playGameOver();
-				
-				//draw the new cycle counter
-				LCD_drawString(1, 0, "Game#:");
-				length = LCD_decimalToBuffer(cycleCounter, printBuffer, GAME_PRINT_BUFFER_SIZE);
-				LCD_drawStringLength(1, 50, printBuffer, length);
-				
-				//if either left or right
-				if ((!(PTAD & BIT0)) || (!(PTBD & BIT0)))
-				{
-					Game_flagClearGameOverFlag();
-					
-					DisableInterrupts;
-					Game_init();
-					EnableInterrupts;
-				}
-
-				GPIO_toggleRed();
-				RTC_delay(50);				
-			}
-		}
-		
-		//move enemy and missile				
-		Game_enemyMove();					//move enemy
-		missileFlag = Game_missileMove();	//move all missiles
-
-		//update display with interrupts disabled
-		DisableInterrupts;					//stop the timer
-		LCD_clearFrameBuffer(0, 0);			//clear the ram buffer
-		Game_playerDraw();					//update player image
-		Game_enemyDraw();					//draw enemy
-		Game_missileDraw();					//draw missiles
-		LCD_updateFrameBuffer();			//update the display
-		
-		//display the header info - score, level, num players
-		LCD_drawString(0, 0, "S:");
-		length = LCD_decimalToBuffer(Game_getGameScore(), printBuffer, GAME_PRINT_BUFFER_SIZE);
-		LCD_drawStringLength(0, 18, printBuffer, length);
-
-		LCD_drawString(0, 60, "L:");
-		length = LCD_decimalToBuffer(Game_getGameLevel(), printBuffer, GAME_PRINT_BUFFER_SIZE);
-		LCD_drawStringLength(0, 74, printBuffer, length);
-		
-		switch(Game_getNumPlayers())
-		{
-			case 3:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON3);	break;
-			case 2:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON2);	break;
-			case 1:	LCD_drawImagePage(0, 90, BITMAP_PLAYER_ICON1);	break;
+			DisableInterrupts;
+			Game_init();
+			EnableInterrupts;
 		}
 
-		//reenable interrupts
-		EnableInterrupts;
+		GPIO_toggleRed();
+		SCHED_PT_DELAY(pt, 50);
+	}
 
-		gameLoopCounter++;
-		GPIO_toggleGreen();	//170ms with RTC at 1000hz, 155ms at 100hz
-		RTC_delay(10);
+	SCHED_PT_END(pt);
+}
+
+
+#if INSTRUMENT
+////////////////////////////////////////////
+//Instrument_draw
+//INSTRUMENT builds only.  Shows one measurement on
+//row 4 of the game over screen, the next one each
+//flash.  Returns the item to draw next time.
+//Tf / Tg - frame and game over task WCET, timer
+//counts (TIMER_TICK_US)
+//Pr / Pw / Ps - RTC ticks in RUN, WAIT and STOP3
+//Cl / Cm - last and longest speed switch, timer
+//counts
+//Ch / Cs - RTC ticks at the HIGH and LOW speed
+//Ss / Sr / Sw - stats log scan, read and longest
+//write, timer counts
+//Sn - stats entries written since power up
+//Ah / Am - asset cache hits and misses
+#define INSTRUMENT_ITEMS	15
+
+static uint8_t Instrument_draw(uint8_t item)
+{
+	Stats_Bench_t bench;
+	uint8_t length = 0x00;
+
+	Stats_getBench(&bench);
+
+	switch (item)
+	{
+		case 0:
+			LCD_drawString(4, 0, "Tf:");
+			length = Format_unsigned(printBuffer, Sched_getWcet(TASK_FRAME));
+			break;
+		case 1:
+			LCD_drawString(4, 0, "Tg:");
+			length = Format_unsigned(printBuffer, Sched_getWcet(TASK_GAME_OVER));
+			break;
+		case 2:
+			LCD_drawString(4, 0, "Pr:");
+			length = Format_unsignedLong(printBuffer, Power_getResidency(POWER_MODE_RUN));
+			break;
+		case 3:
+			LCD_drawString(4, 0, "Pw:");
+			length = Format_unsignedLong(printBuffer, Power_getResidency(POWER_MODE_WAIT));
+			break;
+		case 4:
+			LCD_drawString(4, 0, "Ps:");
+			length = Format_unsignedLong(printBuffer, Power_getResidency(POWER_MODE_STOP3));
+			break;
+		case 5:
+			LCD_drawString(4, 0, "Cl:");
+			length = Format_unsigned(printBuffer, Clock_getLatency());
+			break;
+		case 6:
+			LCD_drawString(4, 0, "Cm:");
+			length = Format_unsigned(printBuffer, Clock_getMaxLatency());
+			break;
+		case 7:
+			LCD_drawString(4, 0, "Ch:");
+			length = Format_unsignedLong(printBuffer, Clock_getResidency(CLOCK_SPEED_HIGH));
+			break;
+		case 8:
+			LCD_drawString(4, 0, "Cs:");
+			length = Format_unsignedLong(printBuffer, Clock_getResidency(CLOCK_SPEED_LOW));
+			break;
+		case 9:
+			LCD_drawString(4, 0, "Ss:");
+			length = Format_unsigned(printBuffer, bench.scan);
+			break;
+		case 10:
+			LCD_drawString(4, 0, "Sr:");
+			length = Format_unsigned(printBuffer, bench.read);
+			break;
+		case 11:
+			LCD_drawString(4, 0, "Sw:");
+			length = Format_unsigned(printBuffer, bench.maxWrite);
+			break;
+		case 12:
+			LCD_drawString(4, 0, "Sn:");
+			length = Format_unsigned(printBuffer, Stats_getWrites());
+			break;
+		case 13:
+			LCD_drawString(4, 0, "Ah:");
+			length = Format_unsigned(printBuffer, Assets_getHits());
+			break;
+		case 14:
+			LCD_drawString(4, 0, "Am:");
+			length = Format_unsigned(printBuffer, Assets_getMisses());
+			break;
+		default:
+			break;
 	}
+
+	LCD_drawStringLength(4, 26, printBuffer, length);
+
+	item++;
+	if (item >= INSTRUMENT_ITEMS)
+		item = 0x00;
+
+	return item;
 }
+#endif
 
 
 ////////////////////////////////////////////
@@ -217,7 +488,8 @@ void main(void)
 //These are write one-time registers.  Changing
 //any bit a second time has no effect.
 //
-//SOPT1 - Disable the watchdog and enable PTA5 as reset
+//SOPT1 - Disable the watchdog, enable PTA5 as reset
+//and enable the STOP instruction for power.c
 
 //SOPT2 - The appropriate bit to configure PWM output
 //		  on PC0 for TPM1CH2 - set to 1, default is 0
@@ -225,9 +497,10 @@ void System_init(void)
 {
 	//SOPT1 Register - Default = 0xC2
 	//Bit7 - Watchdog Enable
+	//Bit5 - STOPE - Stop mode enable
 	//Bit1 - 1 to enable BKGD/MS mode
 	//Bit0 - Enable PTA5 as reset
-	SOPT1 = 0x43;
+	SOPT1 = 0x63;
 
 	//this should disable all ability to be in debug mode
 //	SOPT1 = 0x41;		//bit 1 - set to 0 for BKGD/MS as PTA4
@@ -15,46 +15,82 @@
 
 #include <hidef.h> /* for EnableInterrupts macro */
 #include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
 #include "config.h"
 #include "i2c.h"
-#include "main.h"
+#include "power.h"
+#include "rtc.h"
 
-unsigned char I2C_STEP = IIC_READY_STATUS;
-unsigned char I2C_DATA_DIRECTION = 0;		//0 = read, 1 = write
-unsigned char I2C_RX_LENGTH = 1;
-unsigned char I2C_RX_COUNTER = 0;
 
-unsigned char I2C_TX_LENGTH = 1;
-unsigned char I2C_TX_COUNTER = 0;
-
-unsigned char I2C_TX_DATA[16] = {0x00};
-unsigned char I2C_RX_DATA[16] = {0x00};
+/////////////////////////////////////////////
+//I2C Globals 
+//These are used to control the i2c data flow
+//Declare these at far memory at specific addresses
+//
+//Queue - I2C_HEAD is the oldest transfer not yet
+//returned by I2C_poll, I2C_CURRENT is the one on the
+//bus, I2C_TAIL the last one submitted.  Everything
+//from HEAD up to CURRENT is complete.
+static I2C_Transfer_t *far I2C_HEAD @ 0x244u;
+static I2C_Transfer_t *far I2C_CURRENT @ 0x246u;
+static I2C_Transfer_t *far I2C_TAIL @ 0x248u;
+
+//data pointers for the transfer on the bus
+static const unsigned char *far I2C_TX_PTR @ 0x24Au;
+static unsigned char *far I2C_RX_PTR @ 0x24Cu;
+
+static unsigned char I2C_STEP @ 0x24Eu;
+static unsigned char I2C_DATA_DIRECTION @ 0x24Fu;		//0 = read, 1 = write
+static uint16_t I2C_RX_LENGTH @ 0x250u;
+static uint16_t I2C_RX_COUNTER @ 0x252u;
+static uint16_t I2C_TX_LENGTH @ 0x254u;			//memory address + tx data
+static uint16_t I2C_TX_COUNTER @ 0x256u;
+static unsigned char I2C_PREFIX_LENGTH @ 0x258u;	//memory address bytes
+
+//timeouts - RTC tick of the last progress on the bus
+static uint16_t I2C_PHASE_TICK @ 0x259u;
+static uint16_t I2C_TIMEOUTS @ 0x25Bu;
+static uint16_t I2C_RECOVERIES @ 0x25Du;
+
+
+static uint8_t I2C_startTransfer(I2C_Transfer_t *far xfer);
+static void I2C_completeTransfer(uint8_t status);
+static uint8_t I2C_waitBusFree(void);
+static void I2C_checkTimeout(void);
+static void I2C_recoverDelay(void);
 
-unsigned char I2C_NO_STOP_FLAG = 0x00;
-unsigned char I2C_RESTART_FLAG = 0x00;
 
 ///////////////////////////////////////////
 //Configure I2C on PA2 (SDA) and PA3 (SCL).
 void I2C_init(void)
 {
-	uint8_t dummy = 0x00;
+	//init the global values
+	I2C_STEP = IIC_READY_STATUS;
+	I2C_DATA_DIRECTION = 0;		//0 = read, 1 = write
+	I2C_RX_LENGTH = 0;
+	I2C_RX_COUNTER = 0;	
+	I2C_TX_LENGTH = 0;
+	I2C_TX_COUNTER = 0;	
+	I2C_PREFIX_LENGTH = 0;
+	I2C_TX_PTR = NULL;
+	I2C_RX_PTR = NULL;
+
+	I2C_HEAD = NULL;
+	I2C_CURRENT = NULL;
+	I2C_TAIL = NULL;
+
+	I2C_PHASE_TICK = 0;
+	I2C_TIMEOUTS = 0;
+	I2C_RECOVERIES = 0;
 	
 	IICC1_IICEN = 1;		//i2c enable
 	
 	IICA = I2C_ADDRESS;		//i2c slave address, not needed
 	
-	//IICF - set the baud rate
-	//From Table 12-4, use mult = 0x2 and ICR = 0x00
-	//for 100khz
-	IICF_MULT1 = 1;
-	IICF_MULT0 = 0;
-	
-	IICF_ICR5 = 0;
-	IICF_ICR4 = 0;
-	IICF_ICR3 = 0;
-	IICF_ICR2 = 0;
-	IICF_ICR1 = 0;
-	IICF_ICR0 = 0;
+	//IICF - set the baud rate - See Table 12-4
+	//For the 8mhz bus and 100khz this is mult = 0x2
+	//and ICR = 0x00, for 400khz mult = 0x0, ICR = 0x00
+	I2C_updateClock();
 	
 	I2C_STEP = IIC_READY_STATUS;
 
@@ -62,299 +98,579 @@ void I2C_init(void)
 }
 
 
-///////////////////////////////////////////////////////
-//Write data to I2C address.  numBytes is the size of the
-//data, either 1 or 2 bytes. Sends the MSB first
-//Returns the status of the I2C.  
-uint8_t I2C_writeData(uint8_t address, uint16_t data, uint8_t numBytes)
+
+////////////////////////////////////////////
+//I2C_updateClock
+//Set IICF for the current bus speed so SCL stays
+//at or below I2C_SCL_FREQ_HZ.  Called from I2C_init
+//and from Clock_setSpeed, not during a transfer.
+//Both values are computed at compile time, a project
+//without speed scaling only has the one.
+void I2C_updateClock(void)
 {
-	uint8_t dummy = 0x00;
-	
-	if ((numBytes > 2) || (numBytes == 0))
-		return IIC_ERROR_STATUS;
+#ifdef CLOCK_BUS_LOW_FREQ_HZ
+	if (Clock_getSpeed() == CLOCK_SPEED_LOW)
+		IICF = I2C_IICF(CLOCK_BUS_LOW_FREQ_HZ);
+	else
+		IICF = I2C_IICF(CLOCK_BUS_HIGH_FREQ_HZ);
+#else
+	IICF = I2C_IICF(CLOCK_BUS_FREQ_HZ);
+#endif
+}
+
+
+//////////////////////////////////////////////
+//I2C_submit
+//Add a transfer to the queue and return.  If the
+//bus is idle it starts right away, otherwise the
+//ISR starts it when the one ahead of it finishes.
+void I2C_submit(I2C_Transfer_t *far xfer)
+{
+	xfer->status = IIC_QUEUED_STATUS;
+	xfer->next = NULL;
+
+	DisableInterrupts;
+
+	if (I2C_TAIL != NULL)
+		I2C_TAIL->next = xfer;
+	else
+		I2C_HEAD = xfer;
 
-	if (numBytes == 1)
-		I2C_TX_DATA[0] = data & 0xFF;
-	else if (numBytes == 2)
+	I2C_TAIL = xfer;
+
+	//bus idle - start it here
+	if (I2C_CURRENT == NULL)
 	{
-		I2C_TX_DATA[0] = (data >> 8) & 0xFF;
-		I2C_TX_DATA[1] = data & 0xFF;		
+		I2C_CURRENT = xfer;
+		Power_setActive(POWER_PERIPH_IIC);
+
+		if (!I2C_startTransfer(xfer))
+			I2C_completeTransfer(IIC_ERROR_STATUS);
 	}
-	
-	I2C_TX_LENGTH = numBytes;
-	I2C_TX_COUNTER = 0x00;
-	I2C_STEP = IIC_HEADER_SENT_STATUS;
-	I2C_DATA_DIRECTION = 1;
 
-	address &= 0xFE;		//clear bit 0 for write
+	EnableInterrupts;
+}
 
-	IICC_IICEN = 0;
-	IICC_IICEN = 1;
-	
-	dummy = IICS;		//clear any interrupt	
-	IICS_IICIF = 1;
-	
-	IICC_MST = 0;		//slave
-	IICS_SRW = 0;
-	IICC_TX = 1;		//transmitter
-	IICC_MST = 1;		//generate start condition
 
-	//wait a bit
-	for (dummy = 0 ; dummy < 5 ; dummy++);
-	
-	//send the first byte, starting the interrupt sequence
-	IICD = address;
-	
-	//wait until it returns either an error or a ready state
-	while (I2C_STEP > IIC_READY_STATUS){};
-	
-	return I2C_STEP;			
+//////////////////////////////////////////////
+//I2C_poll
+//Call from the main loop.  Fails the transfer on
+//the bus if it timed out, then removes the completed
+//transfers from the queue in the order they were
+//submitted and calls their callbacks.
+void I2C_poll(void)
+{
+	I2C_Transfer_t *far xfer = NULL;
+
+	DisableInterrupts;
+	I2C_checkTimeout();
+	EnableInterrupts;
+
+	while (1)
+	{
+		DisableInterrupts;
+
+		xfer = I2C_HEAD;
+		if ((xfer == NULL) || (xfer == I2C_CURRENT))
+		{
+			EnableInterrupts;
+			return;
+		}
+
+		I2C_HEAD = xfer->next;
+		if (I2C_HEAD == NULL)
+			I2C_TAIL = NULL;
+
+		EnableInterrupts;
+
+		if (xfer->callback != NULL)
+			xfer->callback(xfer);
+	}
 }
 
-//////////////////////////////////////////////////
-//Send numBytes over the i2c.  Contents of data array
-//are copied into I2C_TX_DATA and sent over i2c.
-//The approach follows along with the peripheral guide
-//
-uint8_t I2C_writeDataArray(uint8_t address, uint8_t far* data, uint8_t numBytes)
-{	
-	uint8_t dummy = 0x00;
-	
-	//copy numBytes into I2C_TX_DATA
-	for (dummy = 0 ; dummy < numBytes ; dummy++)
-		I2C_TX_DATA[dummy] = data[dummy];
-	
-	I2C_TX_LENGTH = numBytes;
-	I2C_TX_COUNTER = 0x00;
-	I2C_STEP = IIC_HEADER_SENT_STATUS;
-	I2C_DATA_DIRECTION = 1;
-	
-	address &= 0xFE;		//clear bit 0 for write
-	
-	IICC_IICEN = 0;
-	IICC_IICEN = 1;
-	
-	dummy = IICS;		//clear any interrupt	
-	IICS_IICIF = 1;
-	
-	IICC_MST = 0;		//slave
-	IICS_SRW = 0;
-	IICC_TX = 1;		//transmitter
-	IICC_MST = 1;		//generate start condition
-	
-	//wait a bit
-	for (dummy = 0 ; dummy < 5 ; dummy++);
 
-	//start the transmission and the interrupt sequence.
-	IICD = address;
+//////////////////////////////////////////////
+//Returns 1 if a transfer is on the bus
+uint8_t I2C_isBusy(void)
+{
+	uint8_t result = 0x00;
+
+	DisableInterrupts;
+	result = (I2C_CURRENT != NULL) ? 1 : 0;
+	EnableInterrupts;
 
-	//wait until it returns either an error or a ready state
-	while (I2C_STEP > IIC_READY_STATUS){};
-	
-	return I2C_STEP;		
+	return result;
 }
 
 
-/////////////////////////////////////////////////////
-//Read numBytes into data array from address.  
-//Uses I2C_RX_DATA to read the data, then copies
-//it when returning if the status is ready
-uint8_t I2C_readDataArray(uint8_t address, uint8_t far* data, uint8_t numBytes)
+//////////////////////////////////////////////
+//I2C_waitIdle
+//Blocking - sleep until no transfer is on the bus,
+//with the same timeout check as I2C_transfer.  The
+//queue behind the current transfer runs back to
+//back, so this waits for all of it.  Nothing is
+//handed back, call I2C_poll for that.
+void I2C_waitIdle(void)
 {
-	uint8_t temp;
-	
-	I2C_RX_LENGTH = numBytes;	
-	I2C_RX_COUNTER = 0;
-	I2C_STEP = IIC_HEADER_SENT_STATUS;
-	I2C_DATA_DIRECTION = 0;				//receiver
-	
-	//set the address with bit 0 high
-	address &= 0xFE;
-	address |= 0x01;		//set as read
-	
-	temp = IICS;			//clear pending interrupts
-	IICS_IICIF = 1;
-	
-	IICC1_TXAK = 0x00;		//ack signal is sent after receiving one data byte
-	IICC_TX = 1;			//transmitter to send address but with add bit 0 high
-	
-	//generate the start or a restart
-	if (I2C_RESTART_FLAG == 1)
+	DisableInterrupts;
+	while (I2C_CURRENT != NULL)
 	{
-		IICC_RSTA = 1;
-		I2C_RESTART_FLAG = 0;
+		I2C_checkTimeout();
+		if (I2C_CURRENT != NULL)
+			Power_sleep();
 	}
-	else
-	{
-		IICC_MST = 1;			//generate start condition		
-	}
-	
-	//wait a bit
-	for (temp = 0 ; temp < 5 ; temp++);
-	
-	//send the address
-	IICD = address;
-	
-	//wait until it returns either an error or a ready state
-	while (I2C_STEP > IIC_READY_STATUS){};
+	EnableInterrupts;
+}
+
 
-	//copy the data if it's valid and no errors
-	if (I2C_STEP == IIC_READY_STATUS)
+//////////////////////////////////////////////
+//I2C_transfer
+//Blocking - submit the transfer, sleep until it is
+//done, then hand back everything that completed
+//including this one.  Returns the status.  The RTC
+//tick wakes the core to check the timeout, so this
+//returns within I2C_TIMEOUT_TICKS of the last
+//progress on the bus.
+uint8_t I2C_transfer(I2C_Transfer_t *far xfer)
+{
+	I2C_submit(xfer);
+
+	//same as POWER_SLEEP_WHILE, with the timeout
+	//check each time the core wakes up
+	DisableInterrupts;
+	while (xfer->status == IIC_QUEUED_STATUS)
 	{
-		//copy the data from the rx buffer into data
-		for (temp = 0 ; temp < numBytes ; temp++)
-			data[temp] = I2C_RX_DATA[temp];
+		I2C_checkTimeout();
+		if (xfer->status == IIC_QUEUED_STATUS)
+			Power_sleep();
 	}
-	
-	return I2C_STEP;
+	EnableInterrupts;
+
+	I2C_poll();
+
+	return xfer->status;
 }
 
 
+//////////////////////////////////////////////
+//Write 1 byte to i2c address
+uint8_t I2C_write1Byte(uint8_t address, uint8_t data0)
+{
+	I2C_Transfer_t xfer;
+
+	xfer.address = address;
+	xfer.memoryAddressSize = 0;
+	xfer.txData = &data0;
+	xfer.txLength = 1;
+	xfer.rxData = NULL;
+	xfer.rxLength = 0;
+	xfer.flags = 0x00;
+	xfer.callback = NULL;
+	
+	return I2C_transfer(&xfer);
+}
 
 
+uint8_t I2C_write2Bytes(uint8_t address, uint8_t data0, uint8_t data1)
+{
+	I2C_Transfer_t xfer;
+	uint8_t buffer[2];
+	
+	buffer[0] = data0;
+	buffer[1] = data1;
+
+	xfer.address = address;
+	xfer.memoryAddressSize = 0;
+	xfer.txData = buffer;
+	xfer.txLength = 2;
+	xfer.rxData = NULL;
+	xfer.rxLength = 0;
+	xfer.flags = 0x00;
+	xfer.callback = NULL;
+	
+	return I2C_transfer(&xfer);
+}
+
 
-//////////////////////////////////////////////////////
-//I2C_writeReadData - 
-//write txBytes of txData to address, generate 
-//a restart condition, then read rxBytes into rxData
-//return the status.  Two flags are used to indicate
-//no stop condition after completing the write, and 
-//generate a restart prior to reading.
+
+///////////////////////////////////////////////////////
+//Read 1 byte from i2c address and returns the result
 //
-uint8_t I2C_writeReadData(uint8_t address, uint8_t far* txData, uint8_t txBytes, uint8_t far* rxData, uint8_t rxBytes)
+uint8_t I2C_readDataByte(uint8_t address)
 {
-	uint8_t status = 0x00;					//status of the i2c transfer
+	uint8_t result = 0x00;
 
-	//no stop condition generated after completing write cycle
-	I2C_NO_STOP_FLAG = 1;
+	if (I2C_readArray(address, &result, 1) != IIC_READY_STATUS)
+		result = 0x00;
+		
+	return result;
+}
 
-	//write step - waits until all tx bytes are complete
-	status = I2C_writeDataArray(address, txData, txBytes);
-	
-	//clear the no stop flag
-	I2C_NO_STOP_FLAG = 0;
-	
-	//generate a restart in the read segment
-	I2C_RESTART_FLAG = 1;
 
-	//read step - waits until all rx bytes are complete
-	status = I2C_readDataArray(address, rxData, rxBytes);
+///////////////////////////////////////////////////////
+//I2C_readArray
+//Read length bytes from i2c address into data.
+//Returns the status of the I2C
+uint8_t I2C_readArray(uint8_t address, uint8_t *far data, uint16_t length)
+{
+	I2C_Transfer_t xfer;
 
-	//clear the flags
-	I2C_RESTART_FLAG = 0;
-	I2C_NO_STOP_FLAG = 0;
-	
-	return status;
+	if (!length)
+		return IIC_READY_STATUS;
+
+	xfer.address = address;
+	xfer.memoryAddressSize = 0;
+	xfer.txData = NULL;
+	xfer.txLength = 0;
+	xfer.rxData = data;
+	xfer.rxLength = length;
+	xfer.flags = 0x00;
+	xfer.callback = NULL;
+
+	return I2C_transfer(&xfer);
 }
 
 
+
 ///////////////////////////////////////////////////////////
 //I2C_memoryRead
 //Reads data from I2C at a memory address. 
-//Sends addressSize bytes as a write to address, generates
-//a restart condition, then reads rxBytes into rxData array
-//Memory address is sent to the I2C MSB first.  Memory
-//address size can be either 1 or 2 bytes.  Returns the
-//status of the I2C
-uint8_t I2C_memoryRead(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, uint8_t far* data, uint8_t bytes)
+//Memory address is one byte.
+//Sends 1 byte address as a write, a restart, reads
+//one byte.  Returns the byte read, 0 on an error.
+uint8_t I2C_memoryRead(uint8_t address, uint8_t memoryAddress)
 {
-	uint8_t status = 0x00;					//status of the i2c transfer
-
-	//no stop condition generated after completing write cycle
-	I2C_NO_STOP_FLAG = 1;
-
-	//write step - waits until all tx bytes are complete
-	status = I2C_writeData(address, memoryAddress, addressSize);
+	uint8_t result = 0x00;
 
-	if (status == IIC_ERROR_STATUS)
-		return status;
+	if (I2C_memoryReadArray(address, memoryAddress, 1, &result, 1) != IIC_READY_STATUS)
+		result = 0x00;
 	
-	//clear the no stop flag
-	I2C_NO_STOP_FLAG = 0;
-	
-	//generate a restart in the read segment
-	I2C_RESTART_FLAG = 1;
-
-	//read step - waits until all rx bytes are complete
-	status = I2C_readDataArray(address, data, bytes);
-
-	//clear the flags
-	I2C_RESTART_FLAG = 0;
-	I2C_NO_STOP_FLAG = 0;
-	
-	return status;	
+	return result;
 }
 
 
 /////////////////////////////////////////////////////////
 //I2C_memoryWrite
 //Write data to a memory address over I2C bus. 
-//Sends addressSize bytes as a write to address, followed
-//by a write data of length bytes.  Memory address is 
-//sent to the I2C MSB first.  Memory address size can be
-//either 1 or 2 bytes.  Returns the status of the I2C
-//Similar to a write array, but copy the memory address
-//bytes into the array. 
+//Memory address is one byte.  Returns the status
+//of the I2C
 //
-uint8_t I2C_memoryWrite(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, uint8_t far* data, uint8_t bytes)
+uint8_t I2C_memoryWrite(uint8_t address, uint8_t memoryAddress, uint8_t data)
 {
-	uint8_t dummy = 0x00;
-	uint8_t count = 0x00;
-	
-	//copy the memoryAddress bytes into I2C_TX_DATA
-	if (addressSize == 1)
+	return I2C_write2Bytes(address, memoryAddress, data);
+}
+
+
+///////////////////////////////////////////////////////////
+//I2C_memoryReadArray
+//Sequential read - sends the memory address as a write,
+//a repeated start, then reads length bytes into data,
+//all in one transfer.  addressSize is 1 or 2 bytes,
+//sent MSB first.  Returns the status of the I2C
+uint8_t I2C_memoryReadArray(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, uint8_t *far data, uint16_t length)
+{
+	I2C_Transfer_t xfer;
+
+	if ((addressSize == 0) || (addressSize > 2))
+		return IIC_ERROR_STATUS;
+
+	xfer.address = address;
+	xfer.memoryAddress = memoryAddress;
+	xfer.memoryAddressSize = addressSize;
+	xfer.txData = NULL;
+	xfer.txLength = 0;
+	xfer.rxData = data;
+	xfer.rxLength = length;
+	xfer.flags = I2C_FLAG_RESTART;
+	xfer.callback = NULL;
+
+	return I2C_transfer(&xfer);
+}
+
+
+/////////////////////////////////////////////////////////
+//I2C_memoryWriteArray
+//Writes the memory address followed by length bytes
+//from data in one transfer.  The address goes out of
+//the descriptor, the data straight from the caller's
+//buffer.  addressSize is 1 or 2 bytes, sent MSB
+//first.  Returns the status of the I2C
+uint8_t I2C_memoryWriteArray(uint8_t address, uint16_t memoryAddress, uint8_t addressSize, const uint8_t *far data, uint16_t length)
+{
+	I2C_Transfer_t xfer;
+
+	if ((addressSize == 0) || (addressSize > 2))
+		return IIC_ERROR_STATUS;
+
+	xfer.address = address;
+	xfer.memoryAddress = memoryAddress;
+	xfer.memoryAddressSize = addressSize;
+	xfer.txData = data;
+	xfer.txLength = length;
+	xfer.rxData = NULL;
+	xfer.rxLength = 0;
+	xfer.flags = 0x00;
+	xfer.callback = NULL;
+
+	return I2C_transfer(&xfer);
+}
+
+
+/////////////////////////////////////////////////////////
+//I2C_probe
+//Sends the address as a write with no data, then a
+//stop.  Returns IIC_READY_STATUS if the device acked
+//the address, IIC_ERROR_STATUS if not.  Used for ack
+//polling an eeprom during its internal write cycle.
+uint8_t I2C_probe(uint8_t address)
+{
+	I2C_Transfer_t xfer;
+
+	xfer.address = address;
+	xfer.memoryAddressSize = 0;
+	xfer.txData = NULL;
+	xfer.txLength = 0;
+	xfer.rxData = NULL;
+	xfer.rxLength = 0;
+	xfer.flags = 0x00;
+	xfer.callback = NULL;
+
+	return I2C_transfer(&xfer);
+}
+
+
+
+/////////////////////////////////////////////////////////
+//I2C_startTransfer
+//Load the transfer into the ISR state and send the
+//address with a start condition.  Called with
+//interrupts disabled, from I2C_submit or the ISR.
+//Starts with the write phase, or the read phase if
+//there is no memory address and nothing to write.
+//Returns 0 if the bus is stuck busy, even after a
+//recovery, 1 if the transfer started.
+static uint8_t I2C_startTransfer(I2C_Transfer_t *far xfer)
+{
+	uint8_t address = xfer->address & 0xFE;		//clear bit 0 for write
+
+	I2C_PREFIX_LENGTH = xfer->memoryAddressSize;
+	I2C_TX_PTR = xfer->txData;
+	I2C_TX_LENGTH = xfer->txLength + xfer->memoryAddressSize;
+	I2C_TX_COUNTER = 0x00;
+	I2C_RX_PTR = xfer->rxData;
+	I2C_RX_LENGTH = xfer->rxLength;
+	I2C_RX_COUNTER = 0x00;
+	I2C_STEP = IIC_HEADER_SENT_STATUS;
+
+	if ((I2C_TX_LENGTH == 0) && (I2C_RX_LENGTH > 0))
 	{
-		I2C_TX_DATA[count++] = (memoryAddress & 0xFF);
+		I2C_DATA_DIRECTION = 0;
+		address |= 0x01;		//set as read
 	}
-	else if (addressSize == 2)
+	else
 	{
-		I2C_TX_DATA[count++] = (memoryAddress >> 8) & 0xFF;
-		I2C_TX_DATA[count++] = (memoryAddress & 0xFF);
+		I2C_DATA_DIRECTION = 1;
 	}
-	
-	//copy the data bytes into I2C_TX_DATA
-	for (dummy = 0 ; dummy < bytes ; dummy++)
-		I2C_TX_DATA[count++] = data[dummy];
-	
-	I2C_TX_LENGTH = (bytes + addressSize);
-	I2C_TX_COUNTER = 0x00;
-	I2C_STEP = IIC_HEADER_SENT_STATUS;
-	I2C_DATA_DIRECTION = 1;
-	
-	address &= 0xFE;		//clear bit 0 for write
-	
-	IICC_IICEN = 0;
-	IICC_IICEN = 1;
-	
-	dummy = IICS;		//clear any interrupt	
+
+	(void)IICS;				//clear any interrupt
 	IICS_IICIF = 1;
-	
-	IICC_MST = 0;		//slave
-	IICS_SRW = 0;
-	IICC_TX = 1;		//transmitter
-	IICC_MST = 1;		//generate start condition
-	
-	//wait a bit
-	for (dummy = 0 ; dummy < 5 ; dummy++);
-	
-	IICD = address;		//send the first byte - address
 
-	//wait until it returns either an error or a ready state
-	//Should add a counter here, a timeout, etc.
-	while (I2C_STEP > IIC_READY_STATUS){};
-	
-	return I2C_STEP;
+	//the stop from the last transfer may still
+	//be on the bus, a few scl periods at most
+	if (!I2C_waitBusFree())
+	{
+		I2C_recoverBus();
+		if (!I2C_waitBusFree())
+			return 0;
+	}
+
+	I2C_PHASE_TICK = (uint16_t)RTC_getTimeTick();
+
+	IICC1_TXAK = 0x00;		//ack each byte received
+	IICC_TX = 1;			//transmitter to send the address
+	IICC_MST = 1;			//generate start condition
+
+	IICD = address;			//send the address, starting the interrupt sequence
+
+	return 1;
 }
 
 
+/////////////////////////////////////////////////////////
+//I2C_completeTransfer
+//Called from the ISR when the transfer on the bus is
+//done.  Set the status and start the next one.  The
+//stop condition has already been generated.  If the
+//bus can't be freed the rest of the queue fails too,
+//in a loop so the stack doesn't grow with the queue.
+static void I2C_completeTransfer(uint8_t status)
+{
+	I2C_Transfer_t *far xfer = I2C_CURRENT;
 
+	I2C_CURRENT = xfer->next;
+	xfer->status = status;
 
+	while (I2C_CURRENT != NULL)
+	{
+		if (I2C_startTransfer(I2C_CURRENT))
+			return;
+
+		xfer = I2C_CURRENT;
+		I2C_CURRENT = xfer->next;
+		xfer->status = IIC_ERROR_STATUS;
+	}
 
-///////////////////////////////////////////////
+	I2C_STEP = status;
+	Power_clearActive(POWER_PERIPH_IIC);
+}
+
+
+/////////////////////////////////////////////////////////
+//I2C_waitBusFree
+//Bounded wait for the bus busy flag to clear.  Returns
+//1 if the bus is free, 0 after I2C_BUSY_SPIN_MAX passes.
+static uint8_t I2C_waitBusFree(void)
+{
+	uint16_t i = 0x00;
+
+	for (i = 0 ; i < I2C_BUSY_SPIN_MAX ; i++)
+	{
+		if (!IICS_BUSY)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/////////////////////////////////////////////////////////
+//I2C_checkTimeout
+//Called with interrupts disabled.  If the transfer on
+//the bus has not made progress for I2C_TIMEOUT_TICKS,
+//stop it, recover the bus and fail it, which starts
+//the next one in the queue.
+static void I2C_checkTimeout(void)
+{
+	if (I2C_CURRENT == NULL)
+		return;
+
+	if ((uint16_t)((uint16_t)RTC_getTimeTick() - I2C_PHASE_TICK) < I2C_TIMEOUT_TICKS)
+		return;
+
+	I2C_TIMEOUTS++;
+
+	IICC_MST = 0;				//try a stop first
+	I2C_recoverBus();
+	I2C_completeTransfer(IIC_ERROR_STATUS);
+}
+
+
+/////////////////////////////////////////////////////////
+//I2C_recoverBus
+//A slave that lost a clock in the middle of a byte
+//holds SDA low until it sees the rest of the byte.
+//With the module off, PA2 (SDA) and PA3 (SCL) are
+//GPIO.  The pins are only ever driven low - released
+//by making them inputs, the pull ups take them high.
+//Clock SCL up to I2C_RECOVER_PULSES times until SDA
+//is released, then generate a stop (SDA low to high
+//with SCL high).  Bounded, no waits on the pins.
+//Called with interrupts disabled, or from the ISR.
+void I2C_recoverBus(void)
+{
+	uint8_t i = 0x00;
+
+	IICC1_IICEN = 0;			//pins back to GPIO
+
+	PTAD_PTAD2 = 0;				//low when driven
+	PTAD_PTAD3 = 0;
+	PTADD_PTADD2 = 0;			//release SDA
+	PTADD_PTADD3 = 0;			//release SCL
+	I2C_recoverDelay();
+
+	for (i = 0 ; i < I2C_RECOVER_PULSES ; i++)
+	{
+		if (PTAD_PTAD2)			//SDA released
+			break;
+
+		PTADD_PTADD3 = 1;		//SCL low
+		I2C_recoverDelay();
+		PTADD_PTADD3 = 0;		//SCL high
+		I2C_recoverDelay();
+	}
+
+	//stop condition
+	PTADD_PTADD3 = 1;			//SCL low
+	I2C_recoverDelay();
+	PTADD_PTADD2 = 1;			//SDA low
+	I2C_recoverDelay();
+	PTADD_PTADD3 = 0;			//SCL high
+	I2C_recoverDelay();
+	PTADD_PTADD2 = 0;			//SDA high - stop
+	I2C_recoverDelay();
+
+	I2C_RECOVERIES++;
+
+	//module back on, IICF and IICIE are kept
+	IICC1_IICEN = 1;
+	IICC_MST = 0;
+}
+
+
+/////////////////////////////////////////////////////////
+//Half SCL period for the bus recovery
+static void I2C_recoverDelay(void)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < I2C_RECOVER_DELAY ; i++){};
+}
+
+
+/////////////////////////////////////////////////////////
+//Number of transfers failed by a timeout, and bus
+//recoveries (timeouts and a stuck busy flag)
+uint16_t I2C_getTimeouts(void)
+{
+	uint16_t result = 0x00;
+
+	DisableInterrupts;
+	result = I2C_TIMEOUTS;
+	EnableInterrupts;
+
+	return result;
+}
+
+
+uint16_t I2C_getRecoveries(void)
+{
+	uint16_t result = 0x00;
+
+	DisableInterrupts;
+	result = I2C_RECOVERIES;
+	EnableInterrupts;
+
+	return result;
+}
+
+
+
+
+
+////////////////////////////////////////////////////
 //I2C Interrupt Service Routine
 //Master mode transmitter and receiver
 //The ISR generally follows the peripheral guide.
 //
+//Note on Master Receiver:
+//IICD register reads generate the read cycle, but
+//the data is available to read on the following cycle.
+//The first read only starts the cycle and is thrown
+//away, so byte n is stored at I2C_RX_PTR[n - 1].
+//To get the last byte out, a final read occurs on
+//the stop condition phase with the IICC_TX bit set
+//high to avoid another read cycle.
+//
 void I2C_interruptHandler(void)
 {
 	unsigned char temp;
@@ -367,19 +683,22 @@ void I2C_interruptHandler(void)
 	{
 		IICS_ARBL= 1;					//clear the flag
 		IICC_MST = 0;					//generate the stop condition
-		I2C_STEP = IIC_ERROR_STATUS;	//update the status
+		I2C_completeTransfer(IIC_ERROR_STATUS);
 		return;
 	}
 
 	if(IICC_MST==1)		
 	{
+		//progress on the bus, restart the phase timeout
+		I2C_PHASE_TICK = (uint16_t)RTC_getTimeTick();
+
 		//if not ack and device is transmitter, return error
 		//previously, it was both rx and tx, which is not right
 		//for some i2c devices
 		if((IICS_RXAK==1) && (IICC1_TX == 1))
 		{
 			IICC_MST = 0;					//generate the stop condition
-			I2C_STEP = IIC_ERROR_STATUS;	//update the status
+			I2C_completeTransfer(IIC_ERROR_STATUS);
 			return;
 		}
 
@@ -390,6 +709,10 @@ void I2C_interruptHandler(void)
 		{
 			IICC_TX = I2C_DATA_DIRECTION;				//set the direction
 			I2C_STEP = IIC_DATA_TRANSMISION_STATUS; 	//update the status
+
+			//address only (I2C_probe) - nothing to send, stop
+			if ((I2C_DATA_DIRECTION == 1) && (I2C_TX_LENGTH == 0))
+				I2C_STEP = IIC_DATA_SENT_STATUS;
 		}
 
 		//////////////////////////////////////////////////////
@@ -402,7 +725,20 @@ void I2C_interruptHandler(void)
 			//Transmitter
 			if(IICC_TX==1)
 			{
-				IICD = I2C_TX_DATA[I2C_TX_COUNTER];		//send the data
+				//memory address first, MSB first, then the
+				//data straight from the caller's buffer
+				if (I2C_TX_COUNTER < I2C_PREFIX_LENGTH)
+				{
+					if ((I2C_PREFIX_LENGTH - I2C_TX_COUNTER) == 2)
+						IICD = (uint8_t)(I2C_CURRENT->memoryAddress >> 8);
+					else
+						IICD = (uint8_t)(I2C_CURRENT->memoryAddress & 0xFF);
+				}
+				else
+				{
+					IICD = I2C_TX_PTR[I2C_TX_COUNTER - I2C_PREFIX_LENGTH];
+				}
+
 				I2C_TX_COUNTER++;						//increment the counter
 
 				//Last Byte?  The next interrupt will be generated
@@ -416,17 +752,28 @@ void I2C_interruptHandler(void)
 				return;
 			}
 
-			///////////////////////////////////////////////////
+			///////////////////////////////////////////////////////////////
 			//Receiver - master reads data from the slave.
 			//The ack bit is pulled low by the master receiver
-			//for all bytes except the last one.
+			//for all bytes except the last one.  Note: reading the IICD
+			//register initiates the read cycle and stores the previous byte
+			//read.  If you want to read the IICD without generating a read,
+			//flip the IICC_TX bit high to put into write mode, read the register,
+			//then flip it back. The scope will show the correct values are being
+			//read back, but the data is not available until the next read.  This
+			//puts the I2C_RX_PTR result array off by 1, the last byte read during
+			//the stop condition phase of the transfer.
+			//
 			else
 			{
 				//read only 1 byte
 				if (I2C_RX_LENGTH == 1)
 				{
 					IICC_TXAK = 1;						//master drives ack bit high
-					I2C_RX_DATA[I2C_RX_COUNTER] = IICD;	//read the data into rx data				
+					
+					//for one byte, this will read back the address 
+					//read this again on the final step with tx bit high
+					temp = IICD;						//dummy read, starts the cycle
 					I2C_RX_COUNTER++;					//increment the counter					
 					I2C_STEP=IIC_DATA_SENT_STATUS;		//update the status- - all data sent
 				}
@@ -446,8 +793,11 @@ void I2C_interruptHandler(void)
 					//sets the ack bit high
 					if((I2C_RX_COUNTER+1) == I2C_RX_LENGTH)
 						IICC_TXAK = 1;
-					
-					I2C_RX_DATA[I2C_RX_COUNTER] = IICD;		//read the data       	         	 
+				
+					//first read is a dummy, data is one behind
+					temp = IICD;							//read the data
+					if (I2C_RX_COUNTER)
+						I2C_RX_PTR[I2C_RX_COUNTER - 1] = temp;
 					I2C_RX_COUNTER++;						//increment the counter
 
 					//update the status to complete
@@ -459,25 +809,62 @@ void I2C_interruptHandler(void)
 			}
 		}
 	
+		///////////////////////////////////////////////////
+		//I2C Status - Tx complete with a read to follow
+		//Switch to the read phase with a repeated start, or
+		//a stop and a new start, and send the address again
+		//with the read bit set.
+		if((I2C_STEP==IIC_DATA_SENT_STATUS) && (I2C_DATA_DIRECTION == 1) && (I2C_RX_LENGTH > 0))
+		{
+			I2C_DATA_DIRECTION = 0;
+			I2C_STEP = IIC_HEADER_SENT_STATUS;
+			
+			if (I2C_CURRENT->flags & I2C_FLAG_RESTART)
+			{
+				IICC_RSTA = 1;				//generate the restart
+			}
+			else
+			{
+				IICC_MST = 0;				//generate the stop condition
+				if (!I2C_waitBusFree())
+				{
+					I2C_recoverBus();
+					I2C_completeTransfer(IIC_ERROR_STATUS);
+					return;
+				}
+				IICC_MST = 1;				//generate start condition
+			}
+			
+			IICD = I2C_CURRENT->address | 0x01;
+			return;
+		}
+
 		///////////////////////////////////////////////////
 		//I2C Status - Tx / Rx complete, return to ready state
-		//Generate the stop condition
+		//Generate the stop condition, then start the next
+		//transfer in the queue
 		if(I2C_STEP==IIC_DATA_SENT_STATUS)
 		{
-			I2C_STEP=IIC_READY_STATUS;		//I2C Ready state
 			temp = IICS;					//Clear the interrupt
 			IICS_IICIF=1;
-	
+
 			IICC_TX=0;
 			IICS_SRW=0;
+			IICC_MST=0;						//generate the stop condition
+
+			//store last byte read if i2c was receiving mode
+			//IICC_TX bit high to avoid another read cycle.
+			if (I2C_DATA_DIRECTION == 0)
+			{
+				IICC_TX = 1;
+				I2C_RX_PTR[I2C_RX_COUNTER - 1] = IICD;
+				IICC_TX = 0;
+			}
 			
-			//generate the stop condition if the flag is not set
-			if (I2C_NO_STOP_FLAG == 0)		
-				IICC_MST=0;
-			
+			I2C_completeTransfer(IIC_READY_STATUS);
 			return;
-		}		
-	}	
+		}
+	}
 }
 
 
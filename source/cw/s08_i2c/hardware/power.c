@@ -0,0 +1,199 @@
+/*
+ * power.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Low power wait primitives.  See power.h
+ *
+ * Registers:
+ * SOPT1_STOPE - stop instruction enable, write once
+ * SPMSC1_LVDSE - LVD enabled in stop - off saves current
+ * SPMSC2_PPDC - partial power down control, 0 = STOP3
+ * RTCSC_RTCLKS - RTC clock source, 00 = 1khz LPO
+ *
+ */
+
+#include <hidef.h> /* for EnableInterrupts macro */
+#include "derivative.h" /* include peripheral declarations */
+#include "mc9s08qe8.h"
+#include <stddef.h>
+#include "config.h"
+#include "power.h"
+#include "rtc.h"
+
+
+/////////////////////////////////////////////
+//Power Variables
+//mActive - bit mask of POWER_PERIPH_xx that are
+//currently using the bus clock.
+static volatile uint8_t mActive = 0x00;
+
+#if INSTRUMENT
+//mStartTick - RTC tick of the last clear
+//mResidency - RTC ticks spent in WAIT and STOP3.
+//RUN is last in Power_Mode_t and not kept, it is
+//the rest of the time since the clear
+#pragma DATA_SEG __FAR_SEG FAR_RAM
+static unsigned long mStartTick = 0x00;
+static unsigned long mResidency[POWER_MODE_RUN] = {0x00};
+#pragma DATA_SEG DEFAULT
+#endif
+
+
+///////////////////////////////////////////
+//Power_init
+//Configure the stop mode as STOP3 and reset the
+//residency counters.  Call after RTC_init_xx with
+//interrupts disabled.
+void Power_init(void)
+{
+	mActive = 0x00;
+
+	SPMSC1_LVDSE = 0;		//LVD off in stop mode
+	SPMSC2_PPDC = 0;		//STOP3, keep RAM and registers
+
+#if INSTRUMENT
+	mResidency[POWER_MODE_WAIT] = 0x00;
+	mResidency[POWER_MODE_STOP3] = 0x00;
+	mStartTick = RTC_getTimeTick();
+#endif
+}
+
+
+/////////////////////////////////////////////
+//Mark a peripheral as active / inactive.
+//Drivers call this around anything that needs
+//the bus clock to keep running.  ISRs change the
+//mask too (IIC, SCI), call with interrupts off.
+void Power_setActive(uint8_t periph)
+{
+	mActive |= periph;
+}
+
+void Power_clearActive(uint8_t periph)
+{
+	mActive &=~ periph;
+}
+
+uint8_t Power_getActive(void)
+{
+	return mActive;
+}
+
+
+//////////////////////////////////////////////
+//Power_selectMode
+//Returns the deepest mode that is safe right now.
+//STOP3 requires:
+//- stop enabled in SOPT1
+//- no peripheral flagged as active
+//- the RTC running from the 1khz LPO, since the
+//external clock is stopped in STOP3 and the RTC
+//is the only thing that brings us back on time.
+//- no PWM output running (sound playing)
+//- the internal reference, or the bus straight off
+//the xtal (FBE / FBELP) with EREFSTEN set.  The xtal
+//stops in STOP3 otherwise and takes ms to restart,
+//and FEE has to relock the FLL on it after.
+//Otherwise WAIT, which keeps the bus clock running.
+//A pending SCI receive is in mActive, see uart.c.
+Power_Mode_t Power_selectMode(void)
+{
+	if (!SOPT1_STOPE)
+		return POWER_MODE_WAIT;
+
+	if (mActive)
+		return POWER_MODE_WAIT;
+
+	if (RTCSC_RTCLKS)
+		return POWER_MODE_WAIT;
+
+	if (TPM1SC_CLKSA || TPM1SC_CLKSB)
+		return POWER_MODE_WAIT;
+
+	if (!ICSC1_IREFS && !(ICSC1_CLKS1 && ICSC2_ERCLKEN && ICSC2_EREFSTEN))
+		return POWER_MODE_WAIT;
+
+	return POWER_MODE_STOP3;
+}
+
+
+/////////////////////////////////////////////////
+//Power_sleep
+//Enter the mode selected by the policy and return
+//after an interrupt has been serviced.  Call with
+//interrupts disabled, returns with interrupts
+//disabled.  The WAIT and STOP instructions clear
+//the I bit, so a pending interrupt wakes the core
+//right away.  With INSTRUMENT the time asleep is
+//added to the residency counter for that mode in
+//RTC ticks.
+void Power_sleep(void)
+{
+	Power_Mode_t mode = Power_selectMode();
+#if INSTRUMENT
+	unsigned long start = RTC_getTimeTick();
+#endif
+
+	if (mode == POWER_MODE_STOP3)
+	{
+		__asm STOP;
+	}
+	else
+	{
+		__asm WAIT;
+	}
+
+	DisableInterrupts;
+#if INSTRUMENT
+	mResidency[mode] += (RTC_getTimeTick() - start);
+#endif
+}
+
+
+#if INSTRUMENT
+/////////////////////////////////////////////////
+//Returns the number of RTC ticks spent in a mode
+//since the last clear.  RUN is whatever is left.
+//Call with interrupts enabled.
+unsigned long Power_getResidency(Power_Mode_t mode)
+{
+	unsigned long total = 0x00;
+	unsigned long result = 0x00;
+
+	DisableInterrupts;
+	total = RTC_getTimeTick() - mStartTick;
+
+	switch(mode)
+	{
+		case POWER_MODE_WAIT:
+		case POWER_MODE_STOP3:
+			result = mResidency[mode];
+			break;
+		case POWER_MODE_RUN:
+			result = total - mResidency[POWER_MODE_WAIT]
+					- mResidency[POWER_MODE_STOP3];
+			break;
+		default:
+			result = 0x00;
+			break;
+	}
+	EnableInterrupts;
+
+	return result;
+}
+
+
+/////////////////////////////////////////////////
+//Reset the residency counters, interrupts enabled
+void Power_clearResidency(void)
+{
+	DisableInterrupts;
+	mResidency[POWER_MODE_WAIT] = 0x00;
+	mResidency[POWER_MODE_STOP3] = 0x00;
+	mStartTick = RTC_getTimeTick();
+	EnableInterrupts;
+}
+#endif
+
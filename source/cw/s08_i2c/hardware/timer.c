@@ -0,0 +1,64 @@
+/*
+ * timer.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Free running timer on TPM2.  See timer.h
+ *
+ */
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "timer.h"
+
+#if INSTRUMENT
+
+///////////////////////////////////////////
+//Timer_init
+//TPM2 free running, no interrupts, no channels.
+//Clock source = fixed system clock, prescale 1,
+//modulus 0 so the counter runs the full 16 bits.
+void Timer_init(void)
+{
+	//TPM2SC - status and control register
+	TPM2SC_TOIE = 0;		//no interrupt
+	TPM2SC_CPWMS = 0;		//up counting
+
+	//prescaler bits - 000 = prescale = 1
+	TPM2SC_PS2 = 0;
+	TPM2SC_PS1 = 0;
+	TPM2SC_PS0 = 0;
+
+	//modulo = 0 - free running
+	TPM2MOD = 0x0000;
+
+	//counter register - any write clears it
+	TPM2CNT = 0x0000;
+
+	//clock source - 10 - fixed system clock
+	TPM2SC_CLKSB = 1;
+	TPM2SC_CLKSA = 0;
+}
+
+
+///////////////////////////////////////////
+//Returns the current counter value.  Reading
+//the high byte latches the low byte, the word
+//read keeps them together.
+uint16_t Timer_getCount(void)
+{
+	return TPM2CNT;
+}
+
+
+///////////////////////////////////////////
+//Returns the number of counts since start.
+//Unsigned math handles the roll over.
+uint16_t Timer_elapsed(uint16_t start)
+{
+	return (uint16_t)(TPM2CNT - start);
+}
+
+#endif
@@ -9,6 +9,7 @@
  * The board uses the following peripherals:
  * RTC - use internal 1000hz clock for timeout
  * Bus clock - use the external 16mhz xtal. - PB6 and PB7
+ * I2C - shared driver, same as s08_gameBoard, see i2c.h
  * 
  * PA0 - user button
  * PA2 and PA3 - I2C (remove R2 and R3 - LEDs red and green)
@@ -26,11 +27,14 @@
 #include "main.h"
 #include "rtc.h"
 #include "clock.h"
+#include "power.h"
+#include "sched.h"
 #include "i2c.h"
 
 
 void System_init(void);
 void GPIO_init(void);
+void Task_read(void);
 //void LED_toggleBlue(void);
 //void LED_toggleOrange(void);
 
@@ -39,6 +43,18 @@ uint8_t status = 0x00;
 uint8_t tx[4] = {0x00};
 uint8_t rx[16] = {0x00};
 
+////////////////////////////////////////////
+//Task table - RTC at 1000hz, 1ms per tick
+#define READ_TICKS		100
+
+static const Sched_Task_t taskTable[] =
+{
+	//task				period		offset	priority
+	{Task_read,			READ_TICKS,	0,		0},
+};
+
+#define NUM_TASKS		(sizeof(taskTable) / sizeof(Sched_Task_t))
+
 void main(void)
 {
 	DisableInterrupts;
@@ -46,58 +62,67 @@ void main(void)
 	//Configure the hardware
 	System_init();
 	GPIO_init();
-	Clock_init();							//16mhz bus clock
+	Clock_init();							//16mhz xtal, 8mhz bus clock
 	RTC_init_internal(RTC_FREQ_1000HZ);		//rtc runs on the internal 1000hz
 //	RTC_init_external();					//rtc runs on the external bus clock
+	Power_init();							//sleep between interrupts
 	I2C_init();
+	Sched_init(taskTable, NUM_TASKS);
 	
 	EnableInterrupts;
 	
 	while(1)
 	{
-		LED_toggleOrange();
+		Sched_run();
+		I2C_poll();					//i2c timeouts
+	}
+}
 
-		/*
-		//load the array
-		tx[0] = 0x81;
-		tx[1] = counter++;
-		tx[2] = 0x81;		
-		
-		status = I2C_writeData(I2C_ADDRESS, tx, 3);
-		
-		if (status == IIC_READY_STATUS)
-			LED_toggleBlue();
-		
-		//light sensor - command, data
-		//1110 0000  0x03 - 
-	*/
-//		status = I2C_readData(I2C_ADDRESS, rx, 1);
 
-//		uint8_t I2C_writeReadData(uint8_t address, uint8_t far* txData, uint8_t txBytes, uint8_t far* rxData, uint8_t rxBytes)
+////////////////////////////////////////////
+//Task_read
+//Read the light sensor every READ_TICKS, toggle
+//blue on an error.  The blocking read sleeps until
+//the transfer is done.
+void Task_read(void)
+{
+	LED_toggleOrange();
 
-		
-		//try a block read starting at address 0
-		// 1101 0000 = 0xD0, 1
-		tx[0] = 0xCA;
-		
-		//single byte read at address 0x0A - returns 0x50
-		//1100 1010
+	/*
+	//load the array
+	tx[0] = 0x81;
+	tx[1] = counter++;
+	tx[2] = 0x81;		
+	
+	status = I2C_writeData(I2C_ADDRESS, tx, 3);
+	
+	if (status == IIC_READY_STATUS)
+		LED_toggleBlue();
+	
+	//light sensor - command, data
+	//1110 0000  0x03 - 
+*/
+//		status = I2C_readData(I2C_ADDRESS, rx, 1);
+
+	
+	//try a block read starting at address 0
+	// 1101 0000 = 0xD0, 1
+	tx[0] = 0xCA;
+	
+	//single byte read at address 0x0A - returns 0x50
+	//1100 1010
 //		tx[0] = 0x81;
-		tx[1] = 0xAA;
-		tx[2] = 0xAA;
-				
-		//TODO: Fix the counts...
-//		status = I2C_writeReadData(I2C_ADDRESS, tx, 1, rx, 7);
-		status = I2C_memoryRead(I2C_ADDRESS, 0xCA, 1, rx, 1);
-
-//		status = I2C_memoryWrite(I2C_ADDRESS, 0xCA, 1, tx, 1);
-		
+	tx[1] = 0xAA;
+	tx[2] = 0xAA;
+			
+//		status = I2C_memoryReadArray(LIGHT_ADDRESS, 0xD0, 1, rx, 7);
+	status = I2C_memoryReadArray(LIGHT_ADDRESS, 0xCA, 1, rx, 1);
 
-		if (status == IIC_ERROR_STATUS)
-			LED_toggleBlue();
+//		status = I2C_memoryWriteArray(LIGHT_ADDRESS, 0xCA, 1, &tx[1], 1);
+	
 
-		RTC_delay(100);
-	}
+	if (status == IIC_ERROR_STATUS)
+		LED_toggleBlue();
 }
 
 
@@ -8,6 +8,8 @@
 #ifndef MAIN_H_
 #define MAIN_H_
 
+//I2C Address for the light sensor, 7bit address 0x39
+#define LIGHT_ADDRESS			(0x39 << 1)
 
 void LED_toggleBlue(void);
 void LED_toggleOrange(void);
@@ -22,6 +22,20 @@
  * Vrefh = Vdda = 000 11101
  * 
  * Hardware trigger - use the RTC clock to trigger the ADC using the trigger bit
+ * ADC_startTriggered sets ADTRG and runs the RTC from the
+ * internal reference at the sample rate, results go in
+ * the same ring as continuous conversion.  See adc.h
+ * 
+ * Continuous conversion - ADCO and AIEN set, every
+ * result is pushed into a ring by the ISR and drained
+ * in bulk with ADC_readBuffer.  When the ring is full
+ * the new result is dropped and counted as an
+ * overrun.  Don't call ADC_read while it runs.
+ * 
+ * Scan - ADC_startScan chains single conversions of a
+ * channel list from the ISR, with a bandgap
+ * calibration every few passes, into a table read
+ * with ADC_getSnapshot.  See adc.h
  * 
  * Temperature sensor: Temp = 25 - ((Vtemp - Vtemp25) / m) - See Section 10.1.2.6
  * 
@@ -38,12 +52,155 @@
  *      
  */
 
+#include <hidef.h> /* for EnableInterrupts macro */
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
 #include "adc.h"
 
 
+/////////////////////////////////////////////////////
+//Ring Variables
+//mAdcHead - next slot the ISR writes
+//mAdcTail - next slot ADC_readBuffer reads
+//mAdcOverruns - results dropped, ring full
+static uint16_t mAdcRing[ADC_RING_SIZE] = {0x00};
+static volatile uint8_t mAdcHead = 0x00;
+static volatile uint8_t mAdcTail = 0x00;
+static volatile uint16_t mAdcOverruns = 0x00;
+
+/////////////////////////////////////////////////////
+//Trigger Variables
+//mAdcTriggered - the ISR stamps results with TPM2
+//mAdcStamped - mAdcStamp holds the last stamp
+//mAdcPeriodUs - trigger period, low 16 bits, the
+//interval math is modulo 65536 like the counter
+//mAdcJitter - intervals and min / max deviation
+//mRtcSC / mRtcMod - RTC setup to put back on stop,
+//for the trigger and the monitor
+static volatile uint8_t mAdcTriggered = 0x00;
+static uint8_t mAdcStamped = 0x00;
+static uint16_t mAdcStamp = 0x00;
+static uint16_t mAdcPeriodUs = 0x00;
+static ADC_Jitter_t mAdcJitter = {0x00};
+static uint8_t mRtcSC = 0x00;
+static uint8_t mRtcMod = 0x00;
+
+//RTCPS values for the IRCLK prescales, finest first,
+//see Table 13-2, and the divide they give
+#define ADC_TRIG_PRESCALES			4
+static const uint8_t mTrigPrescale[ADC_TRIG_PRESCALES] = {0x08, 0x0C, 0x0D, 0x0F};
+static const uint16_t mTrigDivide[ADC_TRIG_PRESCALES] = {1, 16, 100, 1000};
+
+/////////////////////////////////////////////////////
+//Scan Variables
+//mAdcScanning - the ISR runs the sequencer
+//mScanList / mScanCount - channels, list order
+//mScanIndex - conversion running, list index, then
+//mScanCount for the bandgap
+//mScanWork - the pass being converted
+//mScanLatest - the last complete pass
+//mScanPasses - complete passes
+//mScanCalCountdown - passes to the next calibration
+//mCalBandgap - last calibration, also used by
+//ADC_readMv
+//mCalScale - the correction for it, Q12, see adc.h
+static volatile uint8_t mAdcScanning = 0x00;
+static uint8_t mScanList[ADC_SCAN_MAX] = {0x00};
+static uint8_t mScanCount = 0x00;
+static uint8_t mScanIndex = 0x00;
+static uint16_t mScanWork[ADC_SCAN_MAX] = {0x00};
+static uint16_t mScanLatest[ADC_SCAN_MAX] = {0x00};
+static uint16_t mScanPasses = 0x00;
+static uint8_t mScanCalCountdown = 0x00;
+
+/////////////////////////////////////////////////////
+//Monitor Variables
+//mAdcMonitoring - the ISR runs the alarm
+//mMonThreshold / mMonDirection / mMonHysteresis -
+//as passed to ADC_startMonitor
+//mMonStats - alarm, wakes, last result
+static volatile uint8_t mAdcMonitoring = 0x00;
+static uint16_t mMonThreshold = 0x00;
+static uint8_t mMonDirection = 0x00;
+static uint16_t mMonHysteresis = 0x00;
+static ADC_MonitorStats_t mMonStats = {0x00};
+
+//RTCPS values for the LPO prescales, finest first,
+//see Table 13-2, and the ms per count they give
+#define ADC_MON_PRESCALES			4
+static const uint8_t mMonPrescale[ADC_MON_PRESCALES] = {0x08, 0x0B, 0x0D, 0x0F};
+static const uint16_t mMonDivide[ADC_MON_PRESCALES] = {1, 10, 100, 1000};
+static uint16_t mCalBandgap = 0x00;
+static uint16_t mCalScale = 0x00;
+
+
+/////////////////////////////////////////////////////
+//Conversion Tables
+//Built by the compiler from adc.h, nothing is
+//computed at run time but the interpolation.
+//
+//mMvTable - mv at every ADC_MV_TABLE_STEP counts,
+//entry i is i * STEP * VREFH / 0xFFF.  One extra
+//entry past full scale so 0xFFF interpolates.
+//
+//mTempTableC / F - 10th's of a degree at every
+//ADC_TEMP_TABLE_STEP codes over the sensor range,
+//Eq 10.1 in the datasheet with uV to keep the
+//precision:
+//  C = 25 - (Vtemp - Vtemp25) / m
+//m is the cold slope above Vtemp25, the hot one
+//below.  F = C * 9 / 5 + 32.
+#define ADC_MV_TABLE_SHIFT			7
+#define ADC_MV_TABLE_STEP			(1 << ADC_MV_TABLE_SHIFT)
+#define ADC_MV(i)					(uint16_t)(((unsigned long)(i) * ADC_MV_TABLE_STEP * ADC_VREFH) / ADC_FULL_SCALE)
+
+#define ADC_TEMP_UV(code)			((long)(((unsigned long)(code) * (ADC_VREFH * 1000UL)) / ADC_FULL_SCALE))
+#define ADC_TEMP_SLOPE(code)		((ADC_TEMP_UV(code) > ADC_TEMP25_MV) ? ADC_TEMP_SLOPE_UNDER25 : ADC_TEMP_SLOPE_OVER25)
+#define ADC_TEMP_C10(code)			(250L - (((ADC_TEMP_UV(code) - ADC_TEMP25_MV) * 10L) / ADC_TEMP_SLOPE(code)))
+#define ADC_TEMP_F10(code)			((ADC_TEMP_C10(code) * 9L) / 5L + 320L)
+#define ADC_TEMP_CODE(i)			(ADC_TEMP_TABLE_START + ((i) << ADC_TEMP_TABLE_SHIFT))
+#define ADC_TEMP_C(i)				(int16_t)ADC_TEMP_C10(ADC_TEMP_CODE(i))
+#define ADC_TEMP_F(i)				(int16_t)ADC_TEMP_F10(ADC_TEMP_CODE(i))
+
+static const uint16_t mMvTable[(ADC_FULL_SCALE >> ADC_MV_TABLE_SHIFT) + 2] =
+{
+	ADC_MV(0),	ADC_MV(1),	ADC_MV(2),	ADC_MV(3),	ADC_MV(4),	ADC_MV(5),	ADC_MV(6),	ADC_MV(7),
+	ADC_MV(8),	ADC_MV(9),	ADC_MV(10),	ADC_MV(11),	ADC_MV(12),	ADC_MV(13),	ADC_MV(14),	ADC_MV(15),
+	ADC_MV(16),	ADC_MV(17),	ADC_MV(18),	ADC_MV(19),	ADC_MV(20),	ADC_MV(21),	ADC_MV(22),	ADC_MV(23),
+	ADC_MV(24),	ADC_MV(25),	ADC_MV(26),	ADC_MV(27),	ADC_MV(28),	ADC_MV(29),	ADC_MV(30),	ADC_MV(31),
+	ADC_MV(32)
+};
+
+static const int16_t mTempTableC[ADC_TEMP_TABLE_SIZE] =
+{
+	ADC_TEMP_C(0),	ADC_TEMP_C(1),	ADC_TEMP_C(2),	ADC_TEMP_C(3),	ADC_TEMP_C(4),
+	ADC_TEMP_C(5),	ADC_TEMP_C(6),	ADC_TEMP_C(7),	ADC_TEMP_C(8),	ADC_TEMP_C(9),
+	ADC_TEMP_C(10),	ADC_TEMP_C(11),	ADC_TEMP_C(12),	ADC_TEMP_C(13),	ADC_TEMP_C(14),
+	ADC_TEMP_C(15),	ADC_TEMP_C(16),	ADC_TEMP_C(17),	ADC_TEMP_C(18),	ADC_TEMP_C(19),
+	ADC_TEMP_C(20),	ADC_TEMP_C(21),	ADC_TEMP_C(22),	ADC_TEMP_C(23),	ADC_TEMP_C(24)
+};
+
+static const int16_t mTempTableF[ADC_TEMP_TABLE_SIZE] =
+{
+	ADC_TEMP_F(0),	ADC_TEMP_F(1),	ADC_TEMP_F(2),	ADC_TEMP_F(3),	ADC_TEMP_F(4),
+	ADC_TEMP_F(5),	ADC_TEMP_F(6),	ADC_TEMP_F(7),	ADC_TEMP_F(8),	ADC_TEMP_F(9),
+	ADC_TEMP_F(10),	ADC_TEMP_F(11),	ADC_TEMP_F(12),	ADC_TEMP_F(13),	ADC_TEMP_F(14),
+	ADC_TEMP_F(15),	ADC_TEMP_F(16),	ADC_TEMP_F(17),	ADC_TEMP_F(18),	ADC_TEMP_F(19),
+	ADC_TEMP_F(20),	ADC_TEMP_F(21),	ADC_TEMP_F(22),	ADC_TEMP_F(23),	ADC_TEMP_F(24)
+};
+
+
+static uint16_t ADC_calScale(uint16_t bandgap);
+static uint16_t ADC_correctWith(uint16_t raw, uint16_t scale);
+static void ADC_rtcTake(uint8_t rtcsc, uint8_t mod);
+static void ADC_rtcRestore(void);
+static void ADC_monitorArm(ADC_Direction_t direction, uint16_t value);
+static int16_t ADC_tempLookup(const int16_t *far table, uint16_t code);
+static void ADC_scanNext(uint16_t result);
+static void ADC_monitorFired(uint16_t result);
+
+
 /////////////////////////////////////////////////////
 //Configure ADC on channels 8 and 9, 12bit conversion
 //See Section 10 in the datasheet.
@@ -64,6 +221,13 @@ void ADC_init(void)
 	ADCSC1_ADCH3 = 0x01;	//channel bit 3
 	ADCSC1_ADCH4 = 0x01;	//channel bit 4
 
+	//no calibration until one is measured
+	mCalBandgap = ADC_CAL_NOMINAL;
+	mCalScale = ADC_CAL_ONE;
+	mAdcScanning = 0x00;
+	mAdcTriggered = 0x00;
+	mAdcMonitoring = 0x00;
+
 	//ADCSC2 - status and control register 2
 	ADCSC2_ADTRG = 0;		//software trigger
 	ADCSC2_ACFE = 0x00;		//compare function disabled
@@ -74,8 +238,8 @@ void ADC_init(void)
 	//clock divider bits - see Table 10-7
 	// 00 = input clock
 	// 11 = input clock / 8
-	ADCCFG_ADIV0 = 0x00;		//clock divider bit 0
-	ADCCFG_ADIV1 = 0x00;		//clock divider bit 1
+	//computed from the bus clock, see adc.h
+	ADCCFG_ADIV = ADC_ADIV(CLOCK_BUS_FREQ_HZ);
 	
 	ADCCFG_ADLSMP = 0x00;		//short sample time
 
@@ -135,57 +299,176 @@ uint16_t ADC_read(ADC_Channel_t channel)
 
 ////////////////////////////////////////////////////
 //Returns the number of millivolts read on a channel
-//Read the high reference to compute the mv
+//Corrected with the last calibration, see adc.h
 //
 uint16_t ADC_readMv(ADC_Channel_t channel)
 {
-	unsigned long raw = 0x00;
-	unsigned long mv = 0x00;
-	unsigned long vrefh = ADC_VREFH;
-	raw = ADC_read(channel);		//get raw reading	
-	mv = (raw * vrefh) / 0xFFF;		//compute mv
-	
-	return ((uint16_t)mv);
+	return ADC_countsToMv(ADC_correct(ADC_read(channel)));
+}
+
+
+////////////////////////////////////////////////////
+//Counts to mv, counts are a fraction of the nominal
+//ADC_VREFH, ADC_correct scales a reading to it.  The
+//entry below the counts plus the step to the next one
+//times the 7 bits of the counts below the step, an
+//8 x 8 MUL.  The line is straight so the only error
+//is the shift, under 1mv.
+uint16_t ADC_countsToMv(uint16_t counts)
+{
+	uint8_t index = 0x00;
+	uint8_t rise = 0x00;
+	uint8_t frac = 0x00;
+
+	if (counts > ADC_FULL_SCALE)
+		counts = ADC_FULL_SCALE;
+
+	index = (uint8_t)(counts >> ADC_MV_TABLE_SHIFT);
+	frac = (uint8_t)(counts & (ADC_MV_TABLE_STEP - 1));
+	rise = (uint8_t)(mMvTable[index + 1] - mMvTable[index]);
+
+	return mMvTable[index] + (((uint16_t)rise * frac) >> ADC_MV_TABLE_SHIFT);
+}
+
+
+////////////////////////////////////////////////////
+//ADC_calibrate
+//Measure the bandgap now, blocking, for ADC_readMv
+//when no scan is running to do it.  The first
+//conversion gives the buffer time to settle.
+void ADC_calibrate(void)
+{
+	uint16_t bandgap = 0x00;
+	uint16_t scale = 0x00;
+
+	SPMSC1_BGBE = 1;
+	(void)ADC_read(ADC_CHANNEL_BANDGAP);
+	bandgap = ADC_read(ADC_CHANNEL_BANDGAP);
+	SPMSC1_BGBE = 0;
+
+	if ((bandgap < ADC_CAL_MIN) || (bandgap > ADC_CAL_MAX))
+		return;
+
+	scale = ADC_calScale(bandgap);
+
+	DisableInterrupts;
+	mCalBandgap = bandgap;
+	mCalScale = scale;
+	EnableInterrupts;
+}
+
+
+////////////////////////////////////////////////////
+//Correct a reading with the last calibration, the
+//scale copied with interrupts off - a scan can
+//update it
+uint16_t ADC_correct(uint16_t raw)
+{
+	uint16_t scale = 0x00;
+
+	DisableInterrupts;
+	scale = mCalScale;
+	EnableInterrupts;
+
+	return ADC_correctWith(raw, scale);
+}
+
+
+////////////////////////////////////////////////////
+//ADC_calScale
+//ADC_CAL_NOMINAL / bandgap in Q12, the one divide,
+//done when a calibration is taken.  bandgap is
+//ADC_CAL_MIN - ADC_CAL_MAX so it fits 16 bits.
+static uint16_t ADC_calScale(uint16_t bandgap)
+{
+	if (bandgap == ADC_CAL_NOMINAL)
+		return ADC_CAL_ONE;
+
+	return (uint16_t)(((unsigned long)ADC_CAL_NOMINAL << ADC_CAL_SHIFT) / bandgap);
+}
+
+
+////////////////////////////////////////////////////
+//ADC_correctWith
+//value = raw * scale >> ADC_CAL_SHIFT, clamped to
+//0xFFF - a 16 x 16 multiply and a shift.  Scale 1.0
+//(no calibration) returns raw.
+static uint16_t ADC_correctWith(uint16_t raw, uint16_t scale)
+{
+	uint16_t value = 0x00;
+
+	if (scale == ADC_CAL_ONE)
+		return raw;
+
+	value = (uint16_t)(((unsigned long)raw * scale) >> ADC_CAL_SHIFT);
+
+	if (value > ADC_FULL_SCALE)
+		value = ADC_FULL_SCALE;
+
+	return value;
 }
 
 /////////////////////////////////////////////////////
 //Read the chip temp.  
-//Read the channel associated with the chip temp
-//compute the voltage and compare with T25
-//NOTE: scale everything into 1000's of mv
+//Read the channel associated with the chip temp,
+//correct it and look it up, see ADC_codeToTempC
+//result returned in 10th's of a deg F, ie, 25.6 deg = 256
+int16_t ADC_readTemp(void)
+{
+	return ADC_codeToTempF(ADC_correct(ADC_read(ADC_CHANNEL_TEMP_SENSOR)));
+}
 
-//#define ADC_TEMP25_MV				701200
-//#define ADC_TEMP_SLOPE_UNDER25		1646		//1.646 - slope of the mV/C curve
-//#define ADC_TEMP_SLOPE_OVER25		1769		//1.769 - slope of the mV/C curve
 
-//result returned in 10th's of a deg, ie, 25.6 deg = 256
-int16_t ADC_readTemp(void)
+//same in 10th's of a deg C
+int16_t ADC_readTempC(void)
 {
-	long raw = (long)ADC_readMv(ADC_CHANNEL_TEMP_SENSOR);
-	long slope = ADC_TEMP_SLOPE_UNDER25;
-	long temp = 0x00;
-	long cutoff = ADC_TEMP25_MV;
-	
-	raw = raw * 1000;
-	
-	//set the appropriate slope
-	if (raw > cutoff)
-		slope = ADC_TEMP_SLOPE_OVER25;
-
-	//compute the temp - Eq 10.1 in the datasheet
-	//temp = 25 - ((Vtemp - Vtemp25) / m)
-	//temp = 25000 - (1000*(Vtemp - Vtemp25) / m)	
-	temp = 1000 * (raw - cutoff);
-	temp = temp / slope;
-	temp = 25000 - temp;
-	
-	//convert to deg F: F = C * 1.8 + 32		
-	temp = temp * 18;
-	temp = temp / 10;
-	temp = temp + 32000;
-	temp = temp / 100;
+	return ADC_codeToTempC(ADC_correct(ADC_read(ADC_CHANNEL_TEMP_SENSOR)));
+}
 
-	return ((int16_t)temp);
+
+/////////////////////////////////////////////////////
+//ADC_codeToTempC / ADC_codeToTempF
+//Temp sensor code to 10th's of a degree from the
+//tables, for a reading taken any way - ADC_read,
+//a scan.  Codes outside the table are clamped to
+//its ends.
+int16_t ADC_codeToTempC(uint16_t code)
+{
+	return ADC_tempLookup(mTempTableC, code);
+}
+
+
+int16_t ADC_codeToTempF(uint16_t code)
+{
+	return ADC_tempLookup(mTempTableF, code);
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_tempLookup
+//Entry below the code, minus the drop to the next
+//entry times the 4 bits of the code below the step.
+//Temp falls as the code rises and a step is at most
+//14.1 degrees F, so the drop fits 8 bits and the
+//product is the native 8 x 8 MUL.
+static int16_t ADC_tempLookup(const int16_t *far table, uint16_t code)
+{
+	uint8_t index = 0x00;
+	uint8_t drop = 0x00;
+	uint8_t frac = 0x00;
+
+	if (code < ADC_TEMP_TABLE_START)
+		return table[0];
+
+	code -= ADC_TEMP_TABLE_START;
+	index = (uint8_t)(code >> ADC_TEMP_TABLE_SHIFT);
+	if (index >= (ADC_TEMP_TABLE_SIZE - 1))
+		return table[ADC_TEMP_TABLE_SIZE - 1];
+
+	frac = (uint8_t)(code & (ADC_TEMP_TABLE_STEP - 1));
+	drop = (uint8_t)(table[index] - table[index + 1]);
+
+	return table[index] - (int16_t)(((uint16_t)drop * frac) >> ADC_TEMP_TABLE_SHIFT);
 }
 
 
@@ -202,6 +485,7 @@ uint8_t ADC_isValidChannel(ADC_Channel_t channel)
 		case ADC_CHANNEL_TEMP_SENSOR:	return 1;		break;
 		case ADC_CHANNEL_VREFH:			return 1;		break;
 		case ADC_CHANNEL_VREFL:			return 1;		break;
+		case ADC_CHANNEL_BANDGAP:		return 1;		break;
 		case ADC_CHANNEL_VSS:			return 1;		break;
 		default: 						break;	
 	}
@@ -210,5 +494,537 @@ uint8_t ADC_isValidChannel(ADC_Channel_t channel)
 }
 
 
+/////////////////////////////////////////////////////
+//ADC_startContinuous
+//Empty the ring, switch to the slower continuous
+//clock and start converting channel back to back
+//with the conversion complete interrupt.
+void ADC_startContinuous(ADC_Channel_t channel)
+{
+	ADC_stop();
+
+	mAdcHead = 0x00;
+	mAdcTail = 0x00;
+	mAdcOverruns = 0x00;
+
+	ADCCFG_ADIV = ADC_CONT_ADIV;
+	ADCCFG_ADICLK = ADC_CONT_ADICLK;
+	ADCCFG_ADLSMP = 0x01;				//long sample time
+
+	if (!ADC_isValidChannel(channel))
+		channel = ADC_CHANNEL_VSS;
+
+	//writing ADCSC1 starts the first conversion
+	ADCSC1 = ADCSC1_AIEN_MASK | ADCSC1_ADCO_MASK | (uint8_t)channel;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_stop
+//Stop whatever runs - continuous, triggered, scan or
+//monitor - and put the ADC back the way ADC_init left
+//it for ADC_read: conversion and interrupt off,
+//software trigger, compare off, high speed, bus clock.
+//A triggered or monitor run gives the RTC tick back,
+//the triggered one TPM2 as well.  Results in the ring,
+//the snapshot and the monitor stats can still be
+//read.  Every start calls it first.
+void ADC_stop(void)
+{
+	ADCSC1 = ADC_CHANNEL_OFF;			//AIEN and ADCO off
+
+	if (mAdcTriggered)
+		TPM2SC = 0x00;
+
+	if (mAdcTriggered || mAdcMonitoring)
+		ADC_rtcRestore();
+
+	mAdcTriggered = 0x00;
+	mAdcMonitoring = 0x00;
+	mAdcScanning = 0x00;
+
+	ADCSC2_ADTRG = 0;
+	ADCSC2_ACFE = 0x00;
+
+	ADCCFG_ADLPC = 0x00;
+	ADCCFG_ADIV = ADC_ADIV(CLOCK_BUS_FREQ_HZ);
+	ADCCFG_ADICLK = 0x00;
+	ADCCFG_ADLSMP = 0x00;
+
+	SPMSC1_BGBE = 0;					//a scan's bandgap buffer
+}
+
+
+/////////////////////////////////////////////////////
+//Returns the number of results in the ring
+uint8_t ADC_getAvailable(void)
+{
+	return (uint8_t)((mAdcHead - mAdcTail) & (ADC_RING_SIZE - 1));
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_readBuffer
+//Copy up to max results out of the ring, oldest
+//first.  Returns the number copied.
+uint8_t ADC_readBuffer(uint16_t *far data, uint8_t max)
+{
+	uint8_t count = 0x00;
+	uint8_t tail = mAdcTail;
+	uint8_t head = mAdcHead;
+
+	while ((tail != head) && (count < max))
+	{
+		data[count] = mAdcRing[tail];
+		tail = (tail + 1) & (ADC_RING_SIZE - 1);
+		count++;
+	}
+
+	mAdcTail = tail;
+
+	return count;
+}
+
+
+/////////////////////////////////////////////////////
+//Returns the number of results dropped since the
+//last ADC_startContinuous or ADC_startTriggered
+uint16_t ADC_getOverruns(void)
+{
+	return mAdcOverruns;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_startTriggered
+//Empty the ring and convert channel once per RTC
+//overflow at rateHz, clamped to ADC_TRIG_MIN_HZ -
+//ADC_TRIG_MAX_HZ.  The ADC keeps the ADC_init clock,
+//a conversion is a few us.  TPM2 is started for the
+//jitter stamps.  Returns the period in us, rateHz
+//rounded to whole RTC steps.  Like continuous mode
+//it needs the bus clock, don't STOP3.
+unsigned long ADC_startTriggered(ADC_Channel_t channel, uint16_t rateHz)
+{
+	unsigned long period = 0x00;
+	unsigned long step = 0x00;
+	unsigned long count = 0x00;
+	uint8_t i = 0x00;
+
+	ADC_stop();
+
+	if (rateHz < ADC_TRIG_MIN_HZ)
+		rateHz = ADC_TRIG_MIN_HZ;
+	if (rateHz > ADC_TRIG_MAX_HZ)
+		rateHz = ADC_TRIG_MAX_HZ;
+
+	//finest prescale where the period fits RTCMOD
+	period = 1000000UL / rateHz;
+	while (1)
+	{
+		step = ADC_TRIG_IRCLK_US * mTrigDivide[i];
+		count = (period + (step >> 1)) / step;
+		if ((count <= 256) || (i == ADC_TRIG_PRESCALES - 1))
+			break;
+		i++;
+	}
+
+	if (count < 1)
+		count = 1;
+
+	DisableInterrupts;
+	mAdcHead = 0x00;
+	mAdcTail = 0x00;
+	mAdcOverruns = 0x00;
+	mAdcStamped = 0x00;
+	mAdcPeriodUs = (uint16_t)(count * step);
+	mAdcJitter.intervals = 0x00;
+	mAdcJitter.minUs = 0x7FFF;
+	mAdcJitter.maxUs = -0x7FFF;
+	mAdcTriggered = 1;
+	EnableInterrupts;
+
+	//TPM2 - free running, 1us per count
+	TPM2SC = 0x00;
+	TPM2MOD = 0x0000;
+	TPM2CNT = 0x0000;
+	TPM2SC = TPM2SC_CLKSA_MASK | ADC_TRIG_TPM_PS(CLOCK_BUS_FREQ_HZ);
+
+	//RTC - IRCLK at the sample rate.  IRCLKEN puts
+	//the internal reference out to the RTC.
+	ICSC1_IRCLKEN = 1;
+	ADC_rtcTake(ADC_TRIG_RTCSC_IRCLK | mTrigPrescale[i], (uint8_t)(count - 1));
+
+	if (!ADC_isValidChannel(channel))
+		channel = ADC_CHANNEL_VSS;
+
+	//hardware trigger, writing ADCSC1 arms the
+	//channel and the next RTC overflow converts it
+	ADCSC2_ADTRG = 1;
+	ADCSC1 = ADCSC1_AIEN_MASK | (uint8_t)channel;
+
+	return count * step;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_rtcTake
+//Save the RTC tick setup and run the RTC as the
+//trigger - rtcsc is the clock and prescale, the
+//interrupt stays off.
+static void ADC_rtcTake(uint8_t rtcsc, uint8_t mod)
+{
+	mRtcSC = RTCSC & (RTCSC_RTCLKS_MASK | RTCSC_RTIE_MASK | RTCSC_RTCPS_MASK);
+	mRtcMod = RTCMOD;
+
+	RTCSC = 0x00;
+	RTCMOD = mod;
+	RTCSC = RTCSC_RTIF_MASK | rtcsc;
+}
+
+
+/////////////////////////////////////////////////////
+//Put the RTC tick back the way ADC_rtcTake found it
+static void ADC_rtcRestore(void)
+{
+	RTCSC = 0x00;
+	RTCMOD = mRtcMod;
+	RTCSC = RTCSC_RTIF_MASK | mRtcSC;	//drop the flags the trigger left
+}
+
 
+/////////////////////////////////////////////////////
+//ADC_startMonitor
+//Watch channel every periodMs with the compare
+//function, waking the core only when it fires.
+//direction - ADC_MONITOR_ABOVE, alarm on at or
+//above threshold, off again below threshold -
+//hysteresis.  ADC_MONITOR_BELOW, alarm on below
+//threshold, off again at or above threshold +
+//hysteresis.
+//The RTC runs from the LPO as the trigger, the ADC
+//from its own async clock in low power mode, so
+//both keep going in STOP3.  Call with the alarm off.
+void ADC_startMonitor(ADC_Channel_t channel, uint16_t threshold, ADC_Direction_t direction, uint16_t hysteresis, uint16_t periodMs)
+{
+	unsigned long count = 0x00;
+	uint8_t i = 0x00;
+
+	ADC_stop();
+
+	if (threshold > ADC_FULL_SCALE)
+		threshold = ADC_FULL_SCALE;
+
+	if (periodMs == 0)
+		periodMs = 1;
+
+	//finest LPO prescale where the period fits RTCMOD
+	while (1)
+	{
+		count = ((unsigned long)periodMs + (mMonDivide[i] >> 1)) / mMonDivide[i];
+		if ((count <= 256) || (i == ADC_MON_PRESCALES - 1))
+			break;
+		i++;
+	}
 
+	if (count < 1)
+		count = 1;
+	if (count > 256)
+		count = 256;
+
+	DisableInterrupts;
+	mMonStats.alarm = 0x00;
+	mMonStats.wakes = 0x00;
+	mMonStats.last = 0x00;
+	mMonStats.periodMs = (uint16_t)(count * mMonDivide[i]);
+	mMonThreshold = threshold;
+	mMonDirection = (uint8_t)direction;
+	mMonHysteresis = hysteresis;
+	mAdcMonitoring = 1;
+	EnableInterrupts;
+
+	//ADACK, low power, long sample - about 30us a
+	//conversion without the bus clock
+	ADCCFG_ADLPC = 0x01;
+	ADCCFG_ADIV = 0x00;
+	ADCCFG_ADICLK = 0x03;
+	ADCCFG_ADLSMP = 0x01;
+
+	ADC_monitorArm(direction, threshold);
+
+	ADC_rtcTake(ADC_MON_RTCSC_LPO | mMonPrescale[i], (uint8_t)(count - 1));
+
+	if (!ADC_isValidChannel(channel))
+		channel = ADC_CHANNEL_VSS;
+
+	ADCSC2_ADTRG = 1;
+	ADCSC1 = ADCSC1_AIEN_MASK | (uint8_t)channel;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_getMonitor
+//Copy the monitor stats with interrupts off and add
+//the average current saved over waking every period
+//to read and compare in software, see adc.h
+void ADC_getMonitor(ADC_MonitorStats_t *far stats)
+{
+	unsigned long saved = 0x00;
+
+	DisableInterrupts;
+	*stats = mMonStats;
+	EnableInterrupts;
+
+	//pC per ms is nA.  176000 / 2ms is past 16 bits,
+	//held at ADC_MON_SAVED_MAX
+	if (stats->periodMs == 0x00)
+		stats->periodMs = 1;
+	saved = (ADC_MON_POLL_CHARGE - ADC_MON_CONV_CHARGE) / stats->periodMs;
+	if (saved > ADC_MON_SAVED_MAX)
+		saved = ADC_MON_SAVED_MAX;
+	stats->savedNa = (uint16_t)saved;
+}
+
+
+/////////////////////////////////////////////////////
+//Returns the wake count alone, no interrupt toggle,
+//for POWER_SLEEP_WHILE conditions
+uint16_t ADC_getMonitorWakes(void)
+{
+	return mMonStats.wakes;
+}
+
+
+/////////////////////////////////////////////////////
+//Set the compare function - ACFGT 1 fires at or
+//above ADCCV, 0 below it
+static void ADC_monitorArm(ADC_Direction_t direction, uint16_t value)
+{
+	if (value > ADC_FULL_SCALE)
+		value = ADC_FULL_SCALE;
+
+	ADCCVH = (uint8_t)(value >> 8);
+	ADCCVL = (uint8_t)(value & 0xFF);
+	ADCSC2_ACFGT = (direction == ADC_MONITOR_ABOVE) ? 1 : 0;
+	ADCSC2_ACFE = 1;
+}
+
+
+/////////////////////////////////////////////////////
+//Copy the jitter since the last ADC_startTriggered
+//with interrupts off so it is from the same moment.
+//min / max are 0 until there are two results.
+void ADC_getJitter(ADC_Jitter_t *far jitter)
+{
+	DisableInterrupts;
+	*jitter = mAdcJitter;
+	EnableInterrupts;
+
+	if (jitter->intervals == 0)
+	{
+		jitter->minUs = 0;
+		jitter->maxUs = 0;
+	}
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_startScan
+//Convert the list round robin from the ISR, up to
+//ADC_SCAN_MAX channels, calibration first.  Bad
+//channels read VSS.  Uses the continuous clock.
+void ADC_startScan(const ADC_Channel_t *far list, uint8_t count)
+{
+	uint8_t i = 0x00;
+
+	ADC_stop();
+
+	if (count > ADC_SCAN_MAX)
+		count = ADC_SCAN_MAX;
+
+	if (count == 0)
+		return;
+
+	for (i = 0 ; i < count ; i++)
+		mScanList[i] = ADC_isValidChannel(list[i]) ? (uint8_t)list[i] : (uint8_t)ADC_CHANNEL_VSS;
+
+	DisableInterrupts;
+	mScanCount = count;
+	mScanIndex = count;					//bandgap first
+	mScanPasses = 0x00;
+	mScanCalCountdown = ADC_SCAN_CAL_PASSES;
+	mAdcScanning = 1;
+	EnableInterrupts;
+
+	ADCCFG_ADIV = ADC_CONT_ADIV;
+	ADCCFG_ADICLK = ADC_CONT_ADICLK;
+	ADCCFG_ADLSMP = 0x01;				//long sample time
+
+	SPMSC1_BGBE = 1;					//off once it is converted
+	ADCSC1 = ADCSC1_AIEN_MASK | (uint8_t)ADC_CHANNEL_BANDGAP;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_getSnapshot
+//Copy the last complete pass and its calibration
+//with interrupts off, then correct it.
+void ADC_getSnapshot(ADC_Snapshot_t *far snapshot)
+{
+	uint8_t i = 0x00;
+	uint16_t scale = 0x00;
+
+	DisableInterrupts;
+	snapshot->count = mScanCount;
+	snapshot->passes = mScanPasses;
+	snapshot->bandgap = mCalBandgap;
+	scale = mCalScale;
+	for (i = 0 ; i < mScanCount ; i++)
+		snapshot->raw[i] = mScanLatest[i];
+	EnableInterrupts;
+
+	for (i = 0 ; i < snapshot->count ; i++)
+		snapshot->value[i] = ADC_correctWith(snapshot->raw[i], scale);
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_scanNext
+//From the ISR - store the result, copy a finished
+//pass to the latest table, and start the next
+//conversion.  Calibration goes after the list when
+//it is due, its scale is worked out here once so a
+//snapshot only multiplies.  BGBE goes on with the
+//last channel before the bandgap, a conversion to
+//settle, and off as soon as the bandgap is read.
+static void ADC_scanNext(uint16_t result)
+{
+	uint8_t i = 0x00;
+	uint8_t channel = 0x00;
+
+	if (mScanIndex < mScanCount)
+		mScanWork[mScanIndex] = result;
+	else
+	{
+		SPMSC1_BGBE = 0;
+		if ((result >= ADC_CAL_MIN) && (result <= ADC_CAL_MAX))
+		{
+			mCalBandgap = result;
+			mCalScale = ADC_calScale(result);
+		}
+	}
+
+	mScanIndex++;
+
+	if (mScanIndex == mScanCount)
+	{
+		for (i = 0 ; i < mScanCount ; i++)
+			mScanLatest[i] = mScanWork[i];
+		mScanPasses++;
+
+		if (mScanCalCountdown > 0)
+		{
+			mScanCalCountdown--;
+			mScanIndex = 0x00;
+		}
+		else
+			mScanCalCountdown = ADC_SCAN_CAL_PASSES;
+	}
+	else if (mScanIndex > mScanCount)
+		mScanIndex = 0x00;
+
+	if (mScanIndex < mScanCount)
+		channel = mScanList[mScanIndex];
+	else
+		channel = ADC_CHANNEL_BANDGAP;
+
+	//calibration after this one
+	if ((mScanIndex == (uint8_t)(mScanCount - 1)) && (mScanCalCountdown == 0))
+		SPMSC1_BGBE = 1;
+
+	ADCSC1 = ADCSC1_AIEN_MASK | channel;
+}
+
+
+/////////////////////////////////////////////////////
+//ADC_monitorFired
+//From the ISR - COCO only sets when the compare is
+//true, so every call is a crossing.  Flip the alarm
+//and arm the way back, with the hysteresis on the
+//way out of the alarm.
+static void ADC_monitorFired(uint16_t result)
+{
+	mMonStats.wakes++;
+	mMonStats.last = result;
+	mMonStats.alarm ^= 0x01;
+
+	if (mMonDirection == ADC_MONITOR_ABOVE)
+	{
+		if (mMonStats.alarm)
+			ADC_monitorArm(ADC_MONITOR_BELOW, (mMonThreshold > mMonHysteresis) ? mMonThreshold - mMonHysteresis : 0);
+		else
+			ADC_monitorArm(ADC_MONITOR_ABOVE, mMonThreshold);
+	}
+	else
+	{
+		if (mMonStats.alarm)
+			ADC_monitorArm(ADC_MONITOR_ABOVE, mMonThreshold + mMonHysteresis);
+		else
+			ADC_monitorArm(ADC_MONITOR_BELOW, mMonThreshold);
+	}
+}
+
+
+////////////////////////////////////////////////
+//ADC Interrupt Service Routine
+//Conversion complete - reading ADCRL clears COCO
+//and the next conversion is already running, or
+//waits for the next RTC overflow when triggered.
+//The stamp is taken before the ring work so an
+//overrun doesn't show up as jitter.
+void interrupt VectorNumber_Vadc adc_isr(void)
+{
+	uint16_t result = ((uint16_t)ADCRH << 8);
+	uint8_t next = (mAdcHead + 1) & (ADC_RING_SIZE - 1);
+	uint16_t stamp = 0x00;
+	int16_t deviation = 0x00;
+
+	if (mAdcTriggered)
+	{
+		stamp = TPM2CNT;
+		if (mAdcStamped)
+		{
+			deviation = (int16_t)((uint16_t)(stamp - mAdcStamp) - mAdcPeriodUs);
+			if (deviation < mAdcJitter.minUs)
+				mAdcJitter.minUs = deviation;
+			if (deviation > mAdcJitter.maxUs)
+				mAdcJitter.maxUs = deviation;
+			mAdcJitter.intervals++;
+		}
+		mAdcStamp = stamp;
+		mAdcStamped = 1;
+	}
+
+	result |= ADCRL;
+
+	if (mAdcMonitoring)
+	{
+		ADC_monitorFired(result);
+		return;
+	}
+
+	if (mAdcScanning)
+	{
+		ADC_scanNext(result);
+		return;
+	}
+
+	if (next == mAdcTail)
+	{
+		mAdcOverruns++;
+		return;
+	}
+
+	mAdcRing[mAdcHead] = result;
+	mAdcHead = next;
+}
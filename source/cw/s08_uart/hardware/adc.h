@@ -15,6 +15,7 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
 
 ////////////////////////////////////////////////////////
 //See Table 17 in the spec sheet.  Values used to compute
@@ -24,7 +25,195 @@
 #define ADC_TEMP25_MV				701200
 #define ADC_TEMP_SLOPE_UNDER25		1646		//1.646 - slope of the mV/C curve
 #define ADC_TEMP_SLOPE_OVER25		1769		//1.769 - slope of the mV/C curve
-#define ADC_VREFH					3260
+#define ADC_VREFH					3260		//nominal, the tables are built for it
+
+////////////////////////////////////////////////////////
+//Temp tables - the code to temp is two straight lines
+//meeting at 25C, tabled at every 16 codes and
+//interpolated, see adc.c.  The table covers 522mv -
+//828mv at the 3.26V VREFH, 126C down to -52C.
+#define ADC_TEMP_TABLE_SHIFT		4
+#define ADC_TEMP_TABLE_STEP			(1 << ADC_TEMP_TABLE_SHIFT)
+#define ADC_TEMP_TABLE_START		656
+#define ADC_TEMP_TABLE_SIZE			25			//656 - 1040
+
+////////////////////////////////////////////////////////
+//ADC clock - ADCK is the bus clock divided by 2^ADIV.
+//Max 8mhz in high speed mode (ADLPC = 0), see Table 17
+#define ADC_ADCK_MAX_HZ				8000000UL
+
+#define ADC_ADIV(bus)		(((bus) <= ADC_ADCK_MAX_HZ) ? 0 :			\
+							((bus) <= (ADC_ADCK_MAX_HZ << 1)) ? 1 :		\
+							((bus) <= (ADC_ADCK_MAX_HZ << 2)) ? 2 : 3)
+
+////////////////////////////////////////////////////////
+//Continuous conversion - ADCK is the bus / 2 / 8 with
+//the long sample time, about 40 ADCK per 12 bit
+//result, 6.25khz at the 4mhz bus.  Slow enough that
+//the ISR is a small part of the CPU, fast enough that
+//a consumer drains the ring in bulk.  Needs the bus
+//clock - keep the core out of STOP3 while it runs
+//(POWER_PERIPH_ADC where power.c is used).
+#define ADC_CONT_ADIV				3			//divide by 8
+#define ADC_CONT_ADICLK				1			//bus / 2
+#define ADC_CONT_ADCK_CYCLES		40UL
+#define ADC_CONT_RATE_HZ			(CLOCK_BUS_FREQ_HZ / 16 / ADC_CONT_ADCK_CYCLES)
+
+//results ring, power of two.  Holds one less than
+//the size, drain it at half full.
+#define ADC_RING_SIZE				16
+#define ADC_CHANNEL_OFF				0x1F
+
+////////////////////////////////////////////////////////
+//Triggered conversion - the RTC overflow starts each
+//conversion (ADTRG = 1), so the sample instants are
+//fixed by the RTC counter and not by when an ISR or
+//the main loop gets around to it.  Sample n is taken
+//at n * period after the first, the ISR only moves
+//the result into the ring.
+//
+//The RTC runs from the trimmed 31.25khz internal
+//reference (IRCLK), the finest prescale that fits
+//the 8 bit RTCMOD is picked for the rate:
+//  /1    - 32us steps,   123hz and up
+//  /16   - 512us steps,  8hz and up
+//  /100  - 3.2ms steps,  2hz and up
+//  /1000 - 32ms steps,   down to 1hz
+//The rate is rounded to a whole number of steps,
+//ADC_startTriggered returns the period it got.
+//
+//The RTC interrupt is off while it runs - no tick,
+//no RTC_delay.  ADC_stop puts the RTC back.
+#define ADC_TRIG_MIN_HZ				1
+#define ADC_TRIG_MAX_HZ				5000		//conversion + ISR well inside 200us
+#define ADC_TRIG_IRCLK_US			32UL		//one IRCLK period
+
+//RTCSC - RTCLKS = 10 internal reference, RTIE off
+#define ADC_TRIG_RTCSC_IRCLK		0x40
+
+////////////////////////////////////////////////////////
+//Scan sequencer - the conversion complete ISR walks a
+//list of channels, starting the next one as it reads
+//the last, on the continuous clock (ADC_CONT_RATE_HZ
+//conversions, split between the channels).  A full
+//pass is copied to the latest table at once, so a
+//snapshot never mixes two passes.
+//
+//Calibration - every ADC_SCAN_CAL_PASSES passes, and
+//before the first one, the 1.2V bandgap is converted
+//after the list.  Results are a fraction of VREFH,
+//which is the supply and not the nominal ADC_VREFH
+//the mv and temp tables are built for, and the
+//bandgap code gives the real VREFH:
+//  VREFH = ADC_BANDGAP_MV * 0xFFF / bandgap
+//Readings are scaled to the nominal VREFH with
+//  value = raw * ADC_CAL_NOMINAL / bandgap
+//The divide is done once per calibration, into a
+//Q12 scale (ADC_CAL_NOMINAL << 12) / bandgap, 2261 -
+//4522 for 1.8 - 3.6V, and each reading is a 16 x 16
+//multiply and a shift, at most a count below the
+//divide.
+//ADC_readMv uses the same correction, ADC_calibrate
+//measures it without a scan.  A bandgap code for a
+//VREFH outside 1.8 - 3.6V is a bad reading and
+//ignored.  BGBE is only set for the bandgap
+//conversion and the one before it, which gives the
+//buffer time to settle - it costs current in STOP3
+//and WAIT.
+#define ADC_SCAN_MAX				6
+#define ADC_SCAN_CAL_PASSES			100
+#define ADC_FULL_SCALE				0xFFF
+#define ADC_BANDGAP_MV				1200		//VBG, factory trimmed, Table 17
+#define ADC_BANDGAP_CODE(vrefh)		(uint16_t)(((unsigned long)ADC_BANDGAP_MV * ADC_FULL_SCALE) / (vrefh))
+#define ADC_CAL_NOMINAL				ADC_BANDGAP_CODE(ADC_VREFH)
+#define ADC_CAL_MIN					ADC_BANDGAP_CODE(3600)
+#define ADC_CAL_MAX					ADC_BANDGAP_CODE(1800)
+#define ADC_CAL_SHIFT				12
+#define ADC_CAL_ONE					(1u << ADC_CAL_SHIFT)
+
+////////////////////////////////////////////////////////
+//Monitor - the compare function watches one channel
+//and COCO only sets when the result crosses the
+//threshold, so the core sleeps until it does.  The
+//RTC on the 1khz LPO triggers a conversion every
+//period, the ADC runs on ADACK in low power mode,
+//both keep going in STOP3 (no POWER_PERIPH_ADC).
+//Each crossing flips the alarm and re-arms the
+//compare the other way, with the hysteresis on the
+//way back.  Period 1ms - 65s, in 1ms steps up to
+//256ms, then 10ms, 100ms, 1s.  The RTC interrupt is
+//off while it runs.
+#define ADC_MON_RTCSC_LPO			0x00		//RTCLKS = 00, RTIE off
+
+//Savings over polling - waking every period to
+//convert on the bus clock and compare in software,
+//against only the ADC converting.  Alarm wakes cost
+//the same both ways and are left out.  Typical
+//figures at 3V from the datasheet, 4mhz bus, replace
+//with a measurement on the board.
+#define ADC_MON_RUN_UA				1800UL		//run, FEI 4mhz bus
+#define ADC_MON_POLL_US				100UL		//STOP3 recovery, convert, compare
+#define ADC_MON_ADC_UA				120UL		//ADC low power conversion
+#define ADC_MON_CONV_US				30UL		//ADACK startup and conversion
+#define ADC_MON_POLL_CHARGE			(ADC_MON_RUN_UA * ADC_MON_POLL_US)		//pC
+#define ADC_MON_CONV_CHARGE			(ADC_MON_ADC_UA * ADC_MON_CONV_US)		//pC
+#define ADC_MON_SAVED_MAX			0xFFFFUL	//savedNa held here, periodMs <= 2
+
+//Temp sensor code at a whole degree C, for monitor
+//thresholds.  The code falls as the temp rises.
+#define ADC_TEMP_UV_C(c)		(ADC_TEMP25_MV - ((long)(c) - 25L) *		\
+								(((c) > 25) ? ADC_TEMP_SLOPE_OVER25 : ADC_TEMP_SLOPE_UNDER25))
+#define ADC_TEMP_CODE_C(c)		(uint16_t)(((unsigned long)ADC_TEMP_UV_C(c) * ADC_FULL_SCALE) / (ADC_VREFH * 1000UL))
+
+////////////////////////////////////////////////////////
+//Jitter - the ISR stamps every result with TPM2, free
+//running at 1us from the bus clock, and compares the
+//time since the last one with the period.  The
+//hardware trigger has no jitter of its own, what is
+//left is the interrupt latency the rest of the
+//program adds - other ISRs, interrupts disabled.
+//TPM2 prescale - bus / 2^PS = 1mhz
+#define ADC_TRIG_TPM_PS(bus)	(((bus) >= 8000000UL) ? 3 :				\
+								((bus) >= 4000000UL) ? 2 :				\
+								((bus) >= 2000000UL) ? 1 : 0)
+
+typedef enum
+{
+	ADC_MONITOR_BELOW,
+	ADC_MONITOR_ABOVE
+}ADC_Direction_t;
+
+/////////////////////////////////////////
+//Monitor Stats
+//alarm - 1 while the channel is past the threshold
+//wakes - compare interrupts since ADC_startMonitor,
+//the only times the core woke for the ADC
+//last - result of the last crossing
+//periodMs - conversion period it got
+//savedNa - estimate of the average current saved
+//over polling at that period, from the datasheet
+//figures above, not a measurement.  Filled by
+//ADC_getMonitor, held at ADC_MON_SAVED_MAX.
+typedef struct
+{
+	uint8_t alarm;
+	uint16_t wakes;
+	uint16_t last;
+	uint16_t periodMs;
+	uint16_t savedNa;
+}ADC_MonitorStats_t;
+
+/////////////////////////////////////////
+//Jitter since ADC_startTriggered
+//intervals - ISR to ISR intervals measured
+//minUs / maxUs - shortest and longest interval
+//minus the period.  Jitter is maxUs - minUs.
+typedef struct
+{
+	uint16_t intervals;
+	int16_t minUs;
+	int16_t maxUs;
+}ADC_Jitter_t;
 
 typedef enum
 {
@@ -32,15 +221,57 @@ typedef enum
 	ADC_CHANNEL_9 = 0x09,
 	ADC_CHANNEL_TEMP_SENSOR = 0x1A,
 	ADC_CHANNEL_VREFL = 0x0A,
+	ADC_CHANNEL_BANDGAP = 0x1B,
 	ADC_CHANNEL_VREFH = 0x1D,
 	ADC_CHANNEL_VSS = 0x1E
 }ADC_Channel_t;
 
+/////////////////////////////////////////
+//Scan Snapshot - one pass of the scan list
+//count - channels in the list
+//passes - passes completed, 0 = raw and value not
+//valid yet, wraps
+//bandgap - calibration the values were corrected
+//with, ADC_CAL_NOMINAL until one is measured
+//raw - counts as converted, list order
+//value - raw scaled to the nominal VREFH
+typedef struct
+{
+	uint8_t count;
+	uint16_t passes;
+	uint16_t bandgap;
+	uint16_t raw[ADC_SCAN_MAX];
+	uint16_t value[ADC_SCAN_MAX];
+}ADC_Snapshot_t;
+
 void ADC_init(void);
 uint16_t ADC_read(ADC_Channel_t channel);
 uint16_t ADC_readMv(ADC_Channel_t channel);
 int16_t ADC_readTemp(void);
 uint8_t ADC_isValidChannel(ADC_Channel_t channel);
+void ADC_stop(void);
+
+void ADC_calibrate(void);
+uint16_t ADC_correct(uint16_t raw);
+uint16_t ADC_countsToMv(uint16_t counts);
+int16_t ADC_readTempC(void);
+int16_t ADC_codeToTempC(uint16_t code);
+int16_t ADC_codeToTempF(uint16_t code);
+
+void ADC_startContinuous(ADC_Channel_t channel);
+uint8_t ADC_getAvailable(void);
+uint8_t ADC_readBuffer(uint16_t *far data, uint8_t max);
+uint16_t ADC_getOverruns(void);
+
+unsigned long ADC_startTriggered(ADC_Channel_t channel, uint16_t rateHz);
+void ADC_getJitter(ADC_Jitter_t *far jitter);
+
+void ADC_startScan(const ADC_Channel_t *far list, uint8_t count);
+void ADC_getSnapshot(ADC_Snapshot_t *far snapshot);
+
+void ADC_startMonitor(ADC_Channel_t channel, uint16_t threshold, ADC_Direction_t direction, uint16_t hysteresis, uint16_t periodMs);
+void ADC_getMonitor(ADC_MonitorStats_t *far stats);
+uint16_t ADC_getMonitorWakes(void);
 
 
 
@@ -0,0 +1,117 @@
+/*
+ * clock.c
+ *
+ *  Created on: Aug 3, 2019
+ *      Author: danao
+ */
+
+#include "derivative.h" /* include peripheral declarations */
+#include <stddef.h>
+#include "config.h"
+#include "clock.h"
+
+////////////////////////////////////////////////////
+//Clock_init()
+//Configure the ICS for the mode selected with
+//CLOCK_PROFILE and the bus divider CLOCK_BDIV.
+//See clock.h.  Note:  the default out of reset
+//is FEI with divide by 2, about 4mhz bus.
+//
+//From the datasheet:
+//ICSC1 - internal clock source control register 1
+//ICSC2 - internal clock source control register 2
+//ICSTRM - trim register
+//
+void Clock_init(void)
+{
+	//////////////////////////////////////////////////
+	//ICSSC - Status and Control Register
+	//DRS = 00
+	//DMX32 - 0
+	//the above gives FLL factor 512 and DCO range 16-20 mhz
+	ICSSC_DRST_DRS1 = 0;
+	ICSSC_DRST_DRS0 = 0;
+	ICSSC_DMX32 = 0;
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEI)
+
+	////////////////////////////////////////////
+	//FEI - FLL engaged, internal reference
+	//CLKS bits - 00 - FLL output
+	//IREFS - 1 - internal reference
+	ICSC1_CLKS1 = 0;
+	ICSC1_CLKS0 = 0;
+	ICSC1_IREFS = 1;
+
+	//load the factory trim so the reference is
+	//31.25khz.  Erased (0xFF) means not programmed,
+	//leave the reset value.
+	if (NVICSTRM != 0xFF)
+	{
+		ICSTRM = NVICSTRM;
+		ICSSC_FTRIM = NVFTRIM_FTRIM;
+	}
+
+	ICSC2_LP = 0;			//FLL on
+	ICSC2_BDIV = CLOCK_BDIV;
+
+	while (!ICSSC_IREFST){};			//wait for internal reference
+	while (ICSSC_CLKST != 0x00){};		//wait for FLL output selected
+
+#else
+
+	////////////////////////////////////////////
+	//External oscillator - 16mhz xtal on PB6 / PB7
+	//set the range and gain based on speed of ext osc.
+	ICSC2_RANGE = 1;		//high range
+	ICSC2_HGO = 1;			//high gain
+	ICSC2_EREFS = 1;		//oscillator is requested - important - set to 1
+	ICSC2_ERCLKEN = 1;		//enables external ref clock for serclk
+
+	while (!ICSSC_OSCINIT){};			//wait for the xtal to start
+
+	//RDIV - 100 - divider 512, high range, high gain 16mhz
+	//16mhz / 512 = 31.25khz, OK
+	ICSC1_RDIV = CLOCK_RDIV;
+
+	//IREFS - internal reference select - 0 is external
+	ICSC1_IREFS = 0;
+	while (ICSSC_IREFST){};				//wait for external reference
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEE)
+
+	//FEE - CLKS 00 - FLL output, FLL locked to the xtal
+	ICSC2_LP = 0;
+	ICSC1_CLKS1 = 0;
+	ICSC1_CLKS0 = 0;
+	while (ICSSC_CLKST != 0x00){};
+
+#else
+
+	//FBE / FBELP - CLKS 10 - external ref clock selected
+	ICSC1_CLKS1 = 1;
+	ICSC1_CLKS0 = 0;
+	while (ICSSC_CLKST != 0x02){};
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FBELP)
+	ICSC2_LP = 1;			//FLL is disabled in bypass mode
+#else
+	ICSC2_LP = 0;			//FLL keeps running in bypass mode
+#endif
+
+#endif
+
+	////////////////////////////////////////////////////
+	//Bus divider - 00 = 1, 01 = 2, 10 = 4, 11 = 8
+	ICSC2_BDIV = CLOCK_BDIV;
+
+#endif
+}
+
+
+////////////////////////////////////////////////////
+//Returns the bus frequency in hz
+unsigned long Clock_getBusFreq(void)
+{
+	return CLOCK_BUS_FREQ_HZ;
+}
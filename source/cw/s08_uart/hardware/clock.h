@@ -0,0 +1,90 @@
+/*
+ * clock.h
+ *
+ *  Created on: Aug 3, 2019
+ *      Author: danao
+ *
+ * The purpose of this file is to configure the
+ * clock source on the nxp mc9s08qe8 processor.
+ *
+ * Clock Profiles:
+ * The ICS mode and bus divider are picked with
+ * CLOCK_PROFILE and CLOCK_BDIV below (or with -D on
+ * the command line).  The resulting bus frequency is
+ * published as CLOCK_BUS_FREQ_HZ and all peripheral
+ * dividers (SPI, SCI, IIC, TPM, ADC) are computed from
+ * it, so changing the clock is one setting here.
+ *
+ * FEI - internal 31.25khz reference, FLL x512 = 16mhz
+ * FEE - 16mhz xtal / 512 = 31.25khz, FLL x512 = 16mhz
+ * FBE - 16mhz xtal, FLL bypassed but running
+ * FBELP - 16mhz xtal, FLL bypassed and disabled
+ *
+ * ICSOUT = 16mhz / BDIV, bus = ICSOUT / 2
+ * BDIV = 0 - 8mhz bus, 1 - 4mhz, 2 - 2mhz, 3 - 1mhz
+ *
+ * The fixed system clock (ICSFFCLK) is the FLL
+ * reference, 31.25khz in all profiles.  It does not
+ * change with BDIV.
+ *
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "config.h"
+
+#define CLOCK_PROFILE_FEI			0
+#define CLOCK_PROFILE_FEE			1
+#define CLOCK_PROFILE_FBE			2
+#define CLOCK_PROFILE_FBELP			3
+
+//////////////////////////////////////////
+//Clock selection
+//This board runs from the internal reference,
+//same as out of reset - 4mhz bus.
+#ifndef CLOCK_PROFILE
+#define CLOCK_PROFILE				CLOCK_PROFILE_FEI
+#endif
+
+#ifndef CLOCK_BDIV
+#define CLOCK_BDIV					1
+#endif
+
+//////////////////////////////////////////
+//Sources
+#define CLOCK_XTAL_FREQ_HZ			16000000UL
+#define CLOCK_IREF_FREQ_HZ			31250UL		//trimmed internal reference
+#define CLOCK_RDIV					4			//high range, 100 = divide by 512
+#define CLOCK_FLL_FACTOR			512UL		//DRS = 00, DMX32 = 0
+
+#define CLOCK_XTAL_REF_FREQ_HZ		(CLOCK_XTAL_FREQ_HZ >> (CLOCK_RDIV + 5))
+
+#if (CLOCK_PROFILE == CLOCK_PROFILE_FEI)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_IREF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			(CLOCK_IREF_FREQ_HZ * CLOCK_FLL_FACTOR)
+#elif (CLOCK_PROFILE == CLOCK_PROFILE_FEE)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_XTAL_REF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			(CLOCK_XTAL_REF_FREQ_HZ * CLOCK_FLL_FACTOR)
+#elif (CLOCK_PROFILE == CLOCK_PROFILE_FBE) || (CLOCK_PROFILE == CLOCK_PROFILE_FBELP)
+#define CLOCK_FIXED_FREQ_HZ			CLOCK_XTAL_REF_FREQ_HZ
+#define CLOCK_DCO_FREQ_HZ			CLOCK_XTAL_FREQ_HZ
+#else
+#error "clock.h - unknown CLOCK_PROFILE"
+#endif
+
+#if (CLOCK_BDIV > 3)
+#error "clock.h - CLOCK_BDIV must be 0 to 3"
+#endif
+
+//////////////////////////////////////////
+//Published frequencies
+#define CLOCK_ICSOUT_FREQ_HZ		(CLOCK_DCO_FREQ_HZ >> CLOCK_BDIV)
+#define CLOCK_BUS_FREQ_HZ			(CLOCK_ICSOUT_FREQ_HZ / 2)
+
+
+void Clock_init(void);
+unsigned long Clock_getBusFreq(void);
+
+
+#endif /* CLOCK_H_ */
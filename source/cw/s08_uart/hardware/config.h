@@ -30,6 +30,17 @@
 #define BIT7		(unsigned char)(1u << 7)
 
 
+///////////////////////////////////////////
+//Build Options
+//INSTRUMENT - 1 builds the measurement counters,
+//run times, residency and hit counts, in the
+//modules that have them.  Off by default, they
+//cost RAM.  -DINSTRUMENT on the command line.
+#ifndef INSTRUMENT
+#define INSTRUMENT	0
+#endif
+
+
 
 
 #endif /* CONFIG_H_ */
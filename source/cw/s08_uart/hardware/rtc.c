@@ -20,9 +20,10 @@
 #include <stddef.h>
 #include "config.h"
 #include "rtc.h"
+#include "power.h"
 
 //global time tick for delay function
-volatile unsigned int gTimeTick = 0x00;
+volatile unsigned long gTimeTick = 0x00;
 
 unsigned char mToggleInterval = 1;
 
@@ -68,11 +69,22 @@ void RTC_init(RTC_Frequency_t freq)
 /////////////////////////////////////////////
 //Delay in units of timebase for RTC interrupt
 //ie, For RTC configured to 1khz timeout, units in ms
-//
+//The core sleeps between ticks, see power.h.
 void RTC_delay(unsigned int delay)
 {
-	volatile unsigned int temp = delay + gTimeTick;
-	while (temp > gTimeTick){};	
+	unsigned long temp = 0x00;
+
+	DisableInterrupts;
+	temp = delay + gTimeTick;
+	EnableInterrupts;
+
+	POWER_SLEEP_WHILE(temp > gTimeTick);
+}
+
+
+unsigned long RTC_getTimeTick(void)
+{
+	return gTimeTick;
 }
 
 
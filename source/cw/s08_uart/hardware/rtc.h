@@ -35,6 +35,7 @@ extern unsigned char mToggleInterval;
 
 void RTC_init(RTC_Frequency_t freq);
 void RTC_delay(unsigned int delay);
+unsigned long RTC_getTimeTick(void);
 
 
 #endif /* RTC_H_ */
@@ -0,0 +1,197 @@
+/*
+ * stream.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Binary sample frames, COBS over the UART.
+ * See stream.h
+ *
+ */
+
+#include <stddef.h>
+#include "config.h"
+#include "uart.h"
+#include "stream.h"
+
+
+/////////////////////////////////////////////
+//CRC-8 poly 0x07, a nibble at a time.  Entry n is
+//the CRC of n in the top nibble - 16 bytes of ROM
+//instead of 256, two lookups a byte instead of a
+//loop of 8.
+static const uint8_t mCrcTable[16] =
+{
+	0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15,
+	0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D
+};
+
+
+/////////////////////////////////////////////
+//Frame Variables
+//mFrame - the frame being filled, sent from here
+//mLength - bytes used in mFrame
+//mCount - samples in mFrame
+//mSeq - seq of the frame being filled
+//In the zero page with the UART rings, see main.c
+#pragma DATA_SEG __SHORT_SEG MY_ZEROPAGE
+static uint8_t mFrame[STREAM_FRAME] = {0x00};
+static uint8_t mLength = 0x00;
+static uint8_t mCount = 0x00;
+static uint8_t mSeq = 0x00;
+#pragma DATA_SEG DEFAULT
+static Stream_Stats_t mStats = {0x00};
+
+
+static void Stream_start(void);
+static void Stream_send(uint8_t length);
+
+
+///////////////////////////////////////////
+//Stream_init
+//channel - goes in every frame, the ADC channel
+//of the samples
+void Stream_init(uint8_t channel)
+{
+	mSeq = 0x00;
+	mFrame[1] = channel;
+	mStats.frames = 0x00;
+	mStats.samples = 0x00;
+	mStats.dropped = 0x00;
+
+	Stream_start();
+}
+
+
+///////////////////////////////////////////
+//Stream_add
+//Pack a 12 bit sample into the frame.  Returns 1
+//when it filled the frame and the frame went out,
+//0 otherwise.
+uint8_t Stream_add(uint16_t sample)
+{
+	sample &= 0x0FFF;
+
+	//even - a[11:4], a[3:0] in the high nibble
+	//odd - b[11:8] in the low nibble, b[7:0]
+	if (!(mCount & 0x01))
+	{
+		mFrame[mLength++] = (uint8_t)(sample >> 4);
+		mFrame[mLength++] = (uint8_t)(sample << 4);
+	}
+	else
+	{
+		mFrame[mLength - 1] |= (uint8_t)(sample >> 8);
+		mFrame[mLength++] = (uint8_t)sample;
+	}
+
+	mCount++;
+	if (mCount < STREAM_SAMPLES)
+		return 0;
+
+	return Stream_flush();
+}
+
+
+///////////////////////////////////////////
+//Stream_flush
+//Send the frame with what is in it, for the last
+//samples before the sampling stops.  Returns 1 if
+//it went out, 0 if it was empty or dropped.
+uint8_t Stream_flush(void)
+{
+	uint8_t sent = 0x00;
+
+	if (!mCount)
+		return 0;
+
+	mFrame[0] = mSeq;
+	mFrame[2] = mCount;
+	mFrame[mLength] = Stream_crc8(0x00, mFrame, mLength);
+
+	//all of it or none of it, a part frame is a
+	//CRC error at the host and holds up the loop
+	if (UART_getTxFree() >= (uint8_t)(mLength + 3))
+	{
+		Stream_send(mLength + 1);
+		mStats.frames++;
+		mStats.samples += mCount;
+		sent = 1;
+	}
+	else
+		mStats.dropped++;
+
+	mSeq++;
+	Stream_start();
+
+	return sent;
+}
+
+
+///////////////////////////////////////////
+//Copy the counters
+void Stream_getStats(Stream_Stats_t *far stats)
+{
+	*stats = mStats;
+}
+
+
+///////////////////////////////////////////
+//Stream_crc8
+//Continue crc over length bytes of data.  Start
+//with 0x00.
+uint8_t Stream_crc8(uint8_t crc, const uint8_t *far data, uint8_t length)
+{
+	uint8_t i = 0x00;
+
+	for (i = 0 ; i < length ; i++)
+	{
+		crc ^= data[i];
+		crc = (uint8_t)(crc << 4) ^ mCrcTable[crc >> 4];
+		crc = (uint8_t)(crc << 4) ^ mCrcTable[crc >> 4];
+	}
+
+	return crc;
+}
+
+
+///////////////////////////////////////////
+//Empty frame, samples start after the header
+static void Stream_start(void)
+{
+	mLength = STREAM_HEADER;
+	mCount = 0x00;
+}
+
+
+///////////////////////////////////////////
+//Stream_send
+//COBS encode length bytes of mFrame straight into
+//the TX ring, then the 0x00 delimiter.  Each run up
+//to the next zero, or the end, goes out after a
+//code of its length + 1.  The zero itself is not
+//sent.  Frames are under 254 bytes, no run needs
+//splitting.
+static void Stream_send(uint8_t length)
+{
+	uint8_t start = 0x00;
+	uint8_t end = 0x00;
+
+	while (1)
+	{
+		end = start;
+		while ((end < length) && mFrame[end])
+			end++;
+
+		UART_tx((uint8_t)(end - start + 1));
+		for ( ; start < end ; start++)
+			UART_tx(mFrame[start]);
+
+		if (end >= length)
+			break;
+
+		start = end + 1;
+	}
+
+	UART_tx(0x00);
+}
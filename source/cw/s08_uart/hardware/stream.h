@@ -0,0 +1,77 @@
+/*
+ * stream.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Binary sample stream over the UART, in place of
+ * sprintf text.  Samples are packed into frames and
+ * each frame is COBS encoded and ended with a 0x00,
+ * so the host can find the next frame after a lost
+ * or bad byte.  No printf, no divide.
+ *
+ * Frame, before COBS:
+ * seq		- 1 byte, +1 each frame, wraps.  Also counted
+ * 			  for frames dropped here, so the host sees the
+ * 			  gap.
+ * channel	- 1 byte, ADC channel of the samples
+ * count	- 1 byte, samples in the frame, 1 - STREAM_SAMPLES
+ * data		- 12 bit samples packed 2 in 3 bytes:
+ * 			  a[11:4], a[3:0] b[11:8], b[7:0]
+ * 			  an odd count leaves the low nibble 0
+ * crc		- CRC-8, poly 0x07, init 0x00, over all of the
+ * 			  above
+ *
+ * COBS - each run of non zero bytes goes out after a
+ * code byte of run length + 1, a zero in the frame is
+ * the end of a run.  Frames are under 254 bytes so the
+ * cost is 1 byte, plus the 0x00 delimiter.
+ *
+ * Rate - STREAM_SAMPLES 16 is 24 bytes of samples,
+ * 30 bytes on the wire, 1.9 bytes a sample.  At 19200
+ * baud that is about 1000 samples a second, against
+ * about 170 printing "CH8: nnnn\r\n" per sample.  A
+ * frame only goes out if the whole thing fits in the
+ * UART TX ring, otherwise it is dropped and counted,
+ * the sampling never waits on the UART.
+ *
+ * Host side decoder - source/host/stream, CSV out and
+ * a loss report.
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stddef.h>
+#include "config.h"
+
+#define STREAM_SAMPLES			16			//per frame, even
+#define STREAM_HEADER			3			//seq, channel, count
+#define STREAM_DATA				((STREAM_SAMPLES * 3) >> 1)
+#define STREAM_FRAME			(STREAM_HEADER + STREAM_DATA + 1)
+#define STREAM_WIRE_MAX			(STREAM_FRAME + 2)	//COBS code and delimiter
+
+#define STREAM_CRC_POLY			0x07
+
+
+/////////////////////////////////////////
+//Counters since Stream_init
+//frames / samples - sent
+//dropped - frames that didn't fit the TX ring
+typedef struct
+{
+	uint16_t frames;
+	uint16_t samples;
+	uint16_t dropped;
+}Stream_Stats_t;
+
+
+void Stream_init(uint8_t channel);
+uint8_t Stream_add(uint16_t sample);
+uint8_t Stream_flush(void);
+void Stream_getStats(Stream_Stats_t *far stats);
+
+uint8_t Stream_crc8(uint8_t crc, const uint8_t *far data, uint8_t length);
+
+
+#endif /* STREAM_H_ */
@@ -7,6 +7,7 @@
  *  Header file for controlling the UART peripheral.
  *  Configures the UART at variable baud rate, 8 bits, no
  *  parity, 1 stop bit.  Rx interrupts are enabled
+ *  RX and TX rings, see uart.h
  *  
  *  Pinout: 
  *  PB1 - TX - Pin 19
@@ -17,48 +18,89 @@
 
 
 
+#include <hidef.h> /* for EnableInterrupts macro */
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
-#include <string.h>
 
 #include "config.h"
 #include "uart.h"
+#include "power.h"
 
 
-///////////////////////////////////////////////
-//UART Variables
-volatile uint8_t rxFlag = 0x00;				//set if complete instruction is ready
-volatile uint8_t rxIndex = 0x00;			//index in the buffer
-volatile uint8_t rxBuffer[UART_BUFFER_SIZE];//data buffer
+/////////////////////////////////////////////
+//RX Ring Variables
+//mRxHead - next byte in, written by the ISR
+//mRxTail - first byte of the next frame, written by
+//UART_poll after the handler returns
+//mRxLines - '\n' in the ring not handled yet
+//mRxIdle - the line went idle, mRxIdleHead is where
+//the frame ends
+//mCommands / mNumCommands - the command table
+//The rings and their indexes are in the zero page,
+//see the RAM budget in main.c
+#pragma DATA_SEG __SHORT_SEG MY_ZEROPAGE
+static uint8_t mRxRing[UART_RX_SIZE] = {0x00};
+static volatile uint8_t mRxHead = 0x00;
+static volatile uint8_t mRxTail = 0x00;
+static volatile uint8_t mRxLines = 0x00;
+static volatile uint8_t mRxIdle = 0x00;
+static volatile uint8_t mRxIdleHead = 0x00;
+#pragma DATA_SEG DEFAULT
+static UART_RxStats_t mRxStats = {0x00};
+static const UART_Command_t *far mCommands = NULL;
+static uint8_t mNumCommands = 0x00;
+
+
+static void UART_dispatch(UART_View_t frame);
+static void UART_clearIdle(uint8_t at);
+
+
+/////////////////////////////////////////////
+//TX Ring Variables
+//mTxHead - next byte in, written by UART_tx
+//mTxTail - next byte out, written by the ISR
+//mTxBusy - bytes queued or shifting out, SCI active
+#pragma DATA_SEG __SHORT_SEG MY_ZEROPAGE
+static uint8_t mTxRing[UART_TX_SIZE] = {0x00};
+static volatile uint8_t mTxHead = 0x00;
+static volatile uint8_t mTxTail = 0x00;
+static volatile uint8_t mTxBusy = 0x00;
+#pragma DATA_SEG DEFAULT
+static uint8_t mTxPolicy = 0x00;
+static UART_TxStats_t mTxStats = {0x00};
 
 
 /////////////////////////////////////////////////////
 //Configure the uart peripheral for 9600 baud, tx/rx,
 //rx interrupt enabled, 8bit, no parity, 1 stop bit
 //See Section 14.2.1
-//Baud rate = bus speed / divider.
-//No idea what the bus speed is. - 264khz?
-//through trial and error, rates of 115200 and 
-//57600 don't work when using internal clock
+//Baud rate = bus speed / (16 * divider), the divider
+//is computed from CLOCK_BUS_FREQ_HZ, see uart.h
 //
-//When using the default bus speed, available
-//rates 9600, 19200, and 38400
+//Available rates 9600, 19200, and 38400
 void UART_init(BaudRate_t rate)
 {
-	memset(rxBuffer, 0x00, UART_BUFFER_SIZE);	//clear the buffer
-	rxIndex = 0x00;								//reset the index
-	rxFlag = 0x00;								//reset the flag
+	mRxHead = 0x00;
+	mRxTail = 0x00;
+	mRxLines = 0x00;
+	mRxIdle = 0x00;
+	mRxIdleHead = 0x00;
+	UART_resetRxStats();
 	
-	//default rate = 9600
-	SCIBDH = 0x00;
-	SCIBDL = 0x1C;		//divider 28
+	mTxHead = 0x00;
+	mTxTail = 0x00;
+	mTxBusy = 0x00;
+	mTxPolicy = UART_TX_BLOCK;
+	UART_resetTxStats();
 	
+	//SCIBD - write the high byte first, the rate
+	//does not change until the low byte is written
 	switch(rate)
 	{
-		case BAUD_RATE_9600:	SCIBDL = 0x1C;	break;
-		case BAUD_RATE_19200:	SCIBDL = 0x0E;	break;
-		case BAUD_RATE_38400:	SCIBDL = 0x07;	break;
-		default: 				SCIBDL = 0x1C;	break;
+		case BAUD_RATE_9600:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 9600UL);		break;
+		case BAUD_RATE_19200:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 19200UL);	break;
+		case BAUD_RATE_38400:	SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 38400UL);	break;
+		default: 				SCIBD = UART_SBR(CLOCK_BUS_FREQ_HZ, 9600UL);		break;
 	}
 	
 	//SCIC1 - Control register 1
@@ -67,7 +109,7 @@ void UART_init(BaudRate_t rate)
 	SCIC1_RSRC = 0x00;		//no meaning
 	SCIC1_M = 0x00;			//8 bit mode
 	SCIC1_WAKE = 0x00;		//idle line wakeup
-	SCIC1_ILT = 0x00;		//idle starts after start bit
+	SCIC1_ILT = 0x01;		//idle counts after the stop bit
 	SCIC1_PE = 0x00;		//no parity
 	SCIC1_PT = 0x00;		//even parity - NA
 	
@@ -75,7 +117,7 @@ void UART_init(BaudRate_t rate)
 	SCIC2_TIE = 0x00;		//transmitter interrupt disable
 	SCIC2_TCIE = 0x00;		//transmit complete interrupt disable
 	SCIC2_RIE = 0x01;		//receiver interrupt enable
-	SCIC2_ILIE = 0x00;		//idle line interrupt disable
+	SCIC2_ILIE = 0x01;		//idle line interrupt, ends a frame
 	SCIC2_TE = 0x01;		//enable transmitter
 	SCIC2_RE = 0x01;		//enable receiver
 	SCIC2_RWU = 0x00;		//normal control
@@ -91,12 +133,98 @@ void UART_init(BaudRate_t rate)
 
 ///////////////////////////////////////////////////
 //Transmit 1 byte over the uart peripheral
-//put data into the SCID register and poll
-//the transmit complete flag
-void UART_tx(uint8_t data)
+//Queue the byte in the TX ring and turn on the
+//transmit interrupt.  With the ring full the policy
+//drops it or sleeps until there is room.  Returns 1
+//if queued, 0 if dropped.
+uint8_t UART_tx(uint8_t data)
+{
+	uint8_t next = (mTxHead + 1) & (UART_TX_SIZE - 1);
+	uint8_t used = 0x00;
+
+	if (next == mTxTail)
+	{
+		if (mTxPolicy == UART_TX_DROP)
+		{
+			mTxStats.dropped++;
+			return 0;
+		}
+
+		mTxStats.blocked++;
+		POWER_SLEEP_WHILE(next == mTxTail);
+	}
+
+	mTxRing[mTxHead] = data;
+
+	//the ISR clears busy and the SCI active bit when
+	//it goes idle, set both with it locked out
+	DisableInterrupts;
+	mTxHead = next;
+	mTxBusy = 1;
+	Power_setActive(POWER_PERIPH_SCI);
+	SCIC2_TCIE = 0;
+	SCIC2_TIE = 1;
+	EnableInterrupts;
+
+	used = (mTxHead - mTxTail) & (UART_TX_SIZE - 1);
+	if (used > mTxStats.highWater)
+		mTxStats.highWater = used;
+
+	return 1;
+}
+
+
+void UART_setTxPolicy(UART_TxPolicy_t policy)
+{
+	mTxPolicy = (uint8_t)policy;
+}
+
+
+///////////////////////////////////////////////////
+//Returns the number of bytes that can be queued
+uint8_t UART_getTxFree(void)
+{
+	return (uint8_t)((mTxTail - mTxHead - 1) & (UART_TX_SIZE - 1));
+}
+
+
+///////////////////////////////////////////////////
+//Returns 1 once the ring is empty and the last
+//byte is on the wire
+uint8_t UART_isTxIdle(void)
+{
+	return (mTxBusy == 0) ? 1 : 0;
+}
+
+
+///////////////////////////////////////////////////
+//Sleep until everything queued has been sent - before
+//changing the clock or the baud rate
+void UART_flush(void)
+{
+	POWER_SLEEP_WHILE(mTxBusy);
+}
+
+
+///////////////////////////////////////////////////
+//Copy the stats with interrupts off so they are
+//from the same moment
+void UART_getTxStats(UART_TxStats_t *far stats)
+{
+	DisableInterrupts;
+	*stats = mTxStats;
+	EnableInterrupts;
+}
+
+
+void UART_resetTxStats(void)
 {
-	SCID = data;			//put data into register
-	while (!SCIS1_TC){};	//poll transmit complete flag
+	DisableInterrupts;
+	mTxStats.bytes = 0x00;
+	mTxStats.highWater = 0x00;
+	mTxStats.dropped = 0x00;
+	mTxStats.blocked = 0x00;
+	EnableInterrupts;
 }
 
 
@@ -122,66 +250,316 @@ void UART_sendStringLength(uint8_t* buffer, int len)
 
 
 ////////////////////////////////////////////
-//Function called from polling loop to process
-//the incoming data.  
-void UART_processCommand(void)
+//UART_setCommands
+//Command table for UART_poll.  The table has to
+//stay in place, usually a const in ROM.
+void UART_setCommands(const UART_Command_t *far table, uint8_t count)
 {
-	//do something with the buffer
-	UART_sendString("RX MSG: ");
-	UART_sendStringLength((uint8_t*)rxBuffer, rxIndex);
-	
-	//reset the buffer
-	memset(rxBuffer, 0x00, UART_BUFFER_SIZE);
-	rxIndex = 0x00;
+	mCommands = table;
+	mNumCommands = count;
+}
+
+
+////////////////////////////////////////////
+//Returns 1 if a frame is waiting, for
+//POWER_SLEEP_WHILE conditions
+uint8_t UART_isRxReady(void)
+{
+	return (mRxLines || mRxIdle) ? 1 : 0;
+}
+
+
+////////////////////////////////////////////
+//UART_poll
+//Call from the main loop.  Hand every complete frame
+//to the dispatcher, in place, then release it.  The
+//frame ends at whichever comes first, the next '\n'
+//or the idle mark.  An idle mark already behind the
+//tail was inside a line that has been handled.
+//'\r' before the '\n' is not part of the frame.  A
+//full ring with no frame end can never complete and
+//is thrown away.  Returns the number of frames.
+uint8_t UART_poll(void)
+{
+	UART_View_t frame;
+	uint8_t handled = 0x00;
+	uint8_t used = 0x00;
+	uint8_t line = 0x00;
+	uint8_t idle = 0x00;
+	uint8_t idleAt = 0x00;
+	uint8_t skip = 0x00;
+
+	while (1)
+	{
+		frame.start = mRxTail;
+		used = (mRxHead - frame.start) & (UART_RX_SIZE - 1);
+
+		DisableInterrupts;
+		idle = mRxIdle;
+		idleAt = (mRxIdleHead - frame.start) & (UART_RX_SIZE - 1);
+		EnableInterrupts;
+
+		if (idle && ((idleAt == 0) || (idleAt > used)))
+		{
+			UART_clearIdle(frame.start + idleAt);
+			idle = 0x00;
+		}
+
+		//next '\n', used if there isn't one
+		line = used;
+		if (mRxLines)
+		{
+			for (line = 0 ; line < used ; line++)
+			{
+				if (mRxRing[(frame.start + line) & (UART_RX_SIZE - 1)] == '\n')
+					break;
+			}
+		}
+
+		if (idle && (idleAt <= line))
+		{
+			frame.length = idleAt;
+			skip = 0x00;
+			UART_clearIdle(frame.start + idleAt);
+		}
+		else if (line < used)
+		{
+			frame.length = line;
+			if ((frame.length > 0) && (UART_viewAt(frame, frame.length - 1) == '\r'))
+				frame.length--;
+			skip = (line + 1) - frame.length;
+
+			DisableInterrupts;
+			mRxLines--;
+			EnableInterrupts;
+		}
+		else
+		{
+			//full without an end
+			if (used == (UART_RX_SIZE - 1))
+			{
+				mRxStats.dropped += used;
+				mRxTail = (frame.start + used) & (UART_RX_SIZE - 1);
+			}
+			break;
+		}
+
+		if (frame.length > 0)
+		{
+			UART_dispatch(frame);
+			handled++;
+		}
+
+		mRxTail = (frame.start + frame.length + skip) & (UART_RX_SIZE - 1);
+	}
+
+	return handled;
+}
+
+
+////////////////////////////////////////////
+//Clear the idle mark at ring index at, unless the
+//ISR has moved it since it was read
+static void UART_clearIdle(uint8_t at)
+{
+	DisableInterrupts;
+	if (mRxIdleHead == (at & (UART_RX_SIZE - 1)))
+		mRxIdle = 0x00;
+	EnableInterrupts;
+}
+
+
+////////////////////////////////////////////
+//UART_dispatch
+//Match the first word of the frame against the
+//table, the handler gets the rest with the spaces
+//in front skipped.
+static void UART_dispatch(UART_View_t frame)
+{
+	UART_View_t args;
+	const char *far name = NULL;
+	uint8_t i = 0x00;
+	uint8_t j = 0x00;
+
+	mRxStats.frames++;
+
+	for (i = 0 ; i < mNumCommands ; i++)
+	{
+		name = mCommands[i].name;
+
+		for (j = 0 ; (j < frame.length) && name[j] && (UART_viewAt(frame, j) == (uint8_t)name[j]) ; j++)
+			;
+
+		//whole name, then the end or a space
+		if (name[j] || ((j < frame.length) && (UART_viewAt(frame, j) != ' ')))
+			continue;
+
+		while ((j < frame.length) && (UART_viewAt(frame, j) == ' '))
+			j++;
+
+		args.start = (frame.start + j) & (UART_RX_SIZE - 1);
+		args.length = frame.length - j;
+		mCommands[i].handler(args);
+		return;
+	}
+
+	mRxStats.unknown++;
+}
+
+
+////////////////////////////////////////////
+//Byte index of a view, 0 past the end
+uint8_t UART_viewAt(UART_View_t view, uint8_t index)
+{
+	if (index >= view.length)
+		return 0;
+
+	return mRxRing[(view.start + index) & (UART_RX_SIZE - 1)];
+}
+
+
+////////////////////////////////////////////
+//UART_viewNumber
+//Decimal number at *index, spaces in front skipped.
+//index is left after the last digit for the next
+//one.  Returns 0 if there are no digits.
+uint16_t UART_viewNumber(UART_View_t view, uint8_t *far index)
+{
+	uint16_t value = 0x00;
+	uint8_t data = 0x00;
+
+	while ((*index < view.length) && (UART_viewAt(view, *index) == ' '))
+		(*index)++;
+
+	while (*index < view.length)
+	{
+		data = UART_viewAt(view, *index);
+		if ((data < '0') || (data > '9'))
+			break;
+
+		//value * 10 as shifts
+		value = (value << 3) + (value << 1) + (data - '0');
+		(*index)++;
+	}
+
+	return value;
+}
+
+
+///////////////////////////////////////////////////
+//Copy the stats with interrupts off so they are
+//from the same moment
+void UART_getRxStats(UART_RxStats_t *far stats)
+{
+	DisableInterrupts;
+	*stats = mRxStats;
+	EnableInterrupts;
+}
+
+
+void UART_resetRxStats(void)
+{
+	DisableInterrupts;
+	mRxStats.bytes = 0x00;
+	mRxStats.frames = 0x00;
+	mRxStats.unknown = 0x00;
+	mRxStats.overruns = 0x00;
+	mRxStats.framing = 0x00;
+	mRxStats.noise = 0x00;
+	mRxStats.dropped = 0x00;
+	EnableInterrupts;
 }
 
 
 
 ///////////////////////////////////////////////
 //Interrupt Service Routine for RX
-//Interrupt is generated when RDRF flag in the 
-//SCIS1 register is set.  Clear the flag by reading
-//the SCIS1 register, then read the data register SCID
+//RDRF, IDLE and the error flags are cleared by
+//reading SCIS1 then SCID.  A byte with a framing
+//error is dropped, a full ring drops the new byte.
+//'\n' counts a line for UART_poll.  IDLE marks the
+//end of a frame at the head - it only sets again
+//after another byte has come in.  From the first
+//byte to IDLE the frame keeps the core out of STOP3.
 void interrupt VectorNumber_Vscirx uart_rx_isr(void)
 {
-	uint8_t dummy = 0x00;
-	uint8_t data = 0x00;
-	
-	dummy = SCIS1;		//read the status reg to clear the flag
-	data = SCID;		//read the data register
+	uint8_t status = SCIS1;
+	uint8_t data = SCID;
+	uint8_t next = 0x00;
 
-	if (!rxFlag)
-		UART_InterruptHandler(data);	
-}
+	if (status & (SCIS1_RDRF_MASK | SCIS1_FE_MASK))
+		Power_setActive(POWER_PERIPH_SCI_RX);
+
+	if (status & SCIS1_OR_MASK)
+		mRxStats.overruns++;
+
+	if (status & SCIS1_NF_MASK)
+		mRxStats.noise++;
 
+	if (status & SCIS1_FE_MASK)
+		mRxStats.framing++;
 
-///////////////////////////////////////////////////////
-//UART_InterruptHandler
-//Called when the UART receives a character.  
-void UART_InterruptHandler(uint8_t data)
-{		
-	if (rxIndex < (UART_BUFFER_SIZE - 1))
+	else if (status & SCIS1_RDRF_MASK)
 	{
-		rxBuffer[rxIndex] = data;		//put data into buffer
-		rxIndex++;						//increment the index
-		
-		if (data == '\n')				//end of line??
+		next = (mRxHead + 1) & (UART_RX_SIZE - 1);
+		if (next != mRxTail)
 		{
-			rxBuffer[rxIndex] = 0x00;		//end the line
-			rxFlag = 1;						//set the flag
+			mRxRing[mRxHead] = data;
+			mRxHead = next;
+			mRxStats.bytes++;
+
+			if (data == '\n')
+				mRxLines++;
 		}
+		else
+			mRxStats.dropped++;
 	}
-	
-	else
+
+	if (status & SCIS1_IDLE_MASK)
 	{
-		//overrun
-		memset(rxBuffer, 0x00, UART_BUFFER_SIZE);
-		rxIndex = 0x00;
-		rxFlag = 0x00;
+		mRxIdleHead = mRxHead;
+		mRxIdle = 1;
+		Power_clearActive(POWER_PERIPH_SCI_RX);
 	}
-	
 }
 
 
+///////////////////////////////////////////////
+//Interrupt Service Routine for TX
+//TDRE - reading SCIS1 then writing SCID clears it,
+//move the next byte from the ring.  Ring empty, swap
+//TIE for TCIE to find out when the last byte is out.
+//TC - the line is idle, the SCI no longer needs the
+//bus clock.  TC stays set until the next write to
+//SCID, so disable the interrupt instead of clearing
+//the flag.
+void interrupt VectorNumber_Vscitx uart_tx_isr(void)
+{
+	uint8_t status = SCIS1;
+
+	if (SCIC2_TIE && (status & SCIS1_TDRE_MASK))
+	{
+		if (mTxTail != mTxHead)
+		{
+			SCID = mTxRing[mTxTail];
+			mTxTail = (mTxTail + 1) & (UART_TX_SIZE - 1);
+			mTxStats.bytes++;
+		}
+		else
+		{
+			SCIC2_TIE = 0x00;
+			SCIC2_TCIE = 0x01;
+		}
+		return;
+	}
+
+	if (SCIC2_TCIE && (status & SCIS1_TC_MASK))
+	{
+		SCIC2_TCIE = 0x00;
+		mTxBusy = 0x00;
+		Power_clearActive(POWER_PERIPH_SCI);
+	}
+}
+
 
 
@@ -8,6 +8,27 @@
  *  Configures the UART at variable baud rate, 8 bits, no
  *  parity, 1 stop bit.  Rx interrupts are enabled
  *  
+ *  RX is a continuous ring filled by the receive
+ *  interrupt, nothing is dropped while a command is
+ *  handled.  A frame ends at '\n' or when the line goes
+ *  idle for a character time after the last byte
+ *  (ILIE), so a host that sends without a newline still
+ *  gets its command run.  UART_poll finds each frame,
+ *  matches the first word against the command table
+ *  and calls the handler with a view of the rest - a
+ *  start and length in the ring, read with
+ *  UART_viewAt / UART_viewNumber, never copied.  The
+ *  bytes are released when the handler returns.
+ *  
+ *  TX is interrupt driven - UART_tx queues the byte in
+ *  the TX ring and returns, the SCI transmit data
+ *  register empty interrupt (TIE) feeds SCID.  When the
+ *  ring runs empty TIE is swapped for the transmit
+ *  complete interrupt (TCIE), and the SCI is marked
+ *  inactive for power.c once the last stop bit is out.
+ *  A full ring either drops the byte or sleeps until
+ *  there is room, see UART_TxPolicy_t.
+ *  
  *  Pinout: 
  *  PB1 - TX - Pin 19
  *  PB0 - RX - Pin 20
@@ -21,8 +42,15 @@
 #include "derivative.h" /* include peripheral declarations */
 #include <stddef.h>
 #include "config.h"
+#include "clock.h"
+
+#define UART_RX_SIZE			32		//RX ring, power of two
+#define UART_TX_SIZE			64		//TX ring, power of two
 
-#define UART_BUFFER_SIZE		32
+//////////////////////////////////////////////
+//Baud rate divider - Section 14.2.1
+//baud = bus / (16 * SBR), rounded to nearest
+#define UART_SBR(bus, baud)		((uint16_t)(((bus) + ((baud) << 3)) / ((baud) << 4)))
 
 
 typedef enum
@@ -33,15 +61,95 @@ typedef enum
 }BaudRate_t;
 
 
-//rxFlag - set from the interrupt handler when receives \n
-extern volatile uint8_t rxFlag;
+//////////////////////////////////////////////
+//TX ring full policy
+//DROP - the byte is lost and counted, UART_tx never
+//waits.  For output that must not hold up the loop.
+//BLOCK - sleep until the ISR makes room, nothing is
+//lost.  Only waits when the ring is full.
+typedef enum
+{
+	UART_TX_DROP,
+	UART_TX_BLOCK
+}UART_TxPolicy_t;
+
+
+/////////////////////////////////////////
+//TX Stats since UART_init / UART_resetTxStats
+//bytes - bytes sent by the ISR
+//highWater - most bytes in the ring at once, how
+//close UART_TX_SIZE came to being too small
+//dropped - bytes lost with the DROP policy
+//blocked - UART_tx calls that had to wait, BLOCK
+typedef struct
+{
+	uint16_t bytes;
+	uint8_t highWater;
+	uint16_t dropped;
+	uint16_t blocked;
+}UART_TxStats_t;
+
+
+/////////////////////////////////////////
+//RX Stats since UART_init / UART_resetRxStats
+//bytes - bytes stored in the ring
+//frames - frames dispatched, matched or not
+//unknown - frames with no matching command
+//overruns - OR, a byte came in before the ISR read
+//the last one
+//framing - FE, bad stop bit, the byte is dropped
+//noise - NF, kept
+//dropped - ring full, or a frame longer than the ring
+typedef struct
+{
+	uint16_t bytes;
+	uint16_t frames;
+	uint16_t unknown;
+	uint16_t overruns;
+	uint16_t framing;
+	uint16_t noise;
+	uint16_t dropped;
+}UART_RxStats_t;
+
+
+/////////////////////////////////////////
+//View - bytes in the RX ring, no terminator
+typedef struct
+{
+	uint8_t start;
+	uint8_t length;
+}UART_View_t;
+
+typedef void (*UART_Handler_t)(UART_View_t args);
+
+/////////////////////////////////////////
+//Command table entry - name is the first word of
+//the frame, the handler gets what follows it
+typedef struct
+{
+	const char *far name;
+	UART_Handler_t handler;
+}UART_Command_t;
+
 
 void UART_init(BaudRate_t rate);
-void UART_tx(uint8_t data);
+uint8_t UART_tx(uint8_t data);
+void UART_setTxPolicy(UART_TxPolicy_t policy);
+uint8_t UART_getTxFree(void);
+uint8_t UART_isTxIdle(void);
+void UART_flush(void);
+void UART_getTxStats(UART_TxStats_t *far stats);
+void UART_resetTxStats(void);
 void UART_sendString(char* msg);
 void UART_sendStringLength(uint8_t* buffer, int len);
-void UART_processCommand(void);
-void UART_InterruptHandler(uint8_t data);
+
+void UART_setCommands(const UART_Command_t *far table, uint8_t count);
+uint8_t UART_isRxReady(void);
+uint8_t UART_poll(void);
+uint8_t UART_viewAt(UART_View_t view, uint8_t index);
+uint16_t UART_viewNumber(UART_View_t view, uint8_t *far index);
+void UART_getRxStats(UART_RxStats_t *far stats);
+void UART_resetRxStats(void);
 
 
 
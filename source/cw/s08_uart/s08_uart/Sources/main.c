@@ -16,6 +16,41 @@
  * This project will read the temp sensor on the 
  * IC and output the data over the serial port.
  * 
+ * CH8 is sampled at SAMPLE_RATE_HZ, each conversion
+ * triggered by the RTC overflow, into the ADC ring,
+ * see adc.h.  The core sleeps until the ring is half
+ * full, then drains it SAMPLE_BLOCK at a time, adds
+ * it to the average and runs it through the filter
+ * pipeline, see filter.h - median of 3, 16x
+ * oversampled to 14 bits, IIR 1/8.  Every 2 seconds of samples the
+ * conversions stop for the temp reading and the
+ * UART print - average, count, overruns, filtered
+ * value in 1/4 counts, the ISR timestamp jitter and
+ * the TX ring high water - then start again.  The
+ * print only queues the text, see uart.h, the
+ * sampling restarts while it goes out.  The text is
+ * built with format.h, no sprintf or divide.
+ * 
+ * Commands - lines (or bursts ended by an idle line)
+ * on the UART RX, see uart.h:
+ * ping		- replies pong
+ * stat		- RX and TX counters
+ * rate n	- CH8 sample rate, 1 - 5000hz
+ * 
+ * Temp Alarm - with APP_TEMP_ALARM set, main runs
+ * Alarm_run instead: the ADC compare function watches
+ * the temp sensor every ALARM_PERIOD_MS in STOP3 and
+ * the core only wakes when it crosses ALARM_TEMP_C, or
+ * comes back under it by ALARM_HYST_C.  Each wake
+ * prints the alarm state, wake count and the current
+ * saved over polling, see adc.h.  Red LED = alarm.
+ * 
+ * Stream - with APP_STREAM set, main runs Stream_run
+ * instead: CH8 at STREAM_RATE_HZ, every sample goes
+ * out as binary frames, see stream.h, no text.  Decode
+ * on the host with source/host/stream.  Green LED
+ * toggles each frame dropped for a full TX ring.
+ * 
  * Other peripherals supporting the project include:
  * 
  * LEDs: 
@@ -37,7 +72,19 @@
  *  PB4 - MISO		Pin 12
  *  PB5 - SS - 		Pin 11 - Configure as normal IO
  *  
+ * Memory Allocation:
+ * Small memory model, DEFAULT_RAM in RAM 0x100 - 0x25F
+ * with the 64 byte stack - 288 bytes for variables.
+ * adc 105, main 102, uart 25, stream 6, rtc / power 6
+ * - 244 used.  FAR_RAM goes in the same RAM, only
+ * INSTRUMENT puts anything there - power 12.
+ * 
+ * Zero page 0x60 - 0xFF, 160 bytes, MY_ZEROPAGE - the
+ * UART rings 104 and the stream frame 31 - 135 used.
  * 
+ * RAM_FIXED below is the part of the table not sized
+ * by a define, keep it up to date.  A ring or buffer
+ * that grows past the budget stops the build.
  *  
  */
 
@@ -47,12 +94,63 @@
 #include "mc9s08qe8.h"
 #include <stddef.h>
 #include <string.h>
-#include <stdio.h>
 #include "config.h"
 #include "rtc.h"
+#include "clock.h"
 #include "spi.h"
 #include "adc.h"
 #include "uart.h"
+#include "power.h"
+#include "filter.h"
+#include "stream.h"
+#include "format.h"
+
+#define SAMPLE_RATE_HZ			1000
+#define CH8_MEDIAN				3
+#define CH8_BITS				2
+#define CH8_SHIFT				3
+
+#ifndef APP_TEMP_ALARM
+#define APP_TEMP_ALARM			0
+#endif
+
+#define ALARM_TEMP_C			40
+#define ALARM_HYST_C			2
+#define ALARM_PERIOD_MS			1000
+
+#ifndef APP_STREAM
+#define APP_STREAM				0
+#endif
+
+#define STREAM_RATE_HZ			800			//about 80% of 19200 baud
+
+#define OUT_BUFFER_SIZE			32			//one UART_sendStringLength
+#define SAMPLE_BLOCK			(ADC_RING_SIZE / 2)
+
+//RAM budget, see Memory Allocation
+#define RAM_BUDGET				288			//0x100 - 0x25F less the stack
+#define RAM_FIXED				164
+#if INSTRUMENT
+#define RAM_INSTRUMENT			12			//power residency
+#else
+#define RAM_INSTRUMENT			0
+#endif
+#define ZERO_PAGE_BUDGET		160			//0x60 - 0xFF
+#define ZERO_PAGE_FIXED			11
+
+#if (((ADC_RING_SIZE + SAMPLE_BLOCK) * 2) + OUT_BUFFER_SIZE + RAM_FIXED + RAM_INSTRUMENT > RAM_BUDGET)
+#error "main.c - RAM over budget, see Memory Allocation"
+#endif
+
+//the temperature line, "Temperature: ", "\r\n" and
+//the 0x00
+#if ((13 + FORMAT_TENTHS_MAX + 2 + 1) > OUT_BUFFER_SIZE)
+#error "main.c - outBuffer too small for the temperature"
+#endif
+
+#if ((UART_RX_SIZE + UART_TX_SIZE + STREAM_FRAME + ZERO_PAGE_FIXED) > ZERO_PAGE_BUDGET)
+#error "main.c - zero page over budget, see Memory Allocation"
+#endif
 
 //prototypes
 void System_init(void);
@@ -65,50 +163,351 @@ void LED_On_Green(void);
 void LED_Off_Red(void);
 void LED_Off_Green(void);
 
-uint16_t result = 0x00;
-uint8_t high = 0x00;
-uint8_t low = 0x00;
-int16_t temperature = 0x00;
-int n = 0x00;
-unsigned char outBuffer[64];
+void Report_print(void);
+void Alarm_run(void);
+void Stream_run(void);
+
+void Cmd_ping(UART_View_t args);
+void Cmd_stat(UART_View_t args);
+void Cmd_rate(UART_View_t args);
+
+const UART_Command_t commands[] =
+{
+	{"ping",	Cmd_ping},
+	{"stat",	Cmd_stat},
+	{"rate",	Cmd_rate}
+};
+
+char outBuffer[OUT_BUFFER_SIZE];
+
+uint16_t samples[SAMPLE_BLOCK];
+unsigned long sampleSum = 0x00;
+uint16_t sampleCount = 0x00;
+unsigned long samplePeriod = 0x00;
+uint16_t sampleRate = SAMPLE_RATE_HZ;
+Filter_Pipeline_t ch8Filter;
+uint16_t ch8Filtered = 0x00;
 
 void main(void) 
 {
+	uint8_t n = 0x00;
+	uint8_t i = 0x00;
+	
 	DisableInterrupts;			//disable interrupts
 	System_init();				//configure system level config bits
+	Clock_init();				//internal reference, 4mhz bus
 	RTC_init(RTC_FREQ_100HZ);	//Timer
+	Power_init();				//sleep in WAIT / STOP3 between interrupts
 	GPIO_init();				//IO
 	ADC_init();					//set up ADC on CH8 and CH9
 	UART_init(BAUD_RATE_19200);	//setup uart on PB1 and PB0
 	
+	UART_setCommands(commands, sizeof(commands) / sizeof(commands[0]));
+	
 	EnableInterrupts;			//enable interrupts
 	
+	if (APP_TEMP_ALARM)
+		Alarm_run();			//never returns
+	
+	if (APP_STREAM)
+		Stream_run();			//never returns
+	
+	Filter_init(&ch8Filter, CH8_MEDIAN, CH8_BITS, FILTER_SMOOTH_IIR, CH8_SHIFT);
+	DisableInterrupts;
+	Power_setActive(POWER_PERIPH_ADC);	//ADC needs the bus clock
+	EnableInterrupts;
+	samplePeriod = ADC_startTriggered(ADC_CHANNEL_8, sampleRate);
+	
 	while (1)
 	{
+		//sleep until there is a block to drain or a
+		//command to run
+		POWER_SLEEP_WHILE((ADC_getAvailable() < (ADC_RING_SIZE / 2)) && !UART_isRxReady());
+		
+		(void)UART_poll();
+		
+		//oldest first, the filters care about order
+		do
+		{
+			n = ADC_readBuffer(samples, SAMPLE_BLOCK);
+			for (i = 0 ; i < n ; i++)
+			{
+				sampleSum += samples[i];
+				sampleCount++;
+				(void)Filter_run(&ch8Filter, samples[i], &ch8Filtered);
+			}
+		} while (n == SAMPLE_BLOCK);
+		
+		//the RTC tick is off while it triggers the ADC,
+		//count samples instead
+		if (sampleCount < (sampleRate << 1))
+			continue;
+		
 		LED_Toggle_Red();
-
-		//read the temp, 10ths of a degree
-		temperature = ADC_readTemp();
-		n = sprintf(outBuffer, "Temperature: %d.%d\r\n", temperature / 10, temperature % 10);
-		UART_sendStringLength(outBuffer, n);
+		ADC_stop();
+		Report_print();
 		
-		RTC_delay(200);
+		sampleSum = 0x00;
+		sampleCount = 0x00;
+		samplePeriod = ADC_startTriggered(ADC_CHANNEL_8, sampleRate);
 	}
 }
 
 
+////////////////////////////////////////////
+//Report_print
+//The 2 second report, with the conversions stopped.
+//The stats are copied into locals here and not kept,
+//lines longer than outBuffer go out in pieces.
+void Report_print(void)
+{
+	ADC_Jitter_t jitter;
+	UART_TxStats_t txStats;
+	uint16_t result = 0x00;
+	uint8_t n = 0x00;
+	
+	ADC_getJitter(&jitter);
+	UART_getTxStats(&txStats);
+	
+	//read the temp, 10ths of a degree, scaled with
+	//the VREFH the bandgap gives now
+	ADC_calibrate();
+	n = Format_string(outBuffer, "Temperature: ");
+	n += Format_tenths(outBuffer + n, ADC_readTemp());
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	
+	//CH8 average, samples and dropped in 2 seconds
+	result = (sampleCount > 0) ? (uint16_t)(sampleSum / sampleCount) : 0;
+	n = Format_string(outBuffer, "CH8: ");
+	n += Format_unsigned(outBuffer + n, result);
+	n += Format_string(outBuffer + n, " n=");
+	n += Format_unsigned(outBuffer + n, sampleCount);
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_string(outBuffer, " over=");
+	n += Format_unsigned(outBuffer + n, ADC_getOverruns());
+	n += Format_string(outBuffer + n, " filt=");
+	n += Format_unsigned(outBuffer + n, ch8Filtered);
+	n += Format_string(outBuffer + n, "/4\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	
+	//period and interval deviation, us, and how
+	//full the TX ring got
+	n = Format_string(outBuffer, "T=");
+	n += Format_unsignedLong(outBuffer + n, samplePeriod);
+	n += Format_string(outBuffer + n, "us jit ");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_signed(outBuffer, jitter.minUs);
+	n += Format_string(outBuffer + n, "..");
+	n += Format_signed(outBuffer + n, jitter.maxUs);
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_string(outBuffer, " tx hw=");
+	n += Format_unsigned(outBuffer + n, txStats.highWater);
+	n += Format_string(outBuffer + n, " blk=");
+	n += Format_unsigned(outBuffer + n, txStats.blocked);
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	
+#if INSTRUMENT
+	//RTC ticks in each mode since reset, only the
+	//report and the alarm run on the tick, the
+	//triggered conversions stop it
+	n = Format_string(outBuffer, "run ");
+	n += Format_unsignedLong(outBuffer + n, Power_getResidency(POWER_MODE_RUN));
+	n += Format_string(outBuffer + n, " wait ");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_unsignedLong(outBuffer, Power_getResidency(POWER_MODE_WAIT));
+	n += Format_string(outBuffer + n, " stop3 ");
+	n += Format_unsignedLong(outBuffer + n, Power_getResidency(POWER_MODE_STOP3));
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+#endif
+}
+
+
+////////////////////////////////////////////
+//Alarm_run
+//Temp alarm on the compare function.  Above the
+//alarm temp the sensor code is below the threshold
+//code, so the monitor watches for BELOW.  The
+//hysteresis is the code distance to ALARM_HYST_C
+//cooler.  Nothing here runs between crossings.
+void Alarm_run(void)
+{
+	ADC_MonitorStats_t monitor;
+	uint16_t wakes = 0x00;
+	uint8_t n = 0x00;
+
+	ADC_startMonitor(ADC_CHANNEL_TEMP_SENSOR,
+			ADC_TEMP_CODE_C(ALARM_TEMP_C),
+			ADC_MONITOR_BELOW,
+			ADC_TEMP_CODE_C(ALARM_TEMP_C - ALARM_HYST_C) - ADC_TEMP_CODE_C(ALARM_TEMP_C),
+			ALARM_PERIOD_MS);
+
+	while (1)
+	{
+		POWER_SLEEP_WHILE(ADC_getMonitorWakes() == wakes);
+
+		ADC_getMonitor(&monitor);
+		wakes = monitor.wakes;
+
+		if (monitor.alarm)
+			LED_On_Red();
+		else
+			LED_Off_Red();
+
+		n = Format_string(outBuffer, monitor.alarm ? "ALARM on wakes=" : "ALARM off wakes=");
+		n += Format_unsigned(outBuffer + n, monitor.wakes);
+		UART_sendStringLength((uint8_t *)outBuffer, n);
+		n = Format_string(outBuffer, " code=");
+		n += Format_unsigned(outBuffer + n, monitor.last);
+		n += Format_string(outBuffer + n, " T=");
+		n += Format_unsigned(outBuffer + n, monitor.periodMs);
+		n += Format_string(outBuffer + n, "ms");
+		UART_sendStringLength((uint8_t *)outBuffer, n);
+		n = Format_string(outBuffer, " saved=");
+		n += Format_unsigned(outBuffer + n, monitor.savedNa);
+		n += Format_string(outBuffer + n, "nA\r\n");
+		UART_sendStringLength((uint8_t *)outBuffer, n);
+	}
+}
+
+
+////////////////////////////////////////////
+//Stream_run
+//CH8 as binary frames.  Each drained block goes
+//straight into the frame, a full frame is COBS
+//encoded into the TX ring.  Nothing waits on the
+//UART - a frame with no room is dropped and the
+//host sees the gap in seq.
+void Stream_run(void)
+{
+	Stream_Stats_t stats;
+	uint16_t dropped = 0x00;
+	uint8_t n = 0x00;
+	uint8_t i = 0x00;
+
+	Stream_init(ADC_CHANNEL_8);
+	DisableInterrupts;
+	Power_setActive(POWER_PERIPH_ADC);
+	EnableInterrupts;
+	samplePeriod = ADC_startTriggered(ADC_CHANNEL_8, STREAM_RATE_HZ);
+
+	while (1)
+	{
+		POWER_SLEEP_WHILE(ADC_getAvailable() < SAMPLE_BLOCK);
+
+		do
+		{
+			n = ADC_readBuffer(samples, SAMPLE_BLOCK);
+			for (i = 0 ; i < n ; i++)
+				(void)Stream_add(samples[i]);
+		} while (n == SAMPLE_BLOCK);
+
+		Stream_getStats(&stats);
+		if (stats.dropped != dropped)
+		{
+			dropped = stats.dropped;
+			LED_Toggle_Green();
+		}
+	}
+}
+
+
+////////////////////////////////////////////
+//UART command handlers, args is the rest of the
+//line in the RX ring
+void Cmd_ping(UART_View_t args)
+{
+	UART_sendString("pong\r\n");
+}
+
+
+void Cmd_stat(UART_View_t args)
+{
+	UART_RxStats_t rxStats;
+	UART_TxStats_t txStats;
+	uint8_t n = 0x00;
+	
+	UART_getRxStats(&rxStats);
+	UART_getTxStats(&txStats);
+
+	n = Format_string(outBuffer, "rx ");
+	n += Format_unsigned(outBuffer + n, rxStats.bytes);
+	n += Format_string(outBuffer + n, " fr=");
+	n += Format_unsigned(outBuffer + n, rxStats.frames);
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_string(outBuffer, " unk=");
+	n += Format_unsigned(outBuffer + n, rxStats.unknown);
+	n += Format_string(outBuffer + n, " drop=");
+	n += Format_unsigned(outBuffer + n, rxStats.dropped);
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+
+	n = Format_string(outBuffer, "rx or=");
+	n += Format_unsigned(outBuffer + n, rxStats.overruns);
+	n += Format_string(outBuffer + n, " fe=");
+	n += Format_unsigned(outBuffer + n, rxStats.framing);
+	n += Format_string(outBuffer + n, " nf=");
+	n += Format_unsigned(outBuffer + n, rxStats.noise);
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+
+	n = Format_string(outBuffer, "tx ");
+	n += Format_unsigned(outBuffer + n, txStats.bytes);
+	n += Format_string(outBuffer + n, " hw=");
+	n += Format_unsigned(outBuffer + n, txStats.highWater);
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+	n = Format_string(outBuffer, " drop=");
+	n += Format_unsigned(outBuffer + n, txStats.dropped);
+	n += Format_string(outBuffer + n, " blk=");
+	n += Format_unsigned(outBuffer + n, txStats.blocked);
+	n += Format_string(outBuffer + n, "\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+}
+
+
+//////////////////////////////////////////
+//rate n - new CH8 rate, takes effect now and the
+//counts start over
+void Cmd_rate(UART_View_t args)
+{
+	uint8_t index = 0x00;
+	uint8_t n = 0x00;
+	uint16_t rate = UART_viewNumber(args, &index);
+
+	if ((rate < ADC_TRIG_MIN_HZ) || (rate > ADC_TRIG_MAX_HZ))
+	{
+		UART_sendString("rate 1 - 5000\r\n");
+		return;
+	}
+
+	sampleRate = rate;
+	sampleSum = 0x00;
+	sampleCount = 0x00;
+	samplePeriod = ADC_startTriggered(ADC_CHANNEL_8, sampleRate);
+
+	n = Format_string(outBuffer, "T=");
+	n += Format_unsignedLong(outBuffer + n, samplePeriod);
+	n += Format_string(outBuffer + n, "us\r\n");
+	UART_sendStringLength((uint8_t *)outBuffer, n);
+}
+
+
 ////////////////////////////////////////////
 //Configure system level registers - SOPT1 / SOPT2
 //These are write one-time registers.  Changing
 //any bit a second time has no effect.
 //
-//SOPT1 - Disable the watchdog and enable PTA5 as reset
+//SOPT1 - Disable the watchdog, enable PTA5 as reset
+//and enable the STOP instruction for power.c
 void System_init(void)
 {
 	//SOPT1 Register - Default = 0xC2
 	//Bit7 - Watchdog Enable
+	//Bit5 - STOPE - Stop mode enable
 	//Bit0 - Enable PTA5 as reset
-	SOPT1 = 0x43;
+	SOPT1 = 0x63;
 }
 
 
@@ -0,0 +1,233 @@
+/*
+ * format_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Host check and benchmark for the integer formatting
+ * in source/cw/s08_uart/hardware/format.c, built from
+ * the same source as the board.
+ *
+ * Check - every 16 bit value through each function,
+ * compared against snprintf.  Any mismatch is printed
+ * and the exit code is 1.
+ *
+ * Bench - time per call against snprintf with the
+ * matching format, in ns and in cycles where there is
+ * a cycle counter.  On the host both have a divide
+ * instruction, on the HCS08 only one of them needs a
+ * divide loop, so the gap on the board is wider.
+ *
+ * Code size is from the Makefile, see make size.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES			1
+#else
+#define BENCH_CYCLES			0
+#endif
+
+//the board's types, after the system headers
+#include "config.h"
+#include "format.h"
+
+#define BENCH_CALLS				2000000UL
+
+
+typedef struct
+{
+	double ns;
+	double cycles;
+}Cost_t;
+
+
+static unsigned long mErrors = 0;
+static volatile unsigned mSink = 0;
+
+static void check(const char *name, const char *got, unsigned gotLength, const char *expected, long value);
+static void checkAll(void);
+static void benchAll(void);
+static double nowNs(void);
+static unsigned long long nowCycles(void);
+
+
+int main(void)
+{
+	checkAll();
+
+	if (mErrors)
+	{
+		printf("%lu mismatches\n", mErrors);
+		return 1;
+	}
+
+	printf("check: all values match snprintf\n\n");
+
+	benchAll();
+
+	return 0;
+}
+
+
+/////////////////////////////////////////
+//Compare one result, text and length
+static void check(const char *name, const char *got, unsigned gotLength, const char *expected, long value)
+{
+	if ((strcmp(got, expected) == 0) && (gotLength == strlen(expected)))
+		return;
+
+	if (mErrors < 20)
+		printf("%s(%ld): got \"%s\" (%u) expected \"%s\"\n", name, value, got, gotLength, expected);
+	mErrors++;
+}
+
+
+/////////////////////////////////////////
+//Every 16 bit value, longs around each power of
+//ten, every width and digit count
+static void checkAll(void)
+{
+	static const unsigned long longs[] =
+	{
+		0UL, 9UL, 65535UL, 65536UL, 99999UL, 100000UL, 999999UL, 1000000UL,
+		9999999UL, 10000000UL, 99999999UL, 100000000UL, 999999999UL,
+		1000000000UL, 4294967294UL, 4294967295UL
+	};
+	char got[32];
+	char expected[32];
+	unsigned n = 0;
+	long v = 0;
+	unsigned width = 0;
+	unsigned i = 0;
+
+	for (v = 0 ; v <= 0xFFFF ; v++)
+	{
+		n = Format_unsigned(got, (uint16_t)v);
+		snprintf(expected, sizeof(expected), "%lu", (unsigned long)v);
+		check("unsigned", got, n, expected, v);
+
+		for (width = 1 ; width <= 5 ; width++)
+		{
+			n = Format_padded(got, (uint16_t)v, (uint8_t)width);
+			snprintf(expected, sizeof(expected), "%0*lu", (int)width, (unsigned long)v);
+			check("padded", got, n, expected, v);
+		}
+
+		for (width = 1 ; width <= 4 ; width++)
+		{
+			n = Format_hex(got, (uint16_t)v, (uint8_t)width);
+			snprintf(expected, sizeof(expected), "%0*lX", (int)width, (unsigned long)v & ((1UL << (width << 2)) - 1));
+			check("hex", got, n, expected, v);
+		}
+	}
+
+	for (v = -32768 ; v <= 32767 ; v++)
+	{
+		n = Format_signed(got, (int16_t)v);
+		snprintf(expected, sizeof(expected), "%ld", v);
+		check("signed", got, n, expected, v);
+
+		n = Format_tenths(got, (int16_t)v);
+		snprintf(expected, sizeof(expected), "%s%ld.%ld", (v < 0) ? "-" : "", labs(v) / 10, labs(v) % 10);
+		check("tenths", got, n, expected, v);
+		if (n > FORMAT_TENTHS_MAX)
+			check("tenths max", got, n, "", v);
+	}
+
+	for (i = 0 ; i < sizeof(longs) / sizeof(longs[0]) ; i++)
+	{
+		n = Format_unsignedLong(got, (uint32_t)longs[i]);
+		snprintf(expected, sizeof(expected), "%lu", longs[i]);
+		check("unsignedLong", got, n, expected, (long)longs[i]);
+	}
+
+	n = Format_string(got, "CH8: ");
+	check("string", got, n, "CH8: ", 0);
+}
+
+
+/////////////////////////////////////////
+//Time BENCH_CALLS calls of each, values spread over
+//the range so every digit count is in the mix
+#define BENCH(cost, call)													\
+	do {																	\
+		unsigned long k_ = 0;												\
+		double t_ = nowNs();												\
+		unsigned long long c_ = nowCycles();								\
+		for (k_ = 0 ; k_ < BENCH_CALLS ; k_++)								\
+		{																	\
+			unsigned value = (unsigned)((k_ * 40503UL) & 0xFFFF);			\
+			(void)value;													\
+			mSink += (unsigned)(call);										\
+		}																	\
+		(cost).cycles = (double)(nowCycles() - c_) / BENCH_CALLS;			\
+		(cost).ns = (nowNs() - t_) / BENCH_CALLS;							\
+	} while (0)
+
+static void benchAll(void)
+{
+	static const char *names[] =
+	{
+		"unsigned", "signed", "unsignedLong", "padded 5", "tenths", "hex 4"
+	};
+	char buffer[32];
+	Cost_t format[6];
+	Cost_t library[6];
+	unsigned i = 0;
+
+	BENCH(format[0], Format_unsigned(buffer, (uint16_t)value));
+	BENCH(library[0], snprintf(buffer, sizeof(buffer), "%u", value));
+
+	BENCH(format[1], Format_signed(buffer, (int16_t)(short)value));
+	BENCH(library[1], snprintf(buffer, sizeof(buffer), "%d", (short)value));
+
+	BENCH(format[2], Format_unsignedLong(buffer, (uint32_t)value * 65599UL));
+	BENCH(library[2], snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)value * 65599UL));
+
+	BENCH(format[3], Format_padded(buffer, (uint16_t)value, 5));
+	BENCH(library[3], snprintf(buffer, sizeof(buffer), "%05u", value));
+
+	BENCH(format[4], Format_tenths(buffer, (int16_t)(short)value));
+	BENCH(library[4], snprintf(buffer, sizeof(buffer), "%d.%d", (short)value / 10, abs((short)value % 10)));
+
+	BENCH(format[5], Format_hex(buffer, (uint16_t)value, 4));
+	BENCH(library[5], snprintf(buffer, sizeof(buffer), "%04X", value));
+
+	printf("%-14s %10s %10s %8s", "per call", "format ns", "sprintf ns", "ratio");
+	if (BENCH_CYCLES)
+		printf(" %12s %12s", "format cyc", "sprintf cyc");
+	printf("\n");
+
+	for (i = 0 ; i < 6 ; i++)
+	{
+		printf("%-14s %10.1f %10.1f %7.1fx", names[i], format[i].ns, library[i].ns, library[i].ns / format[i].ns);
+		if (BENCH_CYCLES)
+			printf(" %12.1f %12.1f", format[i].cycles, library[i].cycles);
+		printf("\n");
+	}
+}
+
+
+static double nowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+
+static unsigned long long nowCycles(void)
+{
+#if BENCH_CYCLES
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
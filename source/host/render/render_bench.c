@@ -0,0 +1,139 @@
+/*
+ * render_bench.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Host benchmark for the play area render in
+ * source/cw/s08_gameBoard/hardware/lcd.c, built from
+ * the same source as the board, once for each band
+ * size, see FRAME_BUFFER_BAND_PAGES and the Makefile.
+ *
+ * The field is the game's - 8 enemies in 2 rows and
+ * all 8 missiles - moved down the play area a row
+ * at a time so the enemies cross every band edge.
+ *
+ * Per render:
+ * spi - bytes sent, commands and data, and the time
+ *       they take at SPI_FREQ_HZ.  It is the same for
+ *       every band size.
+ * cpu - host time for the rest, clear, draw and the
+ *       walk over the objects for each band.
+ *
+ * Host time is not board time, compare the band sizes
+ * with it.  The frame time on the board is the frame
+ * task WCET on the game over screen of an INSTRUMENT
+ * build, see main.c.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//the board's types, after the system headers
+#include "config.h"
+#include "lcd.h"
+#include "spi.h"
+#include "game.h"
+
+#define BENCH_RENDERS			200000UL
+#define BENCH_STEPS				(GAME_ENEMY_MAX_Y - GAME_ENEMY_Y_SPACING + 1)
+
+
+//registers lcd.c writes
+volatile unsigned char PTCD = 0x00;
+volatile unsigned char PTCDD = 0x00;
+
+static unsigned long mSpiBytes = 0;
+static uint16_t mStep = 0;
+
+static void fieldDraw(void);
+static double nowNs(void);
+
+
+int main(void)
+{
+	unsigned long n = 0;
+	double start = 0.0;
+	double cpuNs = 0.0;
+	double spiUs = 0.0;
+	double bytes = 0.0;
+
+	LCD_init();
+	mSpiBytes = 0;
+
+	start = nowNs();
+	for (n = 0 ; n < BENCH_RENDERS ; n++)
+	{
+		mStep = (uint16_t)(n % BENCH_STEPS);
+		LCD_renderFrameBuffer(fieldDraw);
+	}
+	cpuNs = (nowNs() - start) / BENCH_RENDERS;
+
+	bytes = (double)mSpiBytes / BENCH_RENDERS;
+	spiUs = bytes * 8.0 * 1000000.0 / SPI_FREQ_HZ;
+
+	printf("band %d of %d pages, %d passes, %d byte buffer\n",
+			FRAME_BUFFER_BAND_PAGES, FRAME_BUFFER_NUM_PAGES,
+			FRAME_BUFFER_NUM_BANDS, FRAME_BUFFER_SIZE);
+	printf("  spi  %6.1f bytes  %7.1f us at %lu hz\n", bytes, spiUs, SPI_FREQ_HZ);
+	printf("  cpu  %6.1f ns host\n", cpuNs);
+
+	return 0;
+}
+
+
+////////////////////////////////////////////
+//The game field at mStep - the enemy rows start
+//mStep rows down, the missiles are spread over
+//the height, 2x2 pixels each like Game_missileDraw
+static void fieldDraw(void)
+{
+	uint8_t i = 0;
+	uint8_t j = 0;
+	uint16_t y = 0;
+
+	for (i = 0 ; i < GAME_ENEMY_NUM_ROWS ; i++)
+	{
+		for (j = 0 ; j < GAME_ENEMY_NUM_COLS ; j++)
+		{
+			LCD_drawEnemyBitmap(GAME_ENEMY_X_SPACING * j,
+					(GAME_ENEMY_Y_SPACING * i) + mStep, &bmenemy1Bmp);
+		}
+	}
+
+	for (i = 0 ; i < (GAME_MISSILE_NUM_MISSILE * 2) ; i++)
+	{
+		y = (uint16_t)((mStep + (i * 5)) % FRAME_BUFFER_HEIGHT);
+		LCD_putPixelRam(i * 8, y, 1, 0);
+		LCD_putPixelRam(i * 8, y + 1, 1, 0);
+		LCD_putPixelRam((i * 8) + 1, y, 1, 0);
+		LCD_putPixelRam((i * 8) + 1, y + 1, 1, 0);
+	}
+}
+
+
+////////////////////////////////////////////
+//SPI stand ins, count the bytes
+void SPI_write(uint8_t data)
+{
+	(void)data;
+	mSpiBytes++;
+}
+
+
+void SPI_writeArray(uint8_t *far data, uint16_t length)
+{
+	(void)data;
+	mSpiBytes += length;
+}
+
+
+static double nowNs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((double)ts.tv_sec * 1e9) + (double)ts.tv_nsec;
+}
@@ -0,0 +1,11 @@
+/*
+ * derivative.h - host stand in, only the port
+ * registers lcd.c writes, see render_bench.c
+ */
+#ifndef DERIVATIVE_H_
+#define DERIVATIVE_H_
+
+extern volatile unsigned char PTCD;
+extern volatile unsigned char PTCDD;
+
+#endif /* DERIVATIVE_H_ */
@@ -0,0 +1,11 @@
+/*
+ * hidef.h - host stand in for the CodeWarrior header,
+ * the render bench has no interrupts
+ */
+#ifndef HIDEF_H_
+#define HIDEF_H_
+
+#define EnableInterrupts
+#define DisableInterrupts
+
+#endif /* HIDEF_H_ */
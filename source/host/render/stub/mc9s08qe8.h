@@ -0,0 +1,4 @@
+/*
+ * mc9s08qe8.h - host stand in, see derivative.h
+ */
+#include "derivative.h"
@@ -0,0 +1,378 @@
+/*
+ * stream_decode.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: danao
+ *
+ * Linux decoder for the binary sample stream from
+ * s08_uart, see source/cw/s08_uart/hardware/stream.h
+ *
+ * Reads COBS frames from a serial port or a capture
+ * file, checks the CRC-8, unpacks the 12 bit samples
+ * and writes CSV to stdout:
+ *
+ * sample,seq,channel,code
+ *
+ * sample counts from 0 and skips STREAM_SAMPLES for
+ * each lost frame, so it stays a time axis at the
+ * sample rate.  At the end, or on Ctrl-C, a report of
+ * frames, samples, bad frames and lost frames goes to
+ * stderr.  A lost frame is a gap in seq - dropped on
+ * the board for a full TX ring, or lost on the wire.
+ *
+ * stream_decode [-b baud] [-q] [device | file]
+ * -b - 9600, 19200 (default) or 38400, serial only
+ * -q - report only, no CSV
+ * with no device, reads stdin
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+//must match stream.h
+#define STREAM_SAMPLES			16
+#define STREAM_HEADER			3
+#define STREAM_DATA				((STREAM_SAMPLES * 3) >> 1)
+#define STREAM_FRAME			(STREAM_HEADER + STREAM_DATA + 1)
+#define STREAM_CRC_POLY			0x07
+
+#define WIRE_MAX				256
+
+
+/////////////////////////////////////////
+//Counters for the report
+//bytes - read from the port or file
+//frames / samples - good frames and their samples
+//crc - frames with a bad CRC
+//malformed - bad COBS, wrong length or count
+//lost - frames missing from the seq
+typedef struct
+{
+	unsigned long bytes;
+	unsigned long frames;
+	unsigned long samples;
+	unsigned long crc;
+	unsigned long malformed;
+	unsigned long lost;
+}Report_t;
+
+
+static Report_t mReport;
+static volatile sig_atomic_t mStop = 0;
+static int mQuiet = 0;
+
+//seq expected per channel, -1 before the first
+static int mNextSeq[256];
+static unsigned long mSample = 0;
+
+
+static uint8_t crc8(const uint8_t *data, size_t length);
+static int cobsDecode(const uint8_t *in, size_t length, uint8_t *out);
+static void handleFrame(const uint8_t *frame, size_t length);
+static int openSerial(const char *path, int baud);
+static void printReport(void);
+static void onSignal(int sig);
+
+
+int main(int argc, char **argv)
+{
+	struct sigaction action;
+	uint8_t buffer[256];
+	uint8_t wire[WIRE_MAX];
+	uint8_t frame[WIRE_MAX];
+	size_t wireLength = 0;
+	int overflow = 0;
+	int baud = 19200;
+	int fd = STDIN_FILENO;
+	int opt = 0;
+	int decoded = 0;
+	ssize_t n = 0;
+	ssize_t i = 0;
+
+	while ((opt = getopt(argc, argv, "b:q")) != -1)
+	{
+		switch (opt)
+		{
+			case 'b':	baud = atoi(optarg);	break;
+			case 'q':	mQuiet = 1;				break;
+			default:
+				fprintf(stderr, "usage: %s [-b baud] [-q] [device | file]\n", argv[0]);
+				return 2;
+		}
+	}
+
+	if (optind < argc)
+	{
+		fd = openSerial(argv[optind], baud);
+		if (fd < 0)
+			return 1;
+	}
+
+	memset(&mReport, 0, sizeof(mReport));
+	for (i = 0 ; i < 256 ; i++)
+		mNextSeq[i] = -1;
+
+	//no SA_RESTART, Ctrl-C has to end a blocked read
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	if (!mQuiet)
+		printf("sample,seq,channel,code\n");
+
+	//collect bytes up to each 0x00, a frame too long
+	//for the buffer is thrown away at its delimiter
+	while (!mStop)
+	{
+		n = read(fd, buffer, sizeof(buffer));
+		if (n <= 0)
+			break;
+
+		mReport.bytes += (unsigned long)n;
+
+		for (i = 0 ; i < n ; i++)
+		{
+			if (buffer[i])
+			{
+				if (wireLength < sizeof(wire))
+					wire[wireLength++] = buffer[i];
+				else
+					overflow = 1;
+				continue;
+			}
+
+			if (overflow)
+				mReport.malformed++;
+			else if (wireLength)
+			{
+				decoded = cobsDecode(wire, wireLength, frame);
+				if (decoded < 0)
+					mReport.malformed++;
+				else
+					handleFrame(frame, (size_t)decoded);
+			}
+
+			wireLength = 0;
+			overflow = 0;
+		}
+	}
+
+	if (fd != STDIN_FILENO)
+		close(fd);
+
+	fflush(stdout);
+	printReport();
+
+	return 0;
+}
+
+
+/////////////////////////////////////////
+//CRC-8, poly 0x07, init 0x00 - a bit at a time
+//here, the board uses a nibble table, same result
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+	uint8_t crc = 0x00;
+	size_t i = 0;
+	int bit = 0;
+
+	for (i = 0 ; i < length ; i++)
+	{
+		crc ^= data[i];
+		for (bit = 0 ; bit < 8 ; bit++)
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ STREAM_CRC_POLY) : (uint8_t)(crc << 1);
+	}
+
+	return crc;
+}
+
+
+/////////////////////////////////////////
+//cobsDecode
+//length bytes without the delimiter.  Returns the
+//decoded length, -1 if a code runs past the end.
+static int cobsDecode(const uint8_t *in, size_t length, uint8_t *out)
+{
+	size_t i = 0;
+	size_t o = 0;
+	uint8_t code = 0;
+	uint8_t j = 0;
+
+	while (i < length)
+	{
+		code = in[i++];
+		if ((size_t)(code - 1) > (length - i))
+			return -1;
+
+		for (j = 1 ; j < code ; j++)
+			out[o++] = in[i++];
+
+		//a code under 0xFF stands for a zero, except
+		//at the end of the frame
+		if ((code < 0xFF) && (i < length))
+			out[o++] = 0x00;
+	}
+
+	return (int)o;
+}
+
+
+/////////////////////////////////////////
+//handleFrame
+//Check the length, count and CRC, count the seq
+//gap for the channel, write the samples
+static void handleFrame(const uint8_t *frame, size_t length)
+{
+	uint8_t seq = 0;
+	uint8_t channel = 0;
+	uint8_t count = 0;
+	uint8_t gap = 0;
+	const uint8_t *data = NULL;
+	unsigned code = 0;
+	int k = 0;
+
+	if (length < STREAM_HEADER + 3)
+	{
+		mReport.malformed++;
+		return;
+	}
+
+	count = frame[2];
+	if ((count == 0) || (count > STREAM_SAMPLES) ||
+			(length != (size_t)(STREAM_HEADER + ((count * 3 + 1) >> 1) + 1)))
+	{
+		mReport.malformed++;
+		return;
+	}
+
+	if (crc8(frame, length - 1) != frame[length - 1])
+	{
+		mReport.crc++;
+		return;
+	}
+
+	seq = frame[0];
+	channel = frame[1];
+
+	//frames in between are lost, a bad frame is one
+	//of them
+	if (mNextSeq[channel] >= 0)
+	{
+		gap = (uint8_t)(seq - (uint8_t)mNextSeq[channel]);
+		mReport.lost += gap;
+		mSample += (unsigned long)gap * STREAM_SAMPLES;
+	}
+	mNextSeq[channel] = (uint8_t)(seq + 1);
+
+	mReport.frames++;
+	mReport.samples += count;
+
+	data = frame + STREAM_HEADER;
+	for (k = 0 ; k < count ; k++)
+	{
+		if (!(k & 1))
+			code = ((unsigned)data[0] << 4) | (data[1] >> 4);
+		else
+		{
+			code = ((unsigned)(data[1] & 0x0F) << 8) | data[2];
+			data += 3;
+		}
+
+		if (!mQuiet)
+			printf("%lu,%u,%u,%u\n", mSample, seq, channel, code);
+		mSample++;
+	}
+}
+
+
+/////////////////////////////////////////
+//openSerial
+//Raw 8N1 at baud.  A file that isn't a tty is read
+//as it is.
+static int openSerial(const char *path, int baud)
+{
+	struct termios tio;
+	speed_t speed = B19200;
+	int fd = open(path, O_RDONLY | O_NOCTTY);
+
+	if (fd < 0)
+	{
+		perror(path);
+		return -1;
+	}
+
+	if (!isatty(fd))
+		return fd;
+
+	switch (baud)
+	{
+		case 9600:	speed = B9600;	break;
+		case 19200:	speed = B19200;	break;
+		case 38400:	speed = B38400;	break;
+		default:
+			fprintf(stderr, "baud %d - 9600, 19200 or 38400\n", baud);
+			close(fd);
+			return -1;
+	}
+
+	if (tcgetattr(fd, &tio) < 0)
+	{
+		perror("tcgetattr");
+		close(fd);
+		return -1;
+	}
+
+	cfmakeraw(&tio);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+
+	if (tcsetattr(fd, TCSANOW, &tio) < 0)
+	{
+		perror("tcsetattr");
+		close(fd);
+		return -1;
+	}
+
+	tcflush(fd, TCIFLUSH);
+
+	return fd;
+}
+
+
+/////////////////////////////////////////
+//Loss is against the frames that should have come,
+//good + lost.  Bad frames are in lost as well, once
+//the next good one shows the gap.
+static void printReport(void)
+{
+	unsigned long expected = mReport.frames + mReport.lost;
+
+	fprintf(stderr, "bytes     %lu\n", mReport.bytes);
+	fprintf(stderr, "frames    %lu\n", mReport.frames);
+	fprintf(stderr, "samples   %lu\n", mReport.samples);
+	fprintf(stderr, "crc       %lu\n", mReport.crc);
+	fprintf(stderr, "malformed %lu\n", mReport.malformed);
+	fprintf(stderr, "lost      %lu", mReport.lost);
+	if (expected)
+		fprintf(stderr, " (%.2f%%)", 100.0 * (double)mReport.lost / (double)expected);
+	fprintf(stderr, "\n");
+}
+
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	mStop = 1;
+}